@@ -1,4 +1,5 @@
 #include <atomic>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -345,6 +346,7 @@ void bench(bm::State& state, workload_t const& workload, db_t& db, data_accessor
     size_t const iterations_total_count = workload.db_operations_count;
     size_t const printable_iterations_distance = iterations_total_count / 10;
     std::atomic_bool do_flash = true;
+    static std::map<std::string, double> counters_before;
 
     if (state.thread_index() == 0) {
         fails_count = 0;
@@ -352,6 +354,7 @@ void bench(bm::State& state, workload_t const& workload, db_t& db, data_accessor
         bytes_processed_count = 0;
         done_iterations_count = 0;
         last_printed_iterations_count = 0;
+        counters_before = db.counters();
         cpu_stat.start();
         mem_stat.start();
 
@@ -417,6 +420,16 @@ void bench(bm::State& state, workload_t const& workload, db_t& db, data_accessor
         state.counters["processed,bytes"] =
             bm::Counter(bytes_processed_count, bm::Counter::kDefaults, bm::Counter::kIs1024);
         state.counters["disk,bytes"] = bm::Counter(db.size_on_disk(), bm::Counter::kDefaults, bm::Counter::kIs1024);
+        for (auto const& [name, value] : db.counters())
+            state.counters[name] = bm::Counter(value - counters_before[name]);
+        // I/O amplification: bytes moved by the engine per processed byte
+        if (bytes_processed_count && state.counters.count("io_read,bytes") && state.counters.count("io_written,bytes")) {
+            state.counters["read_amp"] = bm::Counter(state.counters["io_read,bytes"].value / bytes_processed_count);
+            state.counters["write_amp"] = bm::Counter(state.counters["io_written,bytes"].value / bytes_processed_count);
+        }
+        if (state.counters.count("compression_out,bytes") && state.counters["compression_out,bytes"].value > 0)
+            state.counters["compression_ratio"] = bm::Counter(state.counters["compression_in,bytes"].value /
+                                                              state.counters["compression_out,bytes"].value);
     }
 }
 
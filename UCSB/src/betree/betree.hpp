@@ -2,6 +2,7 @@
 
 #include <fmt/format.h>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -71,6 +72,7 @@ public:
 
     void flush() override;
     size_t size_on_disk() const override;
+    std::map<std::string, double> counters() const override;
 
     std::unique_ptr<transaction_t> create_transaction() override;
 
@@ -192,6 +194,23 @@ size_t betree_t::size_on_disk() const {
     return ucsb::size_on_disk(dir_path_);
 }
 
+std::map<std::string, double> betree_t::counters() const {
+    if (!db_)
+        return {};
+    auto const statistics = db_->getStatistics();
+    return {
+            {"io_reads", statistics.reads},
+            {"io_read,bytes", statistics.readBytes},
+            {"io_writes", statistics.writes},
+            {"io_written,bytes", statistics.writeBytes},
+            {"io_syncs", statistics.syncs},
+            {"blocks_allocated", statistics.allocations},
+            {"blocks_deleted", statistics.deletes},
+            {"compression_in,bytes", statistics.uncompressedBytes},
+            {"compression_out,bytes", statistics.compressedBytes},
+    };
+}
+
 std::unique_ptr<transaction_t> betree_t::create_transaction() {
     return {};
 }
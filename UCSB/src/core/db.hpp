@@ -1,6 +1,8 @@
 #pragma once
+#include <map>
 #include <memory>
 #include <set>
+#include <string>
 
 #include "src/core/data_accessor.hpp"
 #include "src/core/types.hpp"
@@ -59,6 +61,12 @@ struct db_t : public data_accessor_t {
      */
     virtual size_t size_on_disk() const = 0;
 
+    /**
+     * @brief Engine specific cumulative counters (e.g. I/O statistics).
+     * The benchmark reports the increase of each counter during a workload.
+     */
+    virtual std::map<std::string, double> counters() const { return {}; }
+
     virtual std::unique_ptr<transaction_t> create_transaction() = 0;
 };
 
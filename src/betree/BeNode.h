@@ -189,6 +189,11 @@ public:
     BeRootNodeT& asRoot();
     BeInnerNodeT& asInner();
     BeLeafNodeT& asLeaf();
+    // optimistic readers check the type once, it may change until the
+    // read is validated (see PageBuffer::beginRead)
+    BeRootNodeT& asRootUnchecked();
+    BeInnerNodeT& asInnerUnchecked();
+    BeLeafNodeT& asLeafUnchecked();
 };
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t PAGE_SIZE, short EPSILON>
@@ -235,6 +240,24 @@ BeNodeWrapper<K, V, PAGE_SIZE, EPSILON>::asLeaf() {
     return *reinterpret_cast<BeLeafNodeT*>(data.data());
 }
 // --------------------------------------------------------------------------
+template<class K, class V, std::size_t PAGE_SIZE, short EPSILON>
+typename BeNodeWrapper<K, V, PAGE_SIZE, EPSILON>::BeRootNodeT&
+BeNodeWrapper<K, V, PAGE_SIZE, EPSILON>::asRootUnchecked() {
+    return *reinterpret_cast<BeRootNodeT*>(data.data());
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t PAGE_SIZE, short EPSILON>
+typename BeNodeWrapper<K, V, PAGE_SIZE, EPSILON>::BeInnerNodeT&
+BeNodeWrapper<K, V, PAGE_SIZE, EPSILON>::asInnerUnchecked() {
+    return *reinterpret_cast<BeInnerNodeT*>(data.data());
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t PAGE_SIZE, short EPSILON>
+typename BeNodeWrapper<K, V, PAGE_SIZE, EPSILON>::BeLeafNodeT&
+BeNodeWrapper<K, V, PAGE_SIZE, EPSILON>::asLeafUnchecked() {
+    return *reinterpret_cast<BeLeafNodeT*>(data.data());
+}
+// --------------------------------------------------------------------------
 }// namespace betree
 // --------------------------------------------------------------------------
 #endif//B_EPSILON_BENODE_H
@@ -2,7 +2,10 @@
 #define B_EPSILON_BETREE_H
 // --------------------------------------------------------------------------
 #include "BeNode.h"
+#include "src/buffer/CheckpointLatch.h"
 #include "src/buffer/PageBuffer.h"
+#include "src/file/WriteAheadLog.h"
+#include "src/file/io/IOBackend.h"
 #include "src/util/ErrorHandler.h"
 #include <algorithm>
 #include <atomic>
@@ -11,15 +14,19 @@
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
-#include <fcntl.h>
-#include <filesystem>
+#include <cstring>
 #include <gtest/gtest.h>
 #include <iterator>
+#include <mutex>
 #include <new>
 #include <numeric>
 #include <optional>
 #include <queue>
+#include <shared_mutex>
+#include <span>
 #include <tuple>
+#include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -171,10 +178,11 @@ class BeTree {
 
     using BeNodeWrapperT = BeNodeWrapper<K, V, B, EPSILON>;
     using PageT = buffer::Page<B>;
+    using PageBufferT = buffer::PageBuffer<B, N>;
 
     // a node must fit onto a page
     static_assert(sizeof(BeNodeWrapperT) == B);
-    static_assert(alignof(BeNodeWrapperT) == alignof(PageT));
+    static_assert(PageT::ALIGNMENT % alignof(BeNodeWrapperT) == 0);
 
     // (LEAF_N - 1) must be an upper bound to enable
     // preemptive splitting
@@ -186,19 +194,28 @@ class BeTree {
     static const std::size_t MAX_FLUSH_SIZE =
             BeNodeWrapperT::NodeSizesT::LEAF_N - 1;
 
+    // persisted with the pages (see PageBuffer::setUserHeader)
     struct alignas(alignof(std::max_align_t)) Header {
         std::uint64_t rootID = 0;
         std::atomic_uint64_t currentTimeStamp = 0;
         bool rootLeaf = true;
+        // the logged upserts up to here are part of the saved state
+        std::uint64_t lsn = 0;
     };
 
 private:
-    buffer::PageBuffer<B, N> pageBuffer;
-    int fd;
+    PageBufferT pageBuffer;
     Header header;
+    // swizzled reference to the root (entry point of the optimistic reads)
+    std::uint64_t rootReference = 0;
+    std::unique_ptr<file::WriteAheadLog> wal;// optional (see StorageOptions)
+    // the modifying operations hold the latch shared (see checkpoint)
+    buffer::CheckpointLatch checkpointLatch;
+    std::mutex checkpointMutex;// one checkpoint at a time
 
 public:
-    BeTree(const std::string&, double);
+    BeTree(const std::string&, double, const file::StorageOptions& = {});
+    ~BeTree();
 
 private:
     void initializeNode(PageT&, unsigned char) const;
@@ -207,18 +224,21 @@ private:
     // splits a leaf node by creating a new page and returning it as well
     // as a copy of the middle key (pivot)
     // note: the returned page is still exclusively locked
-    PageT& splitLeafNode(typename BeNodeWrapperT::BeLeafNodeT&, K, K&);
+    // note: the new page is stored close to the given page id (split page)
+    PageT& splitLeafNode(typename BeNodeWrapperT::BeLeafNodeT&, K, K&, std::uint64_t);
     FRIEND_TEST(BeTreeMethods, splitLeafNode);
     // splits an inner node by creating a new page and returning it as well
     // as the removed middle key (pivot)
     // note: the returned page is still exclusively locked
-    PageT& splitInnerNode(typename BeNodeWrapperT::BeInnerNodeT&, K&);
+    // note: the new page is stored close to the given page id (split page)
+    PageT& splitInnerNode(typename BeNodeWrapperT::BeInnerNodeT&, K&, std::uint64_t);
     FRIEND_TEST(BeTreeMethods, splitInnerNode);
     // splits the root node by creating new pages and returning them as well
     // as the removed middle keys (pivots)
     // the pivot elements will automatically be inserted into the new root
     // note: the returned pages are still exclusively locked
-    std::vector<PageT*> splitRootNode(typename BeNodeWrapperT::BeRootNodeT&, std::vector<K>&);
+    // note: the new pages are stored close to the given page id (root)
+    std::vector<PageT*> splitRootNode(typename BeNodeWrapperT::BeRootNodeT&, std::vector<K>&, std::uint64_t);
     FRIEND_TEST(BeTreeMethods, splitRootNode);
     // inserts pivot elements
     // tuples: (index of the split child, midKey, id of the right page)
@@ -238,6 +258,20 @@ private:
     void handleRootLeafUpsert(Upsert<K, V>, PageT*);
     // inserts an upsert
     void upsert(Upsert<K, V>);
+    // inserts an upsert, returns once it is durable (write-ahead log)
+    void logAndUpsert(Upsert<K, V>);
+    // replays the upserts of the write-ahead log (in timestamp order) and
+    // saves the result
+    void recover();
+    // relocation hook of the compaction (see PageBuffer::setRelocationHook)
+    std::size_t relocatePages(const std::vector<std::uint64_t>&);
+    // applies the first <size> messages of an inner node for the key to
+    // the lookup state, returns true if they end the lookup (insert/delete)
+    bool collectMessages(typename BeNodeWrapperT::BeInnerNodeT&, std::size_t, const K&,
+                         std::deque<V>&, std::optional<V>&);
+    // lookup without latches and pins, returns false if a read could not
+    // be validated or a node is not resident (-> pessimistic lookup)
+    bool findOptimistic(const K&, std::optional<V>&);
 
 public:
     // inserts (K,V)
@@ -252,8 +286,24 @@ public:
     // attempts to find (K,V) and returns V
     std::optional<V> find(const K&);
     std::size_t pageAmount() const;
+    // I/O statistics of the node storage and the write-ahead log (since
+    // opening the tree)
+    file::io::IOStatisticsSnapshot getStatistics() const;
+    // relocates the nodes stored in sparse segments at the end of the file
+    // and returns their amount (the next flush shrinks the file)
+    // note: runs in the background as well (see
+    // StorageOptions::compactionInterval)
+    std::size_t compact(double = 0.5);
+    FRIEND_TEST(BeTree, Compaction);
     // saves the betree
+    // note: not thread-safe
     void flush();
+    // saves the betree while it is in use (fuzzy checkpoint): the operations
+    // only wait while the dirty pages are copied, the copies are written
+    // concurrently and the write-ahead log is cut at the copied state
+    // note: log-structured mode, otherwise the operations wait for the
+    // dirty pages to be written (see PageBuffer::beginCheckpoint)
+    void checkpoint();
     // prints out the betree (dot language)
     // note: this makes use of the page buffer
     template<class K_O, class V_O, std::size_t B_O, std::size_t N_O, short EPSILON_O>
@@ -261,28 +311,47 @@ public:
 };
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
-BeTree<K, V, B, N, EPSILON>::BeTree(const std::string& path, double growthFactor)
-    : pageBuffer(path, growthFactor) {
-    const std::string headerFile = path + "/betree";
-    if (std::filesystem::exists(headerFile) && std::filesystem::is_regular_file(headerFile)) {
-        fd = open(headerFile.c_str(), O_RDWR);
-        if (pread(fd, &header, sizeof(Header), 0) != sizeof(Header)) {
-            util::raise("Invalid betree header!");
-        }
+BeTree<K, V, B, N, EPSILON>::BeTree(const std::string& path, double growthFactor,
+                                    const file::StorageOptions& options)
+    : pageBuffer(path, growthFactor, options) {
+    // a saved tree left its header (in-memory storage: nothing is persisted)
+    const auto persistedHeader = pageBuffer.getUserHeader();
+    const bool reopen = persistedHeader.size() == sizeof(Header);
+    if (reopen) {
+        std::memcpy(static_cast<void*>(&header), persistedHeader.data(), sizeof(Header));
     } else {
-        fd = open(headerFile.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-        if (fd < 0) {
-            util::raise("Could not create the betree header!");
-        }
         header.rootID = pageBuffer.createPage();
         // initialize the root node (leaf)
         auto& rootPage = pageBuffer.pinPage(header.rootID, true, true);
         initializeNode(rootPage, NodeType::LEAF);
         pageBuffer.unpinPage(rootPage, true);
-        if (ftruncate(fd, sizeof(Header)) < 0) {
-            util::raise("Could not increase the file size (betree).");
+    }
+    rootReference = header.rootID;
+    if (options.writeAheadLog) {
+        if (!options.logStructured) {
+            util::raise("The write-ahead log requires the log-structured mode!");
+        }
+        file::io::IOBackendOptions walOptions;
+        walOptions.type = options.io.type == file::io::IOBackendType::MEMORY ? file::io::IOBackendType::MEMORY
+                                                                              : file::io::IOBackendType::POSIX;
+        walOptions.throttle = options.io.throttle;
+        wal = std::make_unique<file::WriteAheadLog>(path + "/wal", walOptions, options.groupCommitDelay);
+        if (!reopen) {
+            // the log is replayed onto the last checkpoint (the empty tree)
+            flush();
         }
+        recover();
     }
+    pageBuffer.setRelocationHook([this](const std::vector<std::uint64_t>& pageIDs) {
+        return relocatePages(pageIDs);
+    });
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+BeTree<K, V, B, N, EPSILON>::~BeTree() {
+    // the background compaction must not access the members destroyed
+    // before the page buffer
+    pageBuffer.setRelocationHook({});
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
@@ -299,7 +368,7 @@ BeTree<K, V, B, N, EPSILON>::accessNode(PageT& page) const {
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
 typename BeTree<K, V, B, N, EPSILON>::PageT&
 BeTree<K, V, B, N, EPSILON>::splitLeafNode(typename BeNodeWrapperT::BeLeafNodeT& leafNode,
-                                           K medianKey, K& resultKey) {
+                                           K medianKey, K& resultKey, std::uint64_t hintID) {
     assert(leafNode.size >= 2);
     auto medianIt = std::upper_bound(leafNode.keys.begin(),
                                      leafNode.keys.begin() + leafNode.size,
@@ -309,8 +378,8 @@ BeTree<K, V, B, N, EPSILON>::splitLeafNode(typename BeNodeWrapperT::BeLeafNodeT&
         medianIndex = leafNode.size;
     }
     resultKey = medianKey;
-    // create a new leaf node
-    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+    // create a new leaf node (next to the split one)
+    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(hintID), true, true);
     initializeNode(rightPage, NodeType::LEAF);
     assert(accessNode(rightPage).nodeType() == NodeType::LEAF);
     auto& rightLeaf = accessNode(rightPage).asLeaf();
@@ -330,12 +399,12 @@ BeTree<K, V, B, N, EPSILON>::splitLeafNode(typename BeNodeWrapperT::BeLeafNodeT&
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
 typename BeTree<K, V, B, N, EPSILON>::PageT&
 BeTree<K, V, B, N, EPSILON>::splitInnerNode(typename BeNodeWrapperT::BeInnerNodeT& innerNode,
-                                            K& resultKey) {
+                                            K& resultKey, std::uint64_t hintID) {
     assert(innerNode.size >= 2);
     const std::size_t splitIndex = (innerNode.size - 1) / 2;
     resultKey = innerNode.pivots[splitIndex];
-    // create a new inner node
-    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+    // create a new inner node (next to the split one)
+    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(hintID), true, true);
     initializeNode(rightPage, NodeType::INNER);
     assert(accessNode(rightPage).nodeType() == NodeType::INNER);
     auto& rightInnerNode = accessNode(rightPage).asInner();
@@ -368,7 +437,7 @@ template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
 std::vector<typename BeTree<K, V, B, N, EPSILON>::PageT*>
 BeTree<K, V, B, N, EPSILON>::splitRootNode(
         typename BeTree<K, V, B, N, EPSILON>::BeNodeWrapperT::BeRootNodeT& rootNode,
-        std::vector<K>& midPivots) {
+        std::vector<K>& midPivots, std::uint64_t hintID) {
     std::vector<BeTree<K, V, B, N, EPSILON>::PageT*> newChildren;
     midPivots.clear();
     constexpr std::size_t childPivots = BeNodeWrapperT::NodeSizesT::INNER_N / 2;
@@ -379,7 +448,7 @@ BeTree<K, V, B, N, EPSILON>::splitRootNode(
         const bool lastIteration = (i + (childPivots + 1) >= rootNode.size);
         std::size_t pivots = std::min(childPivots, rootNode.size - i);
         // create the new child
-        PageT& newChild = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+        PageT& newChild = pageBuffer.pinPage(pageBuffer.createPage(hintID), true, true);
         initializeNode(newChild, NodeType::INNER);
         auto& childNode = accessNode(newChild).asInner();
         // move pivots and children to the new node
@@ -593,11 +662,18 @@ void BeTree<K, V, B, N, EPSILON>::handleTraversalNode(PageT* currentPage,
     std::vector<PivotTuple> newPivots;
     using SplitResult = std::pair<K, PageT*>;
     std::vector<std::tuple<PageT*, std::optional<SplitResult>, std::vector<Upsert<K, V>>>> leafMessages;
+    // the children are pinned one after another -> read them ahead
+    std::vector<std::uint64_t> childIDs;
+    childIDs.reserve(messageMap.size());
+    for (const auto& entry: messageMap) {
+        childIDs.push_back(PageBufferT::unswizzle(currentNode.children[entry.first]));
+    }
+    pageBuffer.prefetch(childIDs);
     for (auto& [childIndex, vector]: messageMap) {
         assert(childIndex <= currentNode.size);
         assert(std::is_sorted(vector.begin(), vector.end()));
         // pin the child
-        PageT& childPage = pageBuffer.pinPage(
+        PageT& childPage = pageBuffer.pinSwizzled(
                 currentNode.children[childIndex], true);
         if (accessNode(childPage).nodeType() == NodeType::LEAF) {
             // base case: we arrived at the leaf level
@@ -644,7 +720,7 @@ void BeTree<K, V, B, N, EPSILON>::handleTraversalNode(PageT* currentPage,
                         vector, vector.size());
                 K middleKey;
                 // <rightPage> is automatically uniquely pinned
-                PageT& rightPage = splitLeafNode(leafChild, medianKey, middleKey);
+                PageT& rightPage = splitLeafNode(leafChild, medianKey, middleKey, childPage.id);
                 rightSplitResult = std::make_pair(middleKey, &rightPage);
                 // add the pivot
                 newPivots.emplace_back(childIndex, middleKey, rightPage.id);
@@ -687,7 +763,7 @@ void BeTree<K, V, B, N, EPSILON>::handleTraversalNode(PageT* currentPage,
             if (innerChild.pivots.size() - innerChild.size < messageMap.size()) {
                 // we need to split the child
                 K middleKey;
-                PageT& rightPage = splitInnerNode(innerChild, middleKey);
+                PageT& rightPage = splitInnerNode(innerChild, middleKey, childPage.id);
                 newPivots.emplace_back(childIndex, middleKey, rightPage.id);
                 // split the additional messages
                 MessageMap leftMap, rightMap;
@@ -772,7 +848,8 @@ void BeTree<K, V, B, N, EPSILON>::handleTraversalNode(PageT* currentPage,
                     continue;
                 }
                 assert(targetNode.size < targetNode.keys.size());
-                assert(keyIndex < targetNode.keys.size() && *keyIt != upsert.key);
+                // the keys behind the size are stale (e.g. a new page skips the load)
+                assert(keyIndex == targetNode.size || *keyIt != upsert.key);
                 // insert the key,value
                 std::move_backward(targetNode.keys.begin() + keyIndex,
                                    targetNode.keys.begin() + targetNode.size,
@@ -817,7 +894,7 @@ bool BeTree<K, V, B, N, EPSILON>::handleRootRootUpsert(Upsert<K, V> upsert,
         }
         // split
         std::vector<K> midPivots;
-        std::vector<PageT*> children = splitRootNode(rootNode, midPivots);
+        std::vector<PageT*> children = splitRootNode(rootNode, midPivots, rootPage->id);
         // check which child receives the upsert
         auto pivotIt = std::lower_bound(midPivots.begin(), midPivots.end(),
                                         upsert.key);
@@ -837,7 +914,7 @@ bool BeTree<K, V, B, N, EPSILON>::handleRootRootUpsert(Upsert<K, V> upsert,
                                         upsert.key);
         childIndex = pivotIt - rootNode.pivots.begin();
         // pin the child
-        targetPage = &pageBuffer.pinPage(rootNode.children[childIndex], true);
+        targetPage = &pageBuffer.pinSwizzled(rootNode.children[childIndex], true);
     }
     if (!exclusiveMode) {
         // release the parent here already
@@ -861,7 +938,7 @@ bool BeTree<K, V, B, N, EPSILON>::handleRootRootUpsert(Upsert<K, V> upsert,
                     {upsert}, 1);
             K middleKey;
             // <rightPage> is automatically uniquely pinned
-            PageT& rightPage = splitLeafNode(leafNode, medianKey, middleKey);
+            PageT& rightPage = splitLeafNode(leafNode, medianKey, middleKey, targetPage->id);
             // insert the pivot into the parent
             std::move_backward(rootNode.pivots.begin() + childIndex,
                                rootNode.pivots.begin() + rootNode.size,
@@ -1009,7 +1086,7 @@ bool BeTree<K, V, B, N, EPSILON>::handleRootRootUpsert(Upsert<K, V> upsert,
         assert(targetMap.size() == 1);
         // split
         K middleKey;
-        PageT& rightPage = splitInnerNode(innerNode, middleKey);
+        PageT& rightPage = splitInnerNode(innerNode, middleKey, targetPage->id);
         // insert the pivot into the parent
         std::move_backward(rootNode.pivots.begin() + childIndex,
                            rootNode.pivots.begin() + rootNode.size,
@@ -1129,9 +1206,9 @@ void BeTree<K, V, B, N, EPSILON>::handleRootLeafUpsert(Upsert<K, V> upsert,
                     {upsert}, 1);
             K middleKey;
             // <rightPage> is automatically uniquely pinned
-            PageT& rightPage = splitLeafNode(leafNode, medianKey, middleKey);
+            PageT& rightPage = splitLeafNode(leafNode, medianKey, middleKey, rootPage->id);
             // create a new root
-            PageT& newRoot = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+            PageT& newRoot = pageBuffer.pinPage(pageBuffer.createPage(rootPage->id), true, true);
             {
                 // first initialize the new root node
                 initializeNode(newRoot, NodeType::ROOT);
@@ -1202,13 +1279,55 @@ void BeTree<K, V, B, N, EPSILON>::upsert(Upsert<K, V> upsert) {
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+void BeTree<K, V, B, N, EPSILON>::logAndUpsert(Upsert<K, V> message) {
+    std::shared_lock operationLock(checkpointLatch);
+    if (!wal) {
+        upsert(std::move(message));
+        return;
+    }
+    // the record is the upsert itself (incl. its timestamp)
+    static_assert(std::is_trivially_copyable_v<Upsert<K, V>>);
+    const std::uint64_t lsn = wal->append(std::span(reinterpret_cast<const unsigned char*>(&message), sizeof(message)));
+    upsert(std::move(message));
+    // a checkpoint does not have to wait for the sync
+    operationLock.unlock();
+    wal->commit(lsn);
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+void BeTree<K, V, B, N, EPSILON>::recover() {
+    std::vector<Upsert<K, V>> messages;
+    // the upserts up to the saved log sequence number are applied already
+    wal->replay([&messages](std::span<const unsigned char> record) {
+        if (record.size() != sizeof(Upsert<K, V>)) {
+            util::raise("Invalid write-ahead log record (betree).");
+        }
+        std::memcpy(&messages.emplace_back(), record.data(), record.size());
+    }, header.lsn);
+    if (messages.empty()) {
+        return;
+    }
+    // concurrent upserts may have been logged out of timestamp order, but
+    // the leaves apply them in the order they arrive
+    std::sort(messages.begin(), messages.end(), [](const auto& messageA, const auto& messageB) {
+        return messageA.timeStamp < messageB.timeStamp;
+    });
+    for (auto& message: messages) {
+        upsert(message);
+    }
+    header.currentTimeStamp = std::max<std::uint64_t>(header.currentTimeStamp, messages.back().timeStamp);
+    // checkpoint: the replayed upserts are not logged again
+    flush();
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
 void BeTree<K, V, B, N, EPSILON>::insert(K key, V value) {
     Upsert<K, V> message{
             std::move(key),
             std::move(value),
             ++header.currentTimeStamp,
             UpsertType::INSERT};
-    upsert(std::move(message));
+    logAndUpsert(std::move(message));
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
@@ -1218,7 +1337,7 @@ void BeTree<K, V, B, N, EPSILON>::update(K key, V value) {
             std::move(value),
             ++header.currentTimeStamp,
             UpsertType::UPDATE};
-    upsert(std::move(message));
+    logAndUpsert(std::move(message));
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
@@ -1228,12 +1347,126 @@ void BeTree<K, V, B, N, EPSILON>::erase(const K& key) {
             V(),
             ++header.currentTimeStamp,
             UpsertType::DELETE};
-    upsert(std::move(message));
+    logAndUpsert(std::move(message));
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+bool BeTree<K, V, B, N, EPSILON>::collectMessages(typename BeNodeWrapperT::BeInnerNodeT& innerNode,
+                                                  std::size_t size, const K& key,
+                                                  std::deque<V>& accumulatedUpdates,
+                                                  std::optional<V>& currentValue) {
+    // find the first element of the message block
+    auto firstIt = std::lower_bound(innerNode.upserts.upserts.begin(),
+                                    innerNode.upserts.upserts.begin() + size,
+                                    key);
+    bool deleted = false;
+    std::vector<V> localUpdates;
+    for (; firstIt != innerNode.upserts.upserts.begin() + size &&
+           firstIt->key == key;
+         ++firstIt) {
+        const Upsert<K, V>& upsert = *firstIt;
+        if (upsert.type == UpsertType::DELETE) {
+            localUpdates.clear();
+            currentValue = std::nullopt;
+            deleted = true;
+            continue;
+        }
+        if (upsert.type == UpsertType::UPDATE) {
+            localUpdates.push_back(upsert.value);
+            continue;
+        }
+        if (upsert.type == UpsertType::INSERT) {
+            localUpdates.clear();
+            currentValue = upsert.value;
+            deleted = false;
+            continue;
+        }
+    }
+    if (deleted) {
+        accumulatedUpdates.clear();
+    }
+    std::move(localUpdates.begin(), localUpdates.end(), std::front_inserter(accumulatedUpdates));
+    return deleted || currentValue;
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+bool BeTree<K, V, B, N, EPSILON>::findOptimistic(const K& key, std::optional<V>& result) {
+    std::uint64_t version;
+    PageT* currentPage = pageBuffer.beginRead(std::atomic_ref(rootReference).load(std::memory_order_relaxed), version);
+    if (!currentPage) {
+        return false;
+    }
+    // the sizes may be garbage until the node is validated
+    if (accessNode(*currentPage).nodeType() != NodeType::ROOT) {
+        result = std::nullopt;
+        return pageBuffer.validateRead(*currentPage, version);
+    }
+    std::deque<V> accumulatedUpdates;
+    std::optional<V> currentValue;
+    std::uint64_t childReference;
+    {
+        auto& rootNode = accessNode(*currentPage).asRootUnchecked();
+        const std::size_t size = std::min<std::size_t>(rootNode.size, rootNode.pivots.size());
+        auto pivotIt = std::lower_bound(rootNode.pivots.begin(), rootNode.pivots.begin() + size, key);
+        childReference = std::atomic_ref(rootNode.children[pivotIt - rootNode.pivots.begin()])
+                                 .load(std::memory_order_relaxed);
+    }
+    while (true) {
+        std::uint64_t childVersion;
+        PageT* childPage = pageBuffer.beginRead(childReference, childVersion);
+        // the reference was valid when the child version was read
+        if (!pageBuffer.validateRead(*currentPage, version) || !childPage) {
+            return false;
+        }
+        currentPage = childPage;
+        version = childVersion;
+        auto& currentWrapper = accessNode(*currentPage);
+        const unsigned char type = currentWrapper.nodeType();
+        if (type == NodeType::LEAF) {
+            if (!currentValue) {
+                // we still need a base
+                auto& leafNode = currentWrapper.asLeafUnchecked();
+                const std::size_t size = std::min<std::size_t>(leafNode.size, leafNode.keys.size());
+                auto keyIt = std::lower_bound(leafNode.keys.begin(), leafNode.keys.begin() + size, key);
+                const std::size_t index = keyIt - leafNode.keys.begin();
+                if (index < size && *keyIt == key) {
+                    currentValue = leafNode.values[index];
+                }
+            }
+            break;
+        }
+        if (type != NodeType::INNER) {
+            return false;
+        }
+        auto& innerNode = currentWrapper.asInnerUnchecked();
+        const std::size_t messages = std::min<std::size_t>(innerNode.upserts.size, innerNode.upserts.upserts.size());
+        if (collectMessages(innerNode, messages, key, accumulatedUpdates, currentValue)) {
+            break;
+        }
+        const std::size_t size = std::min<std::size_t>(innerNode.size, innerNode.pivots.size());
+        auto childIt = std::lower_bound(innerNode.pivots.begin(), innerNode.pivots.begin() + size, key);
+        childReference = std::atomic_ref(innerNode.children[childIt - innerNode.pivots.begin()])
+                                 .load(std::memory_order_relaxed);
+    }
+    if (!pageBuffer.validateRead(*currentPage, version)) {
+        return false;
+    }
+    // inserted or deleted (deleted -> accumulatedUpdates is empty)
+    for (auto& updateValue: accumulatedUpdates) {
+        assert(currentValue);
+        *currentValue = *currentValue + std::move(updateValue);
+    }
+    result = std::move(currentValue);
+    return true;
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
 std::optional<V> BeTree<K, V, B, N, EPSILON>::find(const K& key) {
-    PageT& rootPage = pageBuffer.pinPage(header.rootID, false);
+    // the inner nodes are only read (no latch or pin is written)
+    if (std::optional<V> result; findOptimistic(key, result)) {
+        return result;
+    }
+    PageT& rootPage = pageBuffer.pinSwizzled(rootReference, false);
     if (accessNode(rootPage).nodeType() != NodeType::ROOT) {
         pageBuffer.unpinPage(rootPage, false);
         return std::nullopt;
@@ -1244,44 +1477,13 @@ std::optional<V> BeTree<K, V, B, N, EPSILON>::find(const K& key) {
                                     rootNode.pivots.begin() + rootNode.size,
                                     key);
     std::size_t childIndex = pivotIt - rootNode.pivots.begin();
-    PageT* currentPage = &pageBuffer.pinPage(rootNode.children[childIndex], false);
+    PageT* currentPage = &pageBuffer.pinSwizzled(rootNode.children[childIndex], false);
     pageBuffer.unpinPage(rootPage, false);
     std::deque<V> accumulatedUpdates;
     std::optional<V> currentValue;
     while (accessNode(*currentPage).nodeType() == NodeType::INNER) {
         auto& innerNode = accessNode(*currentPage).asInner();
-        // find the first element of the message block
-        auto firstIt = std::lower_bound(innerNode.upserts.upserts.begin(),
-                                        innerNode.upserts.upserts.begin() + innerNode.upserts.size,
-                                        key);
-        bool deleted = false;
-        std::vector<V> localUpdates;
-        for (; firstIt != innerNode.upserts.upserts.begin() + innerNode.upserts.size &&
-               firstIt->key == key;
-             ++firstIt) {
-            const Upsert<K, V>& upsert = *firstIt;
-            if (upsert.type == UpsertType::DELETE) {
-                localUpdates.clear();
-                currentValue = std::nullopt;
-                deleted = true;
-                continue;
-            }
-            if (upsert.type == UpsertType::UPDATE) {
-                localUpdates.push_back(upsert.value);
-                continue;
-            }
-            if (upsert.type == UpsertType::INSERT) {
-                localUpdates.clear();
-                currentValue = upsert.value;
-                deleted = false;
-                continue;
-            }
-        }
-        if (deleted) {
-            accumulatedUpdates.clear();
-        }
-        std::move(localUpdates.begin(), localUpdates.end(), std::front_inserter(accumulatedUpdates));
-        if (deleted || currentValue) {
+        if (collectMessages(innerNode, innerNode.upserts.size, key, accumulatedUpdates, currentValue)) {
             // new insert or new delete -> break
             pageBuffer.unpinPage(*currentPage, false);
             currentPage = nullptr;
@@ -1290,8 +1492,7 @@ std::optional<V> BeTree<K, V, B, N, EPSILON>::find(const K& key) {
         auto childIt = std::lower_bound(innerNode.pivots.begin(),
                                         innerNode.pivots.begin() + innerNode.size,
                                         key);
-        std::uint64_t childId = innerNode.children[childIt - innerNode.pivots.begin()];
-        PageT* nextPage = &pageBuffer.pinPage(childId, false);
+        PageT* nextPage = &pageBuffer.pinSwizzled(innerNode.children[childIt - innerNode.pivots.begin()], false);
         pageBuffer.unpinPage(*currentPage, false);
         currentPage = nextPage;
     }
@@ -1324,11 +1525,110 @@ std::size_t BeTree<K, V, B, N, EPSILON>::pageAmount() const {
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+file::io::IOStatisticsSnapshot BeTree<K, V, B, N, EPSILON>::getStatistics() const {
+    auto result = pageBuffer.getStatistics();
+    if (wal) {
+        result += wal->getStatistics();
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+std::size_t BeTree<K, V, B, N, EPSILON>::compact(double maxFillRatio) {
+    return pageBuffer.compact(maxFillRatio);
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+std::size_t BeTree<K, V, B, N, EPSILON>::relocatePages(const std::vector<std::uint64_t>& pageIDs) {
+    std::shared_lock operationLock(checkpointLatch);
+    std::unordered_set<std::uint64_t> relocations(pageIDs.begin(), pageIDs.end());
+    // the root id never changes
+    relocations.erase(header.rootID);
+    std::size_t result = 0;
+    // relocates the children of a root/inner node, returns true if any moved
+    std::queue<std::uint64_t> queue;
+    const auto relocateChildren = [&](auto& node, std::uint64_t parentID) {
+        bool dirty = false;
+        std::vector<std::uint64_t> childIDs;
+        for (std::size_t i = 0; i < node.size + 1; i++) {
+            childIDs.push_back(PageBufferT::unswizzle(node.children[i]));
+        }
+        pageBuffer.prefetch(childIDs);
+        for (std::size_t i = 0; i < node.size + 1; i++) {
+            const std::uint64_t childID = childIDs[i];
+            const bool relocate = relocations.contains(childID);
+            PageT& childPage = pageBuffer.pinPage(childID, relocate);
+            if (relocate) {
+                pageBuffer.relocatePage(childPage, pageBuffer.createPage(parentID));
+                node.children[i] = childPage.id;
+                relocations.erase(childID);
+                dirty = true;
+                result++;
+            }
+            if (accessNode(childPage).nodeType() != NodeType::LEAF) {
+                queue.push(childPage.id);
+            }
+            pageBuffer.unpinPage(childPage, relocate);
+        }
+        return dirty;
+    };
+    // level order traversal (the parent stays locked while its children
+    // are relocated)
+    queue.push(header.rootID);
+    while (!queue.empty() && !relocations.empty()) {
+        PageT& page = pageBuffer.pinPage(queue.front(), true);
+        queue.pop();
+        bool dirty = false;
+        if (accessNode(page).nodeType() == NodeType::ROOT) {
+            dirty = relocateChildren(accessNode(page).asRoot(), page.id);
+        } else if (accessNode(page).nodeType() == NodeType::INNER) {
+            dirty = relocateChildren(accessNode(page).asInner(), page.id);
+        }
+        pageBuffer.unpinPage(page, dirty);
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
 void BeTree<K, V, B, N, EPSILON>::flush() {
-    if (pwrite(fd, &header, sizeof(Header), 0) != sizeof(Header)) {
-        util::raise("Could not save the header (betree).");
+    if (wal) {
+        header.lsn = wal->lastLSN();
     }
+    pageBuffer.setUserHeader(std::span(reinterpret_cast<const unsigned char*>(&header), sizeof(Header)));
+    // the pages and the header are committed at once (durable)
     pageBuffer.flush();
+    if (wal) {
+        // the logged upserts are redundant once the checkpoint is durable
+        // note: a crash before -> the replay skips them (see Header::lsn)
+        wal->truncate(header.lsn);
+    }
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
+void BeTree<K, V, B, N, EPSILON>::checkpoint() {
+    std::unique_lock checkpointLock(checkpointMutex);
+    Header persistedHeader;
+    typename buffer::PageBuffer<B, N>::Checkpoint pages;
+    std::uint64_t lsn = 0;
+    {
+        // no operation is in progress -> the copies are a consistent state
+        std::unique_lock latch(checkpointLatch);
+        persistedHeader.rootID = header.rootID;
+        persistedHeader.currentTimeStamp = header.currentTimeStamp.load();
+        persistedHeader.rootLeaf = header.rootLeaf;
+        if (wal) {
+            lsn = wal->lastLSN();
+        }
+        persistedHeader.lsn = lsn;
+        pageBuffer.setUserHeader(std::span(reinterpret_cast<const unsigned char*>(&persistedHeader), sizeof(Header)));
+        pages = pageBuffer.beginCheckpoint();
+    }
+    // the pages and the header are committed at once (durable)
+    pageBuffer.writeCheckpoint(std::move(pages));// IO write + sync
+    if (wal) {
+        // the operations logged later are not part of the checkpoint
+        wal->truncate(lsn);
+    }
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N, short EPSILON>
@@ -1381,7 +1681,7 @@ std::ostream& operator<<(std::ostream& out, BeTree<K, V, B, N, EPSILON>& tree) {
             std::cout << ")";
             std::cout << "\"];\n";
             for (std::size_t i = 0; i < innerNode.size + 1; i++) {
-                std::uint64_t childID = innerNode.children[i];
+                std::uint64_t childID = buffer::PageBuffer<B, N>::unswizzle(innerNode.children[i]);
                 std::cout << currentID << " -> " << childID << ";\n";
                 queue.push(childID);
             }
@@ -1395,7 +1695,7 @@ std::ostream& operator<<(std::ostream& out, BeTree<K, V, B, N, EPSILON>& tree) {
             }
             std::cout << "\"];\n";
             for (std::size_t i = 0; i < rootNode.size + 1; i++) {
-                std::uint64_t childID = rootNode.children[i];
+                std::uint64_t childID = buffer::PageBuffer<B, N>::unswizzle(rootNode.children[i]);
                 std::cout << currentID << " -> " << childID << ";\n";
                 queue.push(childID);
             }
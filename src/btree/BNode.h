@@ -92,6 +92,10 @@ public:
     bool isLeaf() const;
     BInnerNodeT& asInner();
     BLeafNodeT& asLeaf();
+    // optimistic readers check the type once, it may change until the
+    // read is validated (see PageBuffer::beginRead)
+    BInnerNodeT& asInnerUnchecked();
+    BLeafNodeT& asLeafUnchecked();
 };
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t PAGE_SIZE>
@@ -122,6 +126,18 @@ BNodeWrapper<K, V, PAGE_SIZE>::asLeaf() {
     return *reinterpret_cast<BLeafNodeT*>(data.data());
 }
 // --------------------------------------------------------------------------
+template<class K, class V, std::size_t PAGE_SIZE>
+typename BNodeWrapper<K, V, PAGE_SIZE>::BInnerNodeT&
+BNodeWrapper<K, V, PAGE_SIZE>::asInnerUnchecked() {
+    return *reinterpret_cast<BInnerNodeT*>(data.data());
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t PAGE_SIZE>
+typename BNodeWrapper<K, V, PAGE_SIZE>::BLeafNodeT&
+BNodeWrapper<K, V, PAGE_SIZE>::asLeafUnchecked() {
+    return *reinterpret_cast<BLeafNodeT*>(data.data());
+}
+// --------------------------------------------------------------------------
 }// namespace btree
 // --------------------------------------------------------------------------
 #endif//B_EPSILON_BNODE_H
@@ -2,25 +2,33 @@
 #define B_EPSILON_BTREE_H
 // --------------------------------------------------------------------------
 #include "BNode.h"
+#include "src/buffer/CheckpointLatch.h"
 #include "src/buffer/PageBuffer.h"
+#include "src/file/WriteAheadLog.h"
+#include "src/file/io/IOBackend.h"
 #include "src/util/ErrorHandler.h"
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cinttypes>
 #include <concepts>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
-#include <fcntl.h>
-#include <filesystem>
+#include <cstring>
 #include <functional>
 #include <gtest/gtest.h>
 #include <iterator>
+#include <mutex>
 #include <new>
 #include <numeric>
 #include <optional>
 #include <queue>
+#include <shared_mutex>
+#include <span>
 #include <tuple>
+#include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 // --------------------------------------------------------------------------
@@ -31,23 +39,49 @@ class BTree {
 
     using BNodeWrapperT = BNodeWrapper<K, V, B>;
     using PageT = buffer::Page<B>;
+    using PageBufferT = buffer::PageBuffer<B, N>;
 
     // a node must fit onto a page
     static_assert(sizeof(BNodeWrapperT) == B);
-    static_assert(alignof(BNodeWrapperT) == alignof(PageT));
+    static_assert(PageT::ALIGNMENT % alignof(BNodeWrapperT) == 0);
 
+    // persisted with the pages (see PageBuffer::setUserHeader)
     struct alignas(alignof(std::max_align_t)) Header {
         std::uint64_t rootID = 0;
         bool leafRoot = true;
+        // the logged operations up to here are part of the saved state
+        std::uint64_t lsn = 0;
     };
 
+    // an operation in the write-ahead log
+    struct LogRecord {
+        static const unsigned char INSERT = 0;
+        static const unsigned char UPDATE = 1;
+        static const unsigned char ERASE = 2;
+
+        K key;
+        V value;
+        unsigned char type;
+    };
+
+    // operations on keys of the same stripe are logged and applied in the
+    // same order (updates are not idempotent)
+    static const std::size_t LOG_STRIPES = 64;
+
 private:
-    buffer::PageBuffer<B, N> pageBuffer;
-    int fd;
+    PageBufferT pageBuffer;
     Header header;
+    // swizzled reference to the root (entry point of the optimistic reads)
+    std::uint64_t rootReference = 0;
+    std::unique_ptr<file::WriteAheadLog> wal;// optional (see StorageOptions)
+    // the modifying operations hold the latch shared (see checkpoint)
+    buffer::CheckpointLatch checkpointLatch;
+    std::mutex checkpointMutex;// one checkpoint at a time
+    std::array<std::mutex, LOG_STRIPES> logMutexes;
 
 public:
-    BTree(const std::string&, double);
+    BTree(const std::string&, double, const file::StorageOptions& = {});
+    ~BTree();
 
 private:
     void initializeNode(PageT&, bool) const;
@@ -56,17 +90,33 @@ private:
     // splits a leaf node by creating a new page and returning it as well
     // as a copy of the middle key (pivot)
     // note: the returned page is still exclusively locked
-    PageT& splitLeafNode(typename BNodeWrapperT::BLeafNodeT&, K&);
+    // note: the new page is stored close to the given page id (split page)
+    PageT& splitLeafNode(typename BNodeWrapperT::BLeafNodeT&, K&, std::uint64_t);
     FRIEND_TEST(BTreeMethods, splitLeafNode);
     // splits a leaf node by creating a new page and returning it as well
     // as the removed middle key (pivot)
     // note: the returned page is still exclusively locked
-    PageT& splitInnerNode(typename BNodeWrapperT::BInnerNodeT&, K&);
+    // note: the new page is stored close to the given page id (split page)
+    PageT& splitInnerNode(typename BNodeWrapperT::BInnerNodeT&, K&, std::uint64_t);
     FRIEND_TEST(BTreeMethods, splitInnerNode);
     // helper methods
     bool insertTraversal(K, V, PageT*, bool, bool);
     void handleRootLeafInsert(K, V, PageT*);
     bool handleRootInnerInsert(K, V, PageT*, bool);
+    // the operations (without logging)
+    void applyInsert(K, V);
+    void applyUpdate(K, V);
+    void applyErase(const K&);
+    void apply(const LogRecord&);
+    // logs the operation and applies it, returns once it is durable
+    void perform(LogRecord);
+    // replays the operations of the write-ahead log and saves the result
+    void recover();
+    // relocation hook of the compaction (see PageBuffer::setRelocationHook)
+    std::size_t relocatePages(const std::vector<std::uint64_t>&);
+    // lookup without latches and pins, returns false if a read could not
+    // be validated or a node is not resident (-> pessimistic lookup)
+    bool findOptimistic(const K&, std::optional<V>&);
 
 public:
     // inserts (K,V)
@@ -81,8 +131,26 @@ public:
     // attempts to find (K,V) and returns V
     std::optional<V> find(const K&);
     std::size_t pageAmount() const;
+    // I/O statistics of the node storage and the write-ahead log (since
+    // opening the tree)
+    file::io::IOStatisticsSnapshot getStatistics() const;
+    // relocates the nodes stored in sparse segments at the end of the file
+    // and returns their amount (the next flush shrinks the file)
+    // note: runs in the background as well (see
+    // StorageOptions::compactionInterval)
+    std::size_t compact(double = 0.5);
+    FRIEND_TEST(BTree, Compaction);
+    FRIEND_TEST(BTree, BackgroundCompaction);
+    FRIEND_TEST(BTree, CheckpointDuringCompaction);
     // saves the btree
+    // note: not thread-safe
     void flush();
+    // saves the btree while it is in use (fuzzy checkpoint): the operations
+    // only wait while the dirty pages are copied, the copies are written
+    // concurrently and the write-ahead log is cut at the copied state
+    // note: log-structured mode, otherwise the operations wait for the
+    // dirty pages to be written (see PageBuffer::beginCheckpoint)
+    void checkpoint();
     // prints out the btree (dot language)
     // note: this makes use of the page buffer
     template<class K_O, class V_O, std::size_t B_O, std::size_t N_O>
@@ -90,28 +158,47 @@ public:
 };
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
-BTree<K, V, B, N>::BTree(const std::string& path, double growthFactor)
-    : pageBuffer(path, growthFactor) {
-    const std::string headerFile = path + "/btree";
-    if (std::filesystem::exists(headerFile) && std::filesystem::is_regular_file(headerFile)) {
-        fd = open(headerFile.c_str(), O_RDWR);
-        if (pread(fd, &header, sizeof(Header), 0) != sizeof(Header)) {
-            util::raise("Invalid btree header!");
-        }
+BTree<K, V, B, N>::BTree(const std::string& path, double growthFactor,
+                         const file::StorageOptions& options)
+    : pageBuffer(path, growthFactor, options) {
+    // a saved tree left its header (in-memory storage: nothing is persisted)
+    const auto persistedHeader = pageBuffer.getUserHeader();
+    const bool reopen = persistedHeader.size() == sizeof(Header);
+    if (reopen) {
+        std::memcpy(&header, persistedHeader.data(), sizeof(Header));
     } else {
-        fd = open(headerFile.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-        if (fd < 0) {
-            util::raise("Could not create the btree header!");
-        }
         header.rootID = pageBuffer.createPage();
         auto& rootPage = pageBuffer.pinPage(header.rootID, true, true);
         // initialize the root node (leaf)
         initializeNode(rootPage, true);
         pageBuffer.unpinPage(rootPage, true);
-        if (ftruncate(fd, sizeof(Header)) < 0) {
-            util::raise("Could not increase the file size (btree).");
+    }
+    rootReference = header.rootID;
+    if (options.writeAheadLog) {
+        if (!options.logStructured) {
+            util::raise("The write-ahead log requires the log-structured mode!");
+        }
+        file::io::IOBackendOptions walOptions;
+        walOptions.type = options.io.type == file::io::IOBackendType::MEMORY ? file::io::IOBackendType::MEMORY
+                                                                              : file::io::IOBackendType::POSIX;
+        walOptions.throttle = options.io.throttle;
+        wal = std::make_unique<file::WriteAheadLog>(path + "/wal", walOptions, options.groupCommitDelay);
+        if (!reopen) {
+            // the log is replayed onto the last checkpoint (the empty tree)
+            flush();
         }
+        recover();
     }
+    pageBuffer.setRelocationHook([this](const std::vector<std::uint64_t>& pageIDs) {
+        return relocatePages(pageIDs);
+    });
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+BTree<K, V, B, N>::~BTree() {
+    // the background compaction must not access the members destroyed
+    // before the page buffer
+    pageBuffer.setRelocationHook({});
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
@@ -128,12 +215,12 @@ BTree<K, V, B, N>::accessNode(PageT& page) const {
 template<class K, class V, std::size_t B, std::size_t N>
 typename BTree<K, V, B, N>::PageT&
 BTree<K, V, B, N>::splitLeafNode(typename BNodeWrapperT::BLeafNodeT& leafNode,
-                                 K& resultKey) {
+                                 K& resultKey, std::uint64_t hintID) {
     assert(leafNode.size >= 2);
     const std::size_t splitIndex = (leafNode.size - 1) / 2;
     resultKey = leafNode.keys[splitIndex];
-    // create a new leaf node
-    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+    // create a new leaf node (next to the split one)
+    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(hintID), true, true);
     initializeNode(rightPage, true);
     assert(accessNode(rightPage).isLeaf());
     auto& rightLeaf = accessNode(rightPage).asLeaf();
@@ -153,12 +240,12 @@ BTree<K, V, B, N>::splitLeafNode(typename BNodeWrapperT::BLeafNodeT& leafNode,
 template<class K, class V, std::size_t B, std::size_t N>
 typename BTree<K, V, B, N>::PageT&
 BTree<K, V, B, N>::splitInnerNode(typename BNodeWrapperT::BInnerNodeT& innerNode,
-                                  K& resultKey) {
+                                  K& resultKey, std::uint64_t hintID) {
     assert(innerNode.size >= 2);
     const std::size_t splitIndex = (innerNode.size - 1) / 2;
     resultKey = innerNode.pivots[splitIndex];
-    // create a new inner node
-    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+    // create a new inner node (next to the split one)
+    auto& rightPage = pageBuffer.pinPage(pageBuffer.createPage(hintID), true, true);
     initializeNode(rightPage, false);
     assert(!accessNode(rightPage).isLeaf());
     auto& rightInnerNode = accessNode(rightPage).asInner();
@@ -187,12 +274,11 @@ bool BTree<K, V, B, N>::insertTraversal(K key, V value, PageT* parentPage,
                                     parentNode.pivots.begin() + parentNode.size,
                                     key);
     std::size_t pivotIndex = pivotIt - parentNode.pivots.begin();
-    std::uint64_t childID = parentNode.children[pivotIndex];
     // pin the child
-    PageT& childPage = pageBuffer.pinPage(childID, false, false,
-                                          [exclusiveMode, this](PageT& page) {
-                                              return exclusiveMode || accessNode(page).isLeaf();
-                                          });
+    PageT& childPage = pageBuffer.pinSwizzled(parentNode.children[pivotIndex], false,
+                                              [exclusiveMode, this](PageT& page) {
+                                                  return exclusiveMode || accessNode(page).isLeaf();
+                                              });
     if (!exclusiveMode) {
         pageBuffer.unpinPage(*parentPage, false);
     }
@@ -214,7 +300,7 @@ bool BTree<K, V, B, N>::insertTraversal(K key, V value, PageT* parentPage,
                     return false;
                 }
                 K middleKey;
-                PageT& rightPage = splitLeafNode(leafNode, middleKey);
+                PageT& rightPage = splitLeafNode(leafNode, middleKey, childPage.id);
                 // insert the pivot
                 std::move_backward(parentNode.pivots.begin() + pivotIndex,
                                    parentNode.pivots.begin() + parentNode.size,
@@ -284,7 +370,7 @@ bool BTree<K, V, B, N>::insertTraversal(K key, V value, PageT* parentPage,
             // check if we need to split
             if (innerNode.size == innerNode.pivots.size() && exclusiveMode) {
                 K middleKey;
-                PageT& rightPage = splitInnerNode(innerNode, middleKey);
+                PageT& rightPage = splitInnerNode(innerNode, middleKey, childPage.id);
                 // insert the pivot
                 std::move_backward(parentNode.pivots.begin() + pivotIndex,
                                    parentNode.pivots.begin() + parentNode.size,
@@ -340,9 +426,9 @@ bool BTree<K, V, B, N>::handleRootInnerInsert(K key, V value,
         // full root -> split it preemptively
         K middleKey;
         // <rightPage> is automatically uniquely pinned
-        PageT& rightPage = splitInnerNode(innerNode, middleKey);
+        PageT& rightPage = splitInnerNode(innerNode, middleKey, rootPage->id);
         // create a new root
-        PageT& newRoot = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+        PageT& newRoot = pageBuffer.pinPage(pageBuffer.createPage(rootPage->id), true, true);
         {
             // first initialize the new inner node
             initializeNode(newRoot, false);
@@ -402,9 +488,9 @@ void BTree<K, V, B, N>::handleRootLeafInsert(K key, V value, PageT* rootPage) {
         // full leaf -> split it
         K middleKey;
         // <rightPage> is automatically uniquely pinned
-        PageT& rightPage = splitLeafNode(leafNode, middleKey);
+        PageT& rightPage = splitLeafNode(leafNode, middleKey, rootPage->id);
         // create a new root
-        PageT& newRoot = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+        PageT& newRoot = pageBuffer.pinPage(pageBuffer.createPage(rootPage->id), true, true);
         {
             // first initialize the new inner node
             initializeNode(newRoot, false);
@@ -460,7 +546,7 @@ void BTree<K, V, B, N>::handleRootLeafInsert(K key, V value, PageT* rootPage) {
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
-void BTree<K, V, B, N>::insert(K key, V value) {
+void BTree<K, V, B, N>::applyInsert(K key, V value) {
     PageT* rootPage = &pageBuffer.pinPage(header.rootID, header.leafRoot);
     // first case: the root node is a leaf node
     if (accessNode(*rootPage).isLeaf()) {
@@ -478,7 +564,7 @@ void BTree<K, V, B, N>::insert(K key, V value) {
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
-void BTree<K, V, B, N>::update(K key, V value) {
+void BTree<K, V, B, N>::applyUpdate(K key, V value) {
     PageT* currentPage = &pageBuffer.pinPage(header.rootID, false);
     // after a few inserts, the root will be an inner node
     if (accessNode(*currentPage).isLeaf()) {
@@ -493,12 +579,11 @@ void BTree<K, V, B, N>::update(K key, V value) {
                                       currentNode.pivots.begin() + currentNode.size,
                                       key);
         std::size_t keyIndex = keyIt - currentNode.pivots.begin();
-        std::uint64_t childID = currentNode.children[keyIndex];
         // pin the child
-        PageT* childPage = &pageBuffer.pinPage(childID, false, false,
-                                               [this](PageT& page) {
-                                                   return accessNode(page).isLeaf();
-                                               });
+        PageT* childPage = &pageBuffer.pinSwizzled(currentNode.children[keyIndex], false,
+                                                   [this](PageT& page) {
+                                                       return accessNode(page).isLeaf();
+                                                   });
         // unpin the parent
         pageBuffer.unpinPage(*currentPage, false);
         // set the current page to the child
@@ -521,7 +606,7 @@ void BTree<K, V, B, N>::update(K key, V value) {
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
-void BTree<K, V, B, N>::erase(const K& key) {
+void BTree<K, V, B, N>::applyErase(const K& key) {
     PageT* currentPage = &pageBuffer.pinPage(header.rootID, false);
     // after a few inserts, the root will be an inner node
     if (accessNode(*currentPage).isLeaf()) {
@@ -536,12 +621,11 @@ void BTree<K, V, B, N>::erase(const K& key) {
                                       currentNode.pivots.begin() + currentNode.size,
                                       key);
         std::size_t keyIndex = keyIt - currentNode.pivots.begin();
-        std::uint64_t childID = currentNode.children[keyIndex];
         // pin the child
-        PageT* childPage = &pageBuffer.pinPage(childID, false, false,
-                                               [this](PageT& page) {
-                                                   return accessNode(page).isLeaf();
-                                               });
+        PageT* childPage = &pageBuffer.pinSwizzled(currentNode.children[keyIndex], false,
+                                                   [this](PageT& page) {
+                                                       return accessNode(page).isLeaf();
+                                                   });
         // unpin the parent
         pageBuffer.unpinPage(*currentPage, false);
         // set the current page to the child
@@ -572,8 +656,116 @@ void BTree<K, V, B, N>::erase(const K& key) {
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
+void BTree<K, V, B, N>::apply(const LogRecord& record) {
+    if (record.type == LogRecord::INSERT) {
+        applyInsert(record.key, record.value);
+    } else if (record.type == LogRecord::UPDATE) {
+        applyUpdate(record.key, record.value);
+    } else {
+        assert(record.type == LogRecord::ERASE);
+        applyErase(record.key);
+    }
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+void BTree<K, V, B, N>::perform(LogRecord record) {
+    std::shared_lock operationLock(checkpointLatch);
+    if (!wal) {
+        apply(record);
+        return;
+    }
+    static_assert(std::is_trivially_copyable_v<LogRecord>);
+    const auto keyBytes = std::span(reinterpret_cast<const unsigned char*>(&record.key), sizeof(K));
+    std::unique_lock lock(logMutexes[file::checksum(keyBytes) % LOG_STRIPES]);
+    const std::uint64_t lsn = wal->append(std::span(reinterpret_cast<const unsigned char*>(&record), sizeof(record)));
+    apply(record);
+    lock.unlock();
+    // a checkpoint does not have to wait for the sync
+    operationLock.unlock();
+    wal->commit(lsn);
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+void BTree<K, V, B, N>::recover() {
+    std::size_t replayed = 0;
+    // the operations up to the saved log sequence number are applied already
+    wal->replay([this, &replayed](std::span<const unsigned char> record) {
+        if (record.size() != sizeof(LogRecord)) {
+            util::raise("Invalid write-ahead log record (btree).");
+        }
+        LogRecord logRecord;
+        std::memcpy(&logRecord, record.data(), record.size());
+        apply(logRecord);
+        replayed++;
+    }, header.lsn);
+    if (replayed > 0) {
+        // checkpoint: the replayed operations are not logged again
+        flush();
+    }
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+void BTree<K, V, B, N>::insert(K key, V value) {
+    perform({std::move(key), std::move(value), LogRecord::INSERT});
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+void BTree<K, V, B, N>::update(K key, V value) {
+    perform({std::move(key), std::move(value), LogRecord::UPDATE});
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+void BTree<K, V, B, N>::erase(const K& key) {
+    perform({key, V(), LogRecord::ERASE});
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+bool BTree<K, V, B, N>::findOptimistic(const K& key, std::optional<V>& result) {
+    std::uint64_t version;
+    PageT* currentPage = pageBuffer.beginRead(std::atomic_ref(rootReference).load(std::memory_order_relaxed), version);
+    while (currentPage) {
+        // the sizes may be garbage until the node is validated
+        auto& currentWrapper = accessNode(*currentPage);
+        if (currentWrapper.isLeaf()) {
+            auto& leafNode = currentWrapper.asLeafUnchecked();
+            const std::size_t size = std::min<std::size_t>(leafNode.size, leafNode.keys.size());
+            auto keyIt = std::lower_bound(leafNode.keys.begin(), leafNode.keys.begin() + size, key);
+            std::size_t keyIndex = keyIt - leafNode.keys.begin();
+            std::optional<V> value;
+            if (keyIndex < size && *keyIt == key) {
+                value = leafNode.values[keyIndex];
+            }
+            if (!pageBuffer.validateRead(*currentPage, version)) {
+                return false;
+            }
+            result = std::move(value);
+            return true;
+        }
+        auto& currentNode = currentWrapper.asInnerUnchecked();
+        const std::size_t size = std::min<std::size_t>(currentNode.size, currentNode.pivots.size());
+        auto keyIt = std::lower_bound(currentNode.pivots.begin(), currentNode.pivots.begin() + size, key);
+        std::size_t keyIndex = keyIt - currentNode.pivots.begin();
+        const std::uint64_t childReference =
+                std::atomic_ref(currentNode.children[keyIndex]).load(std::memory_order_relaxed);
+        std::uint64_t childVersion;
+        PageT* childPage = pageBuffer.beginRead(childReference, childVersion);
+        // the reference was valid when the child version was read
+        if (!pageBuffer.validateRead(*currentPage, version)) {
+            return false;
+        }
+        currentPage = childPage;
+        version = childVersion;
+    }
+    return false;
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
 std::optional<V> BTree<K, V, B, N>::find(const K& key) {
-    PageT* currentPage = &pageBuffer.pinPage(header.rootID, false);
+    // the inner nodes are only read (no latch or pin is written)
+    if (std::optional<V> result; findOptimistic(key, result)) {
+        return result;
+    }
+    PageT* currentPage = &pageBuffer.pinSwizzled(rootReference, false);
     while (!accessNode(*currentPage).isLeaf()) {
         auto& currentNode = accessNode(*currentPage).asInner();
         // search for the key index
@@ -581,9 +773,8 @@ std::optional<V> BTree<K, V, B, N>::find(const K& key) {
                                       currentNode.pivots.begin() + currentNode.size,
                                       key);
         std::size_t keyIndex = keyIt - currentNode.pivots.begin();
-        std::uint64_t childID = currentNode.children[keyIndex];
         // pin the child
-        PageT* childPage = &pageBuffer.pinPage(childID, false);
+        PageT* childPage = &pageBuffer.pinSwizzled(currentNode.children[keyIndex], false);
         // unpin the parent
         pageBuffer.unpinPage(*currentPage, false);
         // set the current page to the child
@@ -611,11 +802,103 @@ std::size_t BTree<K, V, B, N>::pageAmount() const {
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
+file::io::IOStatisticsSnapshot BTree<K, V, B, N>::getStatistics() const {
+    auto result = pageBuffer.getStatistics();
+    if (wal) {
+        result += wal->getStatistics();
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+std::size_t BTree<K, V, B, N>::compact(double maxFillRatio) {
+    return pageBuffer.compact(maxFillRatio);
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+std::size_t BTree<K, V, B, N>::relocatePages(const std::vector<std::uint64_t>& pageIDs) {
+    std::shared_lock operationLock(checkpointLatch);
+    std::unordered_set<std::uint64_t> relocations(pageIDs.begin(), pageIDs.end());
+    // the root id never changes
+    relocations.erase(header.rootID);
+    std::size_t result = 0;
+    // level order traversal (the parent stays locked while its children
+    // are relocated)
+    std::queue<std::uint64_t> queue;
+    queue.push(header.rootID);
+    while (!queue.empty() && !relocations.empty()) {
+        PageT& page = pageBuffer.pinPage(queue.front(), true);
+        queue.pop();
+        if (accessNode(page).isLeaf()) {
+            pageBuffer.unpinPage(page, false);
+            continue;
+        }
+        auto& innerNode = accessNode(page).asInner();
+        bool dirty = false;
+        std::vector<std::uint64_t> childIDs;
+        for (std::size_t i = 0; i < innerNode.size + 1; i++) {
+            childIDs.push_back(PageBufferT::unswizzle(innerNode.children[i]));
+        }
+        pageBuffer.prefetch(childIDs);
+        for (std::size_t i = 0; i < innerNode.size + 1; i++) {
+            const std::uint64_t childID = childIDs[i];
+            const bool relocate = relocations.contains(childID);
+            PageT& childPage = pageBuffer.pinPage(childID, relocate);
+            if (relocate) {
+                pageBuffer.relocatePage(childPage, pageBuffer.createPage(page.id));
+                innerNode.children[i] = childPage.id;
+                relocations.erase(childID);
+                dirty = true;
+                result++;
+            }
+            if (!accessNode(childPage).isLeaf()) {
+                queue.push(childPage.id);
+            }
+            pageBuffer.unpinPage(childPage, relocate);
+        }
+        pageBuffer.unpinPage(page, dirty);
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
 void BTree<K, V, B, N>::flush() {
-    if (pwrite(fd, &header, sizeof(Header), 0) != sizeof(Header)) {
-        util::raise("Could not save the header (btree).");
+    if (wal) {
+        header.lsn = wal->lastLSN();
     }
+    pageBuffer.setUserHeader(std::span(reinterpret_cast<const unsigned char*>(&header), sizeof(Header)));
+    // the pages and the header are committed at once (durable)
     pageBuffer.flush();
+    if (wal) {
+        // the logged operations are redundant once the checkpoint is durable
+        // note: a crash before -> the replay skips them (see Header::lsn)
+        wal->truncate(header.lsn);
+    }
+}
+// --------------------------------------------------------------------------
+template<class K, class V, std::size_t B, std::size_t N>
+void BTree<K, V, B, N>::checkpoint() {
+    std::unique_lock checkpointLock(checkpointMutex);
+    Header persistedHeader;
+    typename buffer::PageBuffer<B, N>::Checkpoint pages;
+    std::uint64_t lsn = 0;
+    {
+        // no operation is in progress -> the copies are a consistent state
+        std::unique_lock latch(checkpointLatch);
+        persistedHeader = header;
+        if (wal) {
+            lsn = wal->lastLSN();
+        }
+        persistedHeader.lsn = lsn;
+        pageBuffer.setUserHeader(std::span(reinterpret_cast<const unsigned char*>(&persistedHeader), sizeof(Header)));
+        pages = pageBuffer.beginCheckpoint();
+    }
+    // the pages and the header are committed at once (durable)
+    pageBuffer.writeCheckpoint(std::move(pages));// IO write + sync
+    if (wal) {
+        // the operations logged later are not part of the checkpoint
+        wal->truncate(lsn);
+    }
 }
 // --------------------------------------------------------------------------
 template<class K, class V, std::size_t B, std::size_t N>
@@ -650,7 +933,7 @@ std::ostream& operator<<(std::ostream& out, BTree<K, V, B, N>& tree) {
             std::cout << ")";
             std::cout << "\"];\n";
             for (std::size_t i = 0; i < innerNode.size + 1; i++) {
-                std::uint64_t childID = innerNode.children[i];
+                std::uint64_t childID = buffer::PageBuffer<B, N>::unswizzle(innerNode.children[i]);
                 std::cout << currentID << " -> " << childID << ";\n";
                 queue.push(childID);
             }
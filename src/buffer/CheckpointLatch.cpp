@@ -0,0 +1,33 @@
+#include "CheckpointLatch.h"
+// --------------------------------------------------------------------------
+namespace buffer {
+// --------------------------------------------------------------------------
+void CheckpointLatch::lock_shared() {
+    while (true) {
+        pending.wait(true);
+        mutex.lock_shared();
+        if (!pending) {
+            return;
+        }
+        // the checkpoint goes first
+        mutex.unlock_shared();
+    }
+}
+// --------------------------------------------------------------------------
+void CheckpointLatch::unlock_shared() {
+    mutex.unlock_shared();
+}
+// --------------------------------------------------------------------------
+void CheckpointLatch::lock() {
+    pending = true;
+    mutex.lock();
+}
+// --------------------------------------------------------------------------
+void CheckpointLatch::unlock() {
+    pending = false;
+    mutex.unlock();
+    pending.notify_all();
+}
+// --------------------------------------------------------------------------
+}// namespace buffer
+// --------------------------------------------------------------------------
@@ -0,0 +1,29 @@
+#ifndef B_EPSILON_CHECKPOINTLATCH_H
+#define B_EPSILON_CHECKPOINTLATCH_H
+// --------------------------------------------------------------------------
+#include <atomic>
+#include <shared_mutex>
+// --------------------------------------------------------------------------
+namespace buffer {
+// --------------------------------------------------------------------------
+class CheckpointLatch {
+    // the modifying operations hold the latch shared, a checkpoint holds it
+    // exclusively while it copies the dirty pages (no half done operation)
+    // - a waiting checkpoint stops new operations, so it is not starved by
+    //   the overlapping ones
+    // - usable with std::shared_lock and std::unique_lock
+
+private:
+    std::shared_mutex mutex;
+    std::atomic_bool pending = false;// a checkpoint waits for the latch
+
+public:
+    void lock_shared();
+    void unlock_shared();
+    void lock();
+    void unlock();
+};
+// --------------------------------------------------------------------------
+}// namespace buffer
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_CHECKPOINTLATCH_H
@@ -9,6 +9,7 @@
 #include <atomic>
 #include <cinttypes>
 #include <cstddef>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -23,9 +24,13 @@ class PageBuffer;
 // --------------------------------------------------------------------------
 template<std::size_t B>
 struct Page {
-    alignas(alignof(std::max_align_t)) std::array<unsigned char, B> data = {};
+    static constexpr std::size_t ALIGNMENT = (B % 4096 == 0) ? 4096 : alignof(std::max_align_t);
+
+    std::array<unsigned char, B>& data;
     std::uint64_t id = -1;
 
+    explicit Page(std::array<unsigned char, B>& data) : data(data) {}
+
 private:
     std::shared_mutex mutex;
     std::atomic_size_t pins = 0;// protects the page from eviction
@@ -43,11 +48,16 @@ class PageBuffer {
     };
     static_assert(sizeof(Header) <= B);
 
+    struct alignas(Page<B>::ALIGNMENT) Frame {
+        std::array<unsigned char, B> data = {};
+    };
+
 private:
     int fd;
     Header header;
     // pages loaded into memory
-    std::array<Page<B>, N> pages;
+    std::unique_ptr<Frame[]> frames;
+    std::deque<Page<B>> pages;
 
 public:
     PageBuffer() = delete;
@@ -71,7 +81,11 @@ public:
 };
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
-PageBuffer<B, N>::PageBuffer(const std::string& path, double) : pages() {
+PageBuffer<B, N>::PageBuffer(const std::string& path, double)
+    : frames(std::make_unique<Frame[]>(N)) {
+    for (std::size_t index = 0; index < N; index++) {
+        pages.emplace_back(frames[index].data);
+    }
     std::string filePath = path + "/pages";
     if (std::filesystem::exists(filePath) && std::filesystem::is_regular_file(path)) {
         std::size_t fileSize = std::filesystem::file_size(filePath);
@@ -79,7 +93,7 @@ PageBuffer<B, N>::PageBuffer(const std::string& path, double) : pages() {
             util::raise("Invalid file size.");
         }
         fd = open(filePath.c_str(), O_RDWR);
-        if (pread(fd, pages.data(), B * N, 0) != B * N) {
+        if (pread(fd, frames.get(), B * N, 0) != B * N) {
             util::raise("Invalid file!");
         }
     } else {
@@ -139,7 +153,7 @@ void PageBuffer<B, N>::flush() {
     if (pwrite(fd, &header, sizeof(Header), 0) != sizeof(Header)) {
         util::raise("Could not save the header (buffer file).");
     }
-    if (pwrite(fd, pages.data(), B * header.idCounter, 0) != B * header.idCounter) {
+    if (pwrite(fd, frames.get(), B * header.idCounter, 0) != B * header.idCounter) {
         util::raise("Could not save the pages (buffer file).");
     }
 }
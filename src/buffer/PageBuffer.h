@@ -1,20 +1,32 @@
 #ifndef B_EPSILON_PAGEBUFFER_H
 #define B_EPSILON_PAGEBUFFER_H
 // --------------------------------------------------------------------------
+#include "queue/ClockQueue.h"
 #include "queue/FIFOQueue.h"
 #include "queue/LRUQueue.h"
 #include "src/file/SegmentManager.h"
 #include "src/util/ErrorHandler.h"
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
 #include <cinttypes>
+#include <condition_variable>
 #include <cstddef>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <gtest/gtest.h>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
+#include <span>
 #include <string>
-#include <unordered_set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 // --------------------------------------------------------------------------
 namespace buffer {
 // --------------------------------------------------------------------------
@@ -23,77 +35,702 @@ class PageBuffer;
 // --------------------------------------------------------------------------
 template<std::size_t B>
 struct Page {
-    alignas(alignof(std::max_align_t)) std::array<unsigned char, B> data = {};
+    // frames of 4 KiB multiples can be transferred with O_DIRECT
+    static constexpr std::size_t ALIGNMENT = (B % 4096 == 0) ? 4096 : alignof(std::max_align_t);
+
+    // the frame lives in the (aligned) frame memory of the buffer
+    std::array<unsigned char, B>& data;
     std::uint64_t id = -1;
 
+    explicit Page(std::array<unsigned char, B>&);
+
+    // hybrid latch: the exclusive lock increments the version twice (odd
+    // while locked) -> optimistic readers validate their reads with it
+    void lock();
+    void unlock();
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+
 private:
     std::shared_mutex mutex;
+    // the swizzling stores to the references in the page while it is
+    // latched shared -> the copies of the page (writes, checkpoint) hold it
+    // as well, a swizzling skips the store if it is taken
+    std::mutex referenceMutex;
+    std::atomic_uint64_t version = 0;
     std::atomic_size_t pins = 0;// protects the page from eviction
     std::atomic_bool dirty = false;
+    // pinned through a swizzled reference (which skips the 2Q update) ->
+    // the page gets a second chance before it is evicted
+    // note: CLOCK: the reference bit, set by every pin
+    std::atomic_bool referenced = false;
+    // copied by the running checkpoint, but not written yet -> an eviction
+    // has to write the page even if it is clean
+    std::atomic_bool checkpointing = false;
     // just the buffer can access the metadata
     template<std::size_t BLOCK, std::size_t N>
     friend class PageBuffer;
+    FRIEND_TEST(PageBuffer, SwizzlingWhileCopied);
 };
 // --------------------------------------------------------------------------
+template<std::size_t B>
+Page<B>::Page(std::array<unsigned char, B>& data) : data(data) {
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void Page<B>::lock() {
+    mutex.lock();
+    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    // the modifications must not become visible before the odd version
+    std::atomic_thread_fence(std::memory_order_release);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void Page<B>::unlock() {
+    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    mutex.unlock();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void Page<B>::lock_shared() {
+    mutex.lock_shared();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+bool Page<B>::try_lock_shared() {
+    return mutex.try_lock_shared();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void Page<B>::unlock_shared() {
+    mutex.unlock_shared();
+}
+// --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
 class PageBuffer {
 
+    struct alignas(Page<B>::ALIGNMENT) Frame {
+        std::array<unsigned char, B> data = {};
+    };
+    static_assert(sizeof(Frame) == B);
+
+    // the page table is split into partitions (by page id) with their own
+    // frames, replacement state and latch -> pins of pages in different
+    // partitions do not contend
+    // note: a partition keeps at least 256 frames (a page is only evicted
+    // within its partition)
+    struct alignas(64) Partition {
+        // pageTable contains all currently loaded pages of the partition
+        std::unordered_map<std::uint64_t, std::size_t> pageTable;// id -> index
+        std::vector<std::size_t> freeSlots;// stack
+        // the 2Q only handle pages with zero pins
+        queue::FIFOQueue<std::uint64_t, std::size_t> fifoQueue;// id -> index
+        queue::LRUQueue<std::uint64_t, std::size_t> lruQueue;  // id -> index
+        // CLOCK: all frames of the partition (free ones included)
+        queue::ClockQueue clock;
+        mutable std::shared_mutex tableMutex;
+        // odd while the cleaner pins pages of the partition
+        std::atomic_uint64_t cleanerVersion = 0;
+        // pages removed from the table (with the exclusive latch) by the
+        // low bits of the id, a page read while it was not loaded is still
+        // current if its counter is unchanged
+        std::array<std::size_t, 64> removals = {};
+    };
+
+    // set in the pins while the page is (re)assigned to a frame, the pins
+    // through swizzled references back off
+    static constexpr std::size_t CLAIMED = std::size_t(1) << 63;
+
+    // swizzled reference: [1 | frame (24 bits) | segment (15 bits) | block (24 bits)]
+    // (the block ids are segment << 48 | block, ids which do not fit stay
+    // plain, a plain id never sets the top bit)
+    static constexpr std::uint64_t SWIZZLED = std::uint64_t(1) << 63;
+    static constexpr std::size_t BLOCK_BITS = 24;
+    static constexpr std::size_t SEGMENT_BITS = 15;
+    static constexpr std::size_t FRAME_SHIFT = BLOCK_BITS + SEGMENT_BITS;
+    static_assert(N < (std::size_t(1) << (63 - FRAME_SHIFT)));
+
+public:
+    static constexpr std::size_t PARTITIONS = std::bit_floor(std::clamp<std::size_t>(N / 256, 1, 64));
+
 private:
     file::SegmentManager<B> segmentManager;
-    // pages loaded into memory
-    std::array<Page<B>, N> pages;
-    // pageTable contains all currently loaded pages
-    std::unordered_map<std::uint64_t, std::size_t> pageTable;// id -> index
-    std::unordered_set<std::size_t> freeSlots;
-    // the 2Q only handle pages with zero pins
-    queue::FIFOQueue<std::uint64_t, std::size_t> fifoQueue;// id -> index
-    queue::LRUQueue<std::uint64_t, std::size_t> lruQueue;  // id -> index
-    mutable std::shared_mutex tableMutex;
+    // frame memory (one allocation, aligned for O_DIRECT)
+    std::unique_ptr<Frame[]> frames;
+    // pages loaded into memory (a deque since pages can't be moved)
+    std::deque<Page<B>> pages;
+    std::array<Partition, PARTITIONS> partitions;
+    const bool swizzling;
+    const file::ReplacementPolicy replacementPolicy;
+    // CLOCK: the position of every frame in the ring of its partition
+    std::unique_ptr<std::size_t[]> clockSlots;
+    // background page cleaners: write the dirty pages at the cold end of
+    // the queues, so that an eviction rarely has to write its victim
+    // (see StorageOptions::pageCleanerThreads)
+    const std::size_t cleanerWindow;
+    const std::chrono::milliseconds cleanerInterval;
+    // free frame reserve of every partition, refilled by the cleaners (see
+    // StorageOptions::evictorLowWatermark)
+    const std::size_t evictorLowWatermark;
+    const std::size_t evictorHighWatermark;
+    std::shared_mutex cleaningMutex;// shared by a cleaning round, exclusive by flush
+    std::mutex cleanerThreadMutex;
+    std::condition_variable cleanerCondition;
+    bool stopCleaners = false;
+    std::size_t cleanerWakeups = 0;// requested rounds (see wakeCleaners)
+    std::vector<std::thread> cleanerThreads;
+    // the first error of a background thread (cleaner, compaction), raised
+    // by the next flush or pin (the pages it could not write stay dirty)
+    std::mutex backgroundErrorMutex;
+    std::exception_ptr backgroundError;
+    std::atomic_bool backgroundFailed = false;
+    // compaction: the relocations run under the mutex, which the flush
+    // holds as well (the written pages must not reference released blocks)
+    // (see StorageOptions::compactionInterval)
+    const std::chrono::milliseconds compactionInterval;
+    const double compactionFillRatio;
+    std::mutex compactionMutex;
+    std::condition_variable compactionCondition;
+    bool stopCompaction = false;
+    std::function<std::size_t(const std::vector<std::uint64_t>&)> relocationHook;
+    std::thread compactionThread;
 
 public:
     PageBuffer() = delete;
-    PageBuffer(const std::string&, double);
+    PageBuffer(const std::string&, double, const file::StorageOptions& = {});
     PageBuffer(const PageBuffer<B, N>&) = delete;
     PageBuffer(PageBuffer<B, N>&&) noexcept = default;
+    ~PageBuffer();
 
 private:
+    // raises for invalid combinations (before any file is created)
+    static const file::StorageOptions& checkOptions(const file::StorageOptions&);
+    Partition& getPartition(std::uint64_t);
+    std::size_t getIndex(const Page<B>&) const;
+    // the page whose frame contains the address (nullptr if none does)
+    Page<B>* findFramePage(const void*);
+    // sets CLAIMED if the page has exactly the given pins
+    bool claimPage(Page<B>&, std::size_t);
+    void releasePage(Page<B>&);
+    // replacement policy (2Q or CLOCK), with the exclusive table latch
+    // - findVictim: the frame of a resident page which fulfills the
+    //   predicate (the shared latch suffices)
+    // - keepVictim: a victim which was referenced meanwhile gets a second
+    //   chance, false if it was not
+    template<class Predicate>
+    std::optional<std::size_t> findVictim(Partition&, const Predicate&);
+    bool keepVictim(Partition&, std::uint64_t, std::size_t);
+    void insertPage(Partition&, std::uint64_t, std::size_t);
+    void removePage(Partition&, std::uint64_t);
     void loadPage(std::uint64_t, std::size_t);
     void savePage(std::size_t);
+    // cleaner t takes care of the partitions t, t + threads, ...
+    void cleanInBackground(std::size_t, std::size_t);
+    // starts a cleaning round before the interval is over
+    void wakeCleaners();
+    // keeps the error of a background thread (the first one until raised)
+    void recordBackgroundError(std::exception_ptr);
+    // rethrows the recorded error (once)
+    void raiseBackgroundError();
+    // writes the dirty, unpinned pages at the cold end of the queues
+    void cleanPartition(Partition&);
+    // evicts clean pages until the partition has evictorHighWatermark free
+    // frames (if it has less than evictorLowWatermark)
+    void evictPartition(Partition&);
+    // removes a frame from the partition: a free one or the one of an
+    // evicted page (written if dirty), waits for a page to be unpinned
+    std::size_t takeFrame(Partition&);
+    // compacts every compactionInterval (as long as there is a hook)
+    void compactInBackground();
+    // relocates the pages of the selected segments through the hook (with
+    // the compaction mutex)
+    std::size_t relocatePages(double);
+    FRIEND_TEST(PageBuffer, FreeFrameReserveWakeUp);
+    FRIEND_TEST(PageBuffer, RelocationKeepsPartitionSizes);
+    FRIEND_TEST(PageBuffer, SwizzlingWhileCopied);
+    FRIEND_TEST(PageBuffer, CleanerError);
+    FRIEND_TEST(PageBuffer, CompactionError);
 
 public:
     std::uint64_t createPage();
+    // creates a page which is stored close to the given page
+    std::uint64_t createPage(std::uint64_t);
     // if ModeFunction != nullptr, exclusive is ignored
+    // note: raises the error of a failed background write (once, the pages
+    // stay dirty), like flush
     using ModeFunction = std::function<bool(Page<B>&)>;
     Page<B>& pinPage(std::uint64_t, bool, bool = false,
                      std::optional<ModeFunction> = std::nullopt);
+    // pointer swizzling: pins the page of a child reference stored in a
+    // (pinned) node, a swizzled reference carries the frame of the page ->
+    // no page table lookup while the page stays in that frame
+    // note: the reference is swizzled in place (atomically, the node may be
+    // pinned shared, not while the node is copied), references read from
+    // disk may point to any frame
+    Page<B>& pinSwizzled(std::uint64_t&, bool, std::optional<ModeFunction> = std::nullopt);
+    // the id of a (possibly swizzled) child reference
+    static std::uint64_t unswizzle(std::uint64_t);
+    // optimistic read of the page of a swizzled reference (no latch, no
+    // pin), returns nullptr if it is not swizzled, not resident or locked
+    // exclusively (-> pin it)
+    // note: the contents may be inconsistent (even belong to another page)
+    // until validateRead succeeds, the frame memory stays valid
+    Page<B>* beginRead(std::uint64_t, std::uint64_t&);
+    // true if the page was not modified (or replaced) since beginRead
+    bool validateRead(const Page<B>&, std::uint64_t) const;
     void unpinPage(Page<B>&, bool);
+    // announces that the pages will be pinned soon (see SegmentManager)
+    // note: pages which are already loaded are skipped
+    void prefetch(std::span<const std::uint64_t>);
+    // deletes a page which is not pinned (and not accessed anymore)
+    void deletePage(std::uint64_t);
+    // moves an exclusively pinned page to the (new) page id and deletes the
+    // old one, the page stays pinned
+    // note: the caller has to update all references to the page
+    void relocatePage(Page<B>&, std::uint64_t);
+    // relocation hook of the owner of the pages (the tree): relocates the
+    // given pages (see relocatePage), updates the references to them and
+    // returns their amount
+    // note: an empty hook disables the compaction, waits for a running one
+    using RelocationHook = std::function<std::size_t(const std::vector<std::uint64_t>&)>;
+    void setRelocationHook(RelocationHook);
+    // relocates the pages stored in sparse segments at the end of the file
+    // (see SegmentManager::beginCompaction) and returns their amount
+    // note: the space is released by the next flush, returns 0 until then
+    std::size_t compact(double);
 
     std::size_t pageAmount() const;// not thread-safe
+    // I/O of the underlying segments (see SegmentManager)
+    file::io::IOStatisticsSnapshot getStatistics() const;
+    // note: raises the error of a failed background write first (once)
     void flush();                  // not thread-safe
+    // makes the written pages durable (see SegmentManager)
+    void sync();
+    // persisted with the pages by the next flush or checkpoint (see
+    // SegmentManager::setUserHeader)
+    void setUserHeader(std::span<const unsigned char>);
+    std::span<const unsigned char> getUserHeader() const;
+
+    // fuzzy checkpoint (log-structured mode): the dirty pages are copied
+    // and written while the buffer is in use, the stored state is the one
+    // of the moment the copies were made
+    // note: in-place mode: the dirty pages are written by beginCheckpoint
+    // (while the buffer is in use as well)
+    struct Checkpoint {
+        std::vector<std::uint64_t> ids;
+        std::unique_ptr<Frame[]> frames;// the copies of the pages
+    };
+    // copies the dirty pages and snapshots the block mapping
+    // note: the caller makes sure that no page is modified meanwhile (the
+    // pages can be pinned shared, the copies do not take long)
+    Checkpoint beginCheckpoint();
+    // writes the copies and persists them (durable once it returns)
+    // note: one checkpoint at a time, not together with flush
+    void writeCheckpoint(Checkpoint);
 
     PageBuffer<B, N>& operator=(const PageBuffer<B, N>&) = delete;
     PageBuffer<B, N>& operator=(PageBuffer<B, N>&&) noexcept = default;
 };
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
-PageBuffer<B, N>::PageBuffer(const std::string& path, double growthFactor)
-    : segmentManager(path, growthFactor), pages() {
+PageBuffer<B, N>::PageBuffer(const std::string& path, double growthFactor,
+                             const file::StorageOptions& options)
+    : segmentManager(path, growthFactor, checkOptions(options)), frames(std::make_unique<Frame[]>(N)),
+      swizzling(options.swizzling), replacementPolicy(options.replacementPolicy),
+      // the cleaner pins at most half of the frames of a partition
+      cleanerWindow(std::min(options.pageCleanerWindow, N / PARTITIONS / 4)),
+      cleanerInterval(options.pageCleanerInterval),
+      // the watermarks are split among the partitions, at most half of the
+      // frames of a partition are kept free
+      evictorLowWatermark(std::min((options.evictorLowWatermark + PARTITIONS - 1) / PARTITIONS, N / PARTITIONS / 2)),
+      evictorHighWatermark(std::max(std::min((options.evictorHighWatermark + PARTITIONS - 1) / PARTITIONS,
+                                             N / PARTITIONS / 2),
+                                    evictorLowWatermark)),
+      compactionInterval(options.compactionInterval), compactionFillRatio(options.compactionFillRatio) {
+    if (replacementPolicy == file::ReplacementPolicy::CLOCK) {
+        clockSlots = std::make_unique<std::size_t[]>(N);
+        for (auto& partition: partitions) {
+            partition.clock.setSlots({clockSlots.get(), N});
+        }
+    }
     for (std::size_t index = 0; index < N; index++) {
-        freeSlots.insert(index);
+        pages.emplace_back(frames[index].data);
+        partitions[index % PARTITIONS].freeSlots.push_back(index);
+        if (replacementPolicy == file::ReplacementPolicy::CLOCK) {
+            partitions[index % PARTITIONS].clock.insert(index);
+        }
+    }
+    // more cleaners than partitions would be idle
+    const std::size_t threads = std::min(options.pageCleanerThreads, PARTITIONS);
+    for (std::size_t thread = 0; thread < threads; thread++) {
+        cleanerThreads.emplace_back(&PageBuffer<B, N>::cleanInBackground, this, thread, threads);
+    }
+    if (compactionInterval.count() > 0) {
+        compactionThread = std::thread(&PageBuffer<B, N>::compactInBackground, this);
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+PageBuffer<B, N>::~PageBuffer() {
+    if (compactionThread.joinable()) {
+        {
+            std::unique_lock lock(compactionMutex);
+            stopCompaction = true;
+        }
+        compactionCondition.notify_all();
+        compactionThread.join();
+    }
+    if (cleanerThreads.empty()) {
+        return;
+    }
+    {
+        std::unique_lock lock(cleanerThreadMutex);
+        stopCleaners = true;
+    }
+    cleanerCondition.notify_all();
+    for (auto& thread: cleanerThreads) {
+        thread.join();
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+const file::StorageOptions& PageBuffer<B, N>::checkOptions(const file::StorageOptions& options) {
+    if ((options.evictorLowWatermark > 0 || options.evictorHighWatermark > 0) && options.pageCleanerThreads == 0) {
+        util::raise("The free frame reserve requires the page cleaners!");
+    }
+    return options;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+typename PageBuffer<B, N>::Partition& PageBuffer<B, N>::getPartition(std::uint64_t id) {
+    if constexpr (PARTITIONS == 1) {
+        return partitions.front();
+    } else {
+        // the ids of neighboring pages differ in the low bits only
+        const std::uint64_t hash = id * 0x9e3779b97f4a7c15;
+        return partitions[hash >> (64 - std::countr_zero(PARTITIONS))];
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+std::size_t PageBuffer<B, N>::getIndex(const Page<B>& page) const {
+    return static_cast<std::size_t>(page.data.data() - frames[0].data.data()) / B;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+Page<B>* PageBuffer<B, N>::findFramePage(const void* address) {
+    const auto* begin = reinterpret_cast<const unsigned char*>(frames.get());
+    const auto* byte = static_cast<const unsigned char*>(address);
+    if (byte < begin || byte >= begin + N * B) {
+        return nullptr;
+    }
+    return &pages[static_cast<std::size_t>(byte - begin) / B];
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+bool PageBuffer<B, N>::claimPage(Page<B>& page, std::size_t pins) {
+    return page.pins.compare_exchange_strong(pins, pins | CLAIMED);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::releasePage(Page<B>& page) {
+    page.pins &= ~CLAIMED;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+template<class Predicate>
+std::optional<std::size_t> PageBuffer<B, N>::findVictim(Partition& partition, const Predicate& predicate) {
+    if (replacementPolicy == file::ReplacementPolicy::CLOCK) {
+        return partition.clock.findOne(
+                [this, &predicate](std::size_t index) {
+                    // a free frame has no page to evict
+                    return pages[index].id != std::uint64_t(-1) && predicate(index);
+                },
+                [this](std::size_t index) {
+                    auto& referenced = pages[index].referenced;
+                    return referenced.load(std::memory_order_relaxed) && referenced.exchange(false);
+                });
+    }
+    if (auto key = partition.fifoQueue.findOne(predicate)) {
+        return partition.fifoQueue.find(*key, false);
+    }
+    if (auto key = partition.lruQueue.findOne(predicate)) {
+        return partition.lruQueue.find(*key, false);
+    }
+    return std::nullopt;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+bool PageBuffer<B, N>::keepVictim(Partition& partition, std::uint64_t id, std::size_t index) {
+    if (!pages[index].referenced.exchange(false)) {
+        return false;
+    }
+    // CLOCK: the hand passes the frame once more
+    if (partition.fifoQueue.contains(id)) {
+        partition.fifoQueue.remove(id);
+        partition.lruQueue.insert(id, index);
+    } else if (partition.lruQueue.contains(id)) {
+        partition.lruQueue.find(id, true);
+    }
+    return true;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::insertPage(Partition& partition, std::uint64_t id, std::size_t index) {
+    // CLOCK: the frame stays in the ring
+    if (replacementPolicy == file::ReplacementPolicy::TWO_QUEUE) {
+        partition.fifoQueue.insert(id, index);
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::removePage(Partition& partition, std::uint64_t id) {
+    if (partition.fifoQueue.contains(id)) {
+        partition.fifoQueue.remove(id);
+    } else if (partition.lruQueue.contains(id)) {
+        partition.lruQueue.remove(id);
     }
 }
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
 void PageBuffer<B, N>::loadPage(std::uint64_t id, std::size_t index) {
     auto& page = pages[index];
-    page.data = std::move(segmentManager.readBlock(id));// IO read
+    segmentManager.readBlockInto(id, page.data);// IO read (directly into the frame)
 }
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
 void PageBuffer<B, N>::savePage(std::size_t index) {
     auto& page = pages[index];
-    // don't move the array to keep the page in memory valid
-    segmentManager.writeBlock(page.id, page.data);// IO write
+    std::unique_lock referenceLock(page.referenceMutex);
+    segmentManager.writeBlockFrom(page.id, page.data);// IO write (directly from the frame)
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::cleanInBackground(std::size_t thread, std::size_t threads) {
+    std::unique_lock lock(cleanerThreadMutex);
+    // the wake-ups before the thread runs count as well
+    std::size_t wakeups = 0;
+    while (true) {
+        // woken up early by an eviction which had to write its victim
+        cleanerCondition.wait_for(lock, cleanerInterval, [this, &wakeups]() {
+            return stopCleaners || cleanerWakeups != wakeups;
+        });
+        if (stopCleaners) {
+            return;
+        }
+        // a wake-up during the round starts the next one right away
+        wakeups = cleanerWakeups;
+        lock.unlock();
+        for (std::size_t index = thread; index < PARTITIONS; index += threads) {
+            cleanPartition(partitions[index]);
+            // the pages written by the round are clean now
+            evictPartition(partitions[index]);
+        }
+        lock.lock();
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::wakeCleaners() {
+    {
+        std::unique_lock lock(cleanerThreadMutex);
+        cleanerWakeups++;
+    }
+    cleanerCondition.notify_all();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::recordBackgroundError(std::exception_ptr error) {
+    std::unique_lock lock(backgroundErrorMutex);
+    if (!backgroundError) {
+        backgroundError = std::move(error);
+        backgroundFailed = true;
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::raiseBackgroundError() {
+    std::exception_ptr error;
+    {
+        std::unique_lock lock(backgroundErrorMutex);
+        error = std::move(backgroundError);
+        backgroundError = nullptr;
+        backgroundFailed = false;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::cleanPartition(Partition& partition) {
+    std::shared_lock cleaningLock(cleaningMutex);
+    std::vector<std::size_t> indexes;
+    {
+        std::shared_lock tableLock(partition.tableMutex);
+        // an eviction which finds no unpinned page has to wait for us
+        ++partition.cleanerVersion;
+        const auto collect = [&](std::size_t index) {
+            auto& page = pages[index];
+            if (page.pins == 0 && (page.dirty || page.checkpointing)) {
+                // the pin keeps the page in its frame (no claim succeeds)
+                ++page.pins;
+                indexes.push_back(index);
+            }
+        };
+        if (replacementPolicy == file::ReplacementPolicy::CLOCK) {
+            // the hand reaches these pages next (as many as in both queues,
+            // the free frames do not count)
+            partition.clock.forNext(2 * cleanerWindow, [&](std::size_t index) {
+                if (pages[index].id == std::uint64_t(-1)) {
+                    return false;
+                }
+                collect(index);
+                return true;
+            });
+        } else {
+            // the evictions take their victims from the back of the queues
+            for (const auto* list: {&partition.fifoQueue.getList(), &partition.lruQueue.getList()}) {
+                std::size_t position = 0;
+                for (auto it = list->rbegin(); it != list->rend() && position < cleanerWindow; ++it, position++) {
+                    collect(it->second);
+                }
+            }
+        }
+        if (indexes.empty()) {
+            ++partition.cleanerVersion;
+            return;
+        }
+    }
+    // write the pages as one (coalesced) batch
+    std::vector<typename file::SegmentManager<B>::BlockWrite> writes;
+    std::vector<std::shared_lock<Page<B>>> pageLocks;
+    std::vector<std::unique_lock<std::mutex>> referenceLocks;
+    for (std::size_t index: indexes) {
+        auto& page = pages[index];
+        // a page which is being modified becomes dirty again anyway, and
+        // waiting for it could deadlock with the latch coupling of the trees
+        std::shared_lock pageLock(page, std::try_to_lock);
+        if (pageLock.owns_lock()) {
+            page.dirty = false;
+            page.checkpointing = false;
+            writes.emplace_back(page.id, page.data);
+            pageLocks.push_back(std::move(pageLock));
+            referenceLocks.emplace_back(page.referenceMutex);
+        }
+    }
+    try {
+        segmentManager.writeBlocks(std::move(writes));// IO write
+    } catch (...) {
+        // the pages stay dirty, the pins are dropped below
+        for (auto& pageLock: pageLocks) {
+            pageLock.mutex()->dirty = true;
+        }
+        recordBackgroundError(std::current_exception());
+    }
+    referenceLocks.clear();
+    pageLocks.clear();
+    for (std::size_t index: indexes) {
+        --pages[index].pins;
+    }
+    ++partition.cleanerVersion;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::evictPartition(Partition& partition) {
+    // flush walks the page tables without their latches
+    std::shared_lock cleaningLock(cleaningMutex);
+    {
+        std::shared_lock tableLock(partition.tableMutex);
+        if (partition.freeSlots.size() >= evictorLowWatermark) {
+            return;
+        }
+    }
+    std::unique_lock tableLock(partition.tableMutex);
+    // the dirty pages are left to the next cleaning round
+    const auto evictable = [this](const std::size_t& index) {
+        const auto& page = pages[index];
+        return page.pins == 0 && !page.dirty && !page.checkpointing;
+    };
+    while (partition.freeSlots.size() < evictorHighWatermark) {
+        const auto victim = findVictim(partition, evictable);
+        if (!victim) {
+            break;
+        }
+        const std::size_t index = *victim;
+        auto& page = pages[index];
+        const std::uint64_t key = page.id;
+        if (keepVictim(partition, key, index)) {
+            continue;
+        }
+        if (!claimPage(page, 0)) {
+            // pinned through a swizzled reference right now
+            break;
+        }
+        removePage(partition, key);
+        partition.pageTable.erase(key);
+        ++partition.removals[key % partition.removals.size()];
+        {
+            // the optimistic readers check the id (instant, no pins)
+            std::unique_lock pageLock(page);
+            page.id = -1;
+        }
+        releasePage(page);
+        partition.freeSlots.push_back(index);
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+std::size_t PageBuffer<B, N>::takeFrame(Partition& partition) {
+    while (true) {
+        std::unique_lock tableLock(partition.tableMutex);
+        if (!partition.freeSlots.empty()) {
+            const std::size_t index = partition.freeSlots.back();
+            partition.freeSlots.pop_back();
+            return index;
+        }
+        const auto victim = findVictim(partition, [this](const std::size_t& index) {
+            return pages[index].pins == 0;
+        });
+        if (!victim) {
+            // all pages are pinned right now
+            tableLock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        const std::size_t index = *victim;
+        auto& page = pages[index];
+        const std::uint64_t key = page.id;
+        if (page.dirty || page.checkpointing) {
+            // our pin keeps the page in its frame, the table is unlocked
+            // during the write (see pinPage)
+            ++page.pins;
+            tableLock.unlock();
+            std::shared_lock pageLock(page, std::try_to_lock);
+            if (pageLock.owns_lock()) {
+                page.dirty = false;
+                page.checkpointing = false;
+                savePage(index);// IO write
+            }
+            --page.pins;
+            continue;
+        }
+        if (!claimPage(page, 0)) {
+            // pinned through a swizzled reference right now
+            continue;
+        }
+        removePage(partition, key);
+        partition.pageTable.erase(key);
+        ++partition.removals[key % partition.removals.size()];
+        {
+            // the optimistic readers check the id (instant, no pins)
+            std::unique_lock pageLock(page);
+            page.id = -1;
+        }
+        releasePage(page);
+        return index;
+    }
 }
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
@@ -102,26 +739,42 @@ std::uint64_t PageBuffer<B, N>::createPage() {
 }
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
+std::uint64_t PageBuffer<B, N>::createPage(std::uint64_t hintID) {
+    return segmentManager.createBlock(hintID);// locked segment + potential IO write
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
 Page<B>& PageBuffer<B, N>::pinPage(std::uint64_t id, bool exclusive,
                                    bool skipLoad, std::optional<ModeFunction> modeFunction) {
-    const auto lockPageTable = [this](bool exclusivePageTableLock) {
+    if (backgroundFailed.load(std::memory_order_relaxed)) {
+        // e.g. a cleaner could not write its pages
+        raiseBackgroundError();
+    }
+    auto& partition = getPartition(id);
+    auto& pageTable = partition.pageTable;
+    auto& freeSlots = partition.freeSlots;
+    auto& fifoQueue = partition.fifoQueue;
+    auto& lruQueue = partition.lruQueue;
+    const bool clock = replacementPolicy == file::ReplacementPolicy::CLOCK;
+    const auto lockPageTable = [&partition](bool exclusivePageTableLock) {
         if (exclusivePageTableLock) {
-            tableMutex.lock();
+            partition.tableMutex.lock();
         } else {
-            tableMutex.lock_shared();
+            partition.tableMutex.lock_shared();
         }
     };
-    const auto unlockPageTable = [this](bool exclusivePageTableLock) {
+    const auto unlockPageTable = [&partition](bool exclusivePageTableLock) {
         if (exclusivePageTableLock) {
-            tableMutex.unlock();
+            partition.tableMutex.unlock();
         } else {
-            tableMutex.unlock_shared();
+            partition.tableMutex.unlock_shared();
         }
     };
     bool exclusivePageTableLock = false;
     do {
         // lock the pageTable
         lockPageTable(exclusivePageTableLock);
+        const std::uint64_t cleanerVersion = partition.cleanerVersion;
         // 1) the page is already in memory
         auto pageIt = pageTable.find(id);
         if (pageIt != pageTable.end()) {
@@ -131,7 +784,12 @@ Page<B>& PageBuffer<B, N>::pinPage(std::uint64_t id, bool exclusive,
             std::size_t pins = ++page.pins;
             // unlock the page table
             assert(pins >= 1);
-            if (pins == 1) {// 0 -> 1: update position in 2Q
+            if (clock) {
+                // set the reference bit (no exclusive latch needed)
+                if (!page.referenced.load(std::memory_order_relaxed)) {
+                    page.referenced = true;
+                }
+            } else if (pins == 1) {// 0 -> 1: update position in 2Q
                 if (!exclusivePageTableLock) {
                     --page.pins;
                     unlockPageTable(exclusivePageTableLock);
@@ -153,14 +811,14 @@ Page<B>& PageBuffer<B, N>::pinPage(std::uint64_t id, bool exclusive,
                 exclusive = (*modeFunction)(page);
             }
             if (exclusive) {
-                page.mutex.lock();
+                page.lock();
             } else {
-                page.mutex.lock_shared();
+                page.lock_shared();
             }
             return page;
         }
         // 2.1) we still have space in memory
-        if (pageTable.size() < pages.size()) {
+        if (!freeSlots.empty()) {
             // the page needs to be loaded into memory
             if (!exclusivePageTableLock) {
                 unlockPageTable(exclusivePageTableLock);
@@ -169,142 +827,109 @@ Page<B>& PageBuffer<B, N>::pinPage(std::uint64_t id, bool exclusive,
             }
             assert(!freeSlots.empty());
             assert(!pageTable.contains(id));
-            std::size_t freeIndex = *freeSlots.begin();
-            freeSlots.erase(freeIndex);
+            std::size_t freeIndex = freeSlots.back();
+            freeSlots.pop_back();
+            if (freeSlots.size() + 1 == evictorLowWatermark) {
+                // the reserve ran low -> refill it
+                wakeCleaners();
+            }
             pageTable[id] = freeIndex;
             auto& page = pages[freeIndex];
-            assert(page.pins == 0);
+            // a stale swizzled reference may pin the frame for a moment
+            while (!claimPage(page, 0)) {
+                std::this_thread::yield();
+            }
+            ++page.pins;
+            // lock the page (instant) before the id changes: an optimistic
+            // reader must not take the old contents for the new page
+            std::unique_lock pageLock(page);
             // set the metadata
-            page.pins = 1;
             page.id = id;
             page.dirty = false;
-            // add the page to the 2Q
-            fifoQueue.insert(id, freeIndex);
-            // load the page
-            if (skipLoad) {
-                // unlock the queue
-                unlockPageTable(exclusivePageTableLock);
-            } else {
-                // lock the page (instant)
-                std::unique_lock pageLock(page.mutex);
-                // unlock the table
-                unlockPageTable(exclusivePageTableLock);
-                // load the page + unlock
+            page.checkpointing = false;
+            // CLOCK: the load counts as reference (the hand passes the
+            // frame once before it is evicted)
+            page.referenced = clock;
+            // add the page to the 2Q (CLOCK: the frame is in the ring)
+            insertPage(partition, id, freeIndex);
+            releasePage(page);
+            // unlock the table
+            unlockPageTable(exclusivePageTableLock);
+            if (!skipLoad) {
+                // load the page
                 loadPage(id, freeIndex);// IO read
-                // unlock the page
             }
+            // unlock the page
+            pageLock.unlock();
             // lock the page again
             if (modeFunction) {
                 exclusive = (*modeFunction)(page);
             }
             if (exclusive) {
-                page.mutex.lock();
+                page.lock();
             } else {
-                page.mutex.lock_shared();
+                page.lock_shared();
             }
             return page;
         }
-        // 2.2) we have to evict from the fifo queue
+        // 2.2) we have to evict a page
         {
-            auto key = fifoQueue.findOne([this](const std::size_t& index) {
+            auto victim = findVictim(partition, [this](const std::size_t& index) {
                 return pages[index].pins == 0;
             });
-            if (key) {
-                std::size_t pageIndex = fifoQueue.find(*key, false);
+            if (victim) {
+                std::size_t pageIndex = *victim;
                 // load the page
                 auto& page = pages[pageIndex];
+                const std::uint64_t key = page.id;
                 ++page.pins;// set page to pinned
+                // the new page, read together with the write of the victim
+                std::unique_ptr<Frame> loaded;
                 {
-                    if (page.dirty) {
-                        // mark the page as clean since we write it to disk
-                        page.dirty = false;
-                        // lock the page (instant)
-                        std::shared_lock pageLock(page.mutex);
+                    if (page.dirty || page.checkpointing) {
+                        const std::size_t removals = partition.removals[id % partition.removals.size()];
                         // unlock the queue
                         unlockPageTable(exclusivePageTableLock);
-                        // evict the old page
-                        savePage(pageIndex);// IO write
-                        // unlock the page
-                        pageLock.unlock();
-                        // re-lock the table + queue
-                        lockPageTable(true);
-                    } else {
-                        if (!exclusivePageTableLock) {
-                            // unlock the queue
-                            unlockPageTable(exclusivePageTableLock);
-                            // re-lock
-                            lockPageTable(true);
+                        // lock the page (our pin keeps it in the frame)
+                        // note: no waiting, the page may have been pinned in
+                        // the meantime (e.g. through a swizzled reference) by
+                        // a thread which waits for a page we hold
+                        std::shared_lock pageLock(page, std::try_to_lock);
+                        if (pageLock.owns_lock()) {
+                            // mark the page as clean since we write it to disk
+                            page.dirty = false;
+                            page.checkpointing = false;
+                            if (!cleanerThreads.empty()) {
+                                // the cleaners fell behind
+                                wakeCleaners();
+                            }
+                            if (skipLoad) {
+                                // evict the old page
+                                savePage(pageIndex);// IO write
+                            } else {
+                                // evict the old page and load the new one in
+                                // one batch (the new page goes to the frame
+                                // once the victim is evicted)
+                                loaded = std::make_unique<Frame>();
+                                try {
+                                    std::unique_lock referenceLock(page.referenceMutex);
+                                    segmentManager.writeAndReadBlock(key, page.data, id, loaded->data);// IO write + read
+                                } catch (...) {
+                                    page.dirty = true;
+                                    --page.pins;
+                                    throw;
+                                }
+                            }
+                            // unlock the page
+                            pageLock.unlock();
                         }
-                    }
-                }
-                if (!pageTable.contains(id) &&
-                    fifoQueue.contains(*key) &&
-                    page.pins == 1 && !page.dirty) {
-                    // the page was not accessed -> we can evict it and use it
-                    pageTable.erase(*key);
-                    fifoQueue.remove(*key);
-                    // store the index in the page table
-                    pageTable[id] = pageIndex;
-                    fifoQueue.insert(id, pageIndex);
-                    // set the metadata
-                    page.id = id;
-                    page.dirty = false;
-                    if (skipLoad) {
-                        // unlock the table + queue
-                        unlockPageTable(true);
-                    } else {
-                        // lock the page (instant because we have the only pin)
-                        std::unique_lock pageLock(page.mutex);
-                        // unlock the table + queue
-                        unlockPageTable(true);
-                        // load the new page
-                        loadPage(id, pageIndex);
-                        // unlock the page
-                        pageLock.unlock();
-                    }
-                    // lock the page again
-                    if (modeFunction) {
-                        exclusive = (*modeFunction)(page);
-                    }
-                    if (exclusive) {
-                        page.mutex.lock();
-                    } else {
-                        page.mutex.lock_shared();
-                    }
-                    return page;
-                }
-                // we can't use this page
-                --page.pins;
-                // unlock the table + queue
-                unlockPageTable(true);
-                exclusivePageTableLock = false;
-                continue;
-            }
-        }
-        // 2.3) we have to evict from the lru queue
-        {
-            auto key = lruQueue.findOne([this](const std::size_t& index) {
-                return pages[index].pins == 0;
-            });
-            if (key) {
-                std::size_t pageIndex = lruQueue.find(*key, false);
-                // load the page
-                auto& page = pages[pageIndex];
-                ++page.pins;// set page to pinned
-                {
-                    if (page.dirty) {
-                        // mark the page as clean since we write it to disk
-                        page.dirty = false;
-                        // lock the page (instant)
-                        std::shared_lock pageLock(page.mutex);
-                        // unlock the queue
-                        unlockPageTable(exclusivePageTableLock);
-                        // evict the old page
-                        savePage(pageIndex);// IO write
-                        // unlock the page
-                        pageLock.unlock();
                         // re-lock the table + queue
                         lockPageTable(true);
+                        if (partition.removals[id % partition.removals.size()] != removals) {
+                            // the new page was loaded (and possibly written)
+                            // by another thread meanwhile -> read it again
+                            loaded.reset();
+                        }
                     } else {
                         if (!exclusivePageTableLock) {
                             // unlock the queue
@@ -314,43 +939,47 @@ Page<B>& PageBuffer<B, N>::pinPage(std::uint64_t id, bool exclusive,
                         }
                     }
                 }
-                if (!pageTable.contains(id) &&
-                    lruQueue.contains(*key) &&
-                    page.pins == 1 && !page.dirty) {
+                const bool evictable = !pageTable.contains(id) && page.id == key &&
+                                       page.pins == 1 && !page.dirty && !page.checkpointing;
+                if (evictable && !keepVictim(partition, key, pageIndex) && claimPage(page, 1)) {
                     // the page was not accessed -> we can evict it and use it
-                    pageTable.erase(*key);
-                    lruQueue.remove(*key);
+                    pageTable.erase(key);
+                    removePage(partition, key);
+                    ++partition.removals[key % partition.removals.size()];
                     // store the index in the page table
                     pageTable[id] = pageIndex;
-                    fifoQueue.insert(id, pageIndex);
+                    insertPage(partition, id, pageIndex);
+                    // lock the page (instant because we have the only pin)
+                    // before the id changes (see 2.1)
+                    std::unique_lock pageLock(page);
                     // set the metadata
                     page.id = id;
                     page.dirty = false;
-                    if (skipLoad) {
-                        // unlock the table + queue
-                        unlockPageTable(true);
-                    } else {
-                        // lock the page (instant because we have the only pin)
-                        std::unique_lock pageLock(page.mutex);
-                        // unlock the table + queue
-                        unlockPageTable(true);
+                    page.checkpointing = false;
+                    page.referenced = clock;
+                    releasePage(page);
+                    // unlock the table + queue
+                    unlockPageTable(true);
+                    if (loaded) {
+                        std::copy(loaded->data.begin(), loaded->data.end(), page.data.begin());
+                    } else if (!skipLoad) {
                         // load the new page
                         loadPage(id, pageIndex);
-                        // unlock the page
-                        pageLock.unlock();
                     }
+                    // unlock the page
+                    pageLock.unlock();
                     // lock the page again
                     if (modeFunction) {
                         exclusive = (*modeFunction)(page);
                     }
                     if (exclusive) {
-                        page.mutex.lock();
+                        page.lock();
                     } else {
-                        page.mutex.lock_shared();
+                        page.lock_shared();
                     }
                     return page;
                 }
-                // we can't use this page
+                // we can't use this page (or it got a second chance)
                 --page.pins;
                 // unlock the table + queue
                 unlockPageTable(true);
@@ -358,41 +987,420 @@ Page<B>& PageBuffer<B, N>::pinPage(std::uint64_t id, bool exclusive,
                 continue;
             }
         }
+        if (cleanerVersion % 2 == 1 || partition.cleanerVersion != cleanerVersion) {
+            // the cleaner pinned the pages for a moment -> try again
+            unlockPageTable(exclusivePageTableLock);
+            exclusivePageTableLock = false;
+            std::this_thread::yield();
+            continue;
+        }
         // no free slot was found -> abort
         util::raise("Buffer is full!");
     } while (true);
 }
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
+Page<B>& PageBuffer<B, N>::pinSwizzled(std::uint64_t& reference, bool exclusive,
+                                       std::optional<ModeFunction> modeFunction) {
+    std::atomic_ref<std::uint64_t> atomicReference(reference);
+    const std::uint64_t value = atomicReference.load(std::memory_order_relaxed);
+    const std::uint64_t id = unswizzle(value);
+    if (value & SWIZZLED) {
+        const std::size_t index = (value & ~SWIZZLED) >> FRAME_SHIFT;
+        if (index < N) {
+            auto& page = pages[index];
+            // the pin keeps the page in the frame (unless it is claimed)
+            if (!(++page.pins & CLAIMED) && page.id == id) {
+                if (!page.referenced.load(std::memory_order_relaxed)) {
+                    page.referenced = true;
+                }
+                if (modeFunction) {
+                    exclusive = (*modeFunction)(page);
+                }
+                if (exclusive) {
+                    page.lock();
+                } else {
+                    page.lock_shared();
+                }
+                return page;
+            }
+            // the frame holds another page by now
+            --page.pins;
+        }
+    }
+    auto& page = pinPage(id, exclusive, false, modeFunction);
+    if (swizzling) {
+        const std::uint64_t segment = id >> 48;
+        const std::uint64_t block = id & ((std::uint64_t(1) << 48) - 1);
+        // a reference stored in a frame is not copied meanwhile
+        auto* node = findFramePage(&reference);
+        std::unique_lock<std::mutex> referenceLock;
+        if (node) {
+            referenceLock = std::unique_lock(node->referenceMutex, std::try_to_lock);
+        }
+        if ((!node || referenceLock.owns_lock()) && segment < (std::uint64_t(1) << SEGMENT_BITS) &&
+            block < (std::uint64_t(1) << BLOCK_BITS)) {
+            atomicReference.store(SWIZZLED | getIndex(page) << FRAME_SHIFT | segment << BLOCK_BITS | block,
+                                  std::memory_order_relaxed);
+        }
+    }
+    return page;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+std::uint64_t PageBuffer<B, N>::unswizzle(std::uint64_t reference) {
+    if (!(reference & SWIZZLED)) {
+        return reference;
+    }
+    const std::uint64_t segment = reference >> BLOCK_BITS & ((std::uint64_t(1) << SEGMENT_BITS) - 1);
+    const std::uint64_t block = reference & ((std::uint64_t(1) << BLOCK_BITS) - 1);
+    return segment << 48 | block;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+Page<B>* PageBuffer<B, N>::beginRead(std::uint64_t reference, std::uint64_t& version) {
+    if (!(reference & SWIZZLED)) {
+        return nullptr;
+    }
+    const std::size_t index = (reference & ~SWIZZLED) >> FRAME_SHIFT;
+    if (index >= N) {
+        return nullptr;
+    }
+    auto& page = pages[index];
+    version = page.version.load(std::memory_order_acquire);
+    // a new page is loaded into the frame under the exclusive lock
+    if (version % 2 == 1 || page.id != unswizzle(reference)) {
+        return nullptr;
+    }
+    return &page;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+bool PageBuffer<B, N>::validateRead(const Page<B>& page, std::uint64_t version) const {
+    // the reads of the page must not move behind the check
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return page.version.load(std::memory_order_relaxed) == version;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
 void PageBuffer<B, N>::unpinPage(Page<B>& page, bool dirty) {
     assert(page.pins >= 1);
     if (dirty) {
         // set page to dirty
         page.dirty = true;
     }
-    // release the page lock
-    page.mutex.unlock();
+    // release the page lock (only an exclusive holder sees an odd version)
+    if (page.version.load(std::memory_order_relaxed) % 2 == 1) {
+        page.unlock();
+    } else {
+        page.unlock_shared();
+    }
     --page.pins;
 }
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::prefetch(std::span<const std::uint64_t> ids) {
+    std::vector<std::uint64_t> missingIDs;
+    for (std::uint64_t id: ids) {
+        auto& partition = getPartition(id);
+        std::shared_lock tableLock(partition.tableMutex);
+        if (!partition.pageTable.contains(id)) {
+            missingIDs.push_back(id);
+        }
+    }
+    segmentManager.prefetch(missingIDs);// IO hint
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::deletePage(std::uint64_t id) {
+    auto& partition = getPartition(id);
+    while (true) {
+        std::unique_lock lock(partition.tableMutex);
+        auto pageIt = partition.pageTable.find(id);
+        if (pageIt == partition.pageTable.end()) {
+            break;
+        }
+        const std::size_t index = pageIt->second;
+        auto& page = pages[index];
+        if (!claimPage(page, 0)) {
+            // the page is about to be evicted -> wait for it
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        removePage(partition, id);
+        partition.pageTable.erase(pageIt);
+        ++partition.removals[id % partition.removals.size()];
+        partition.freeSlots.push_back(index);
+        page.id = -1;
+        page.dirty = false;
+        page.checkpointing = false;
+        releasePage(page);
+        break;
+    }
+    segmentManager.deleteBlock(id);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::relocatePage(Page<B>& page, std::uint64_t id) {
+    assert(page.pins >= 1);
+    const std::uint64_t oldID = page.id;
+    {
+        // flush walks the page tables without their latches
+        std::shared_lock cleaningLock(cleaningMutex);
+        auto& oldPartition = getPartition(oldID);
+        auto& newPartition = getPartition(id);
+        // the frame moves to the new partition, which gives one back (the
+        // partitions keep their sizes)
+        std::optional<std::size_t> freeIndex;
+        if (&oldPartition != &newPartition) {
+            freeIndex = takeFrame(newPartition);
+        }
+        // lock both partitions in a fixed order
+        std::unique_lock firstLock(std::min(&oldPartition, &newPartition)->tableMutex);
+        std::unique_lock<std::shared_mutex> secondLock;
+        if (&oldPartition != &newPartition) {
+            secondLock = std::unique_lock(std::max(&oldPartition, &newPartition)->tableMutex);
+        }
+        assert(!newPartition.pageTable.contains(id));
+        const std::size_t index = oldPartition.pageTable.at(oldID);
+        oldPartition.pageTable.erase(oldID);
+        ++oldPartition.removals[oldID % oldPartition.removals.size()];
+        newPartition.pageTable[id] = index;
+        // keep the position in the 2Q
+        if (oldPartition.fifoQueue.contains(oldID)) {
+            oldPartition.fifoQueue.remove(oldID);
+            newPartition.fifoQueue.insert(id, index);
+        } else if (oldPartition.lruQueue.contains(oldID)) {
+            oldPartition.lruQueue.remove(oldID);
+            newPartition.lruQueue.insert(id, index);
+        }
+        if (freeIndex) {
+            oldPartition.freeSlots.push_back(*freeIndex);
+            // CLOCK: the rings swap the frames as well
+            if (replacementPolicy == file::ReplacementPolicy::CLOCK) {
+                oldPartition.clock.remove(index);
+                newPartition.clock.insert(index);
+                newPartition.clock.remove(*freeIndex);
+                oldPartition.clock.insert(*freeIndex);
+            }
+        }
+        // the swizzled pins back off while the id changes (the caller holds
+        // the parent, no pin through its reference is in progress)
+        page.pins |= CLAIMED;
+        page.id = id;
+        releasePage(page);
+        // the new block has not been written yet
+        page.dirty = true;
+    }
+    segmentManager.deleteBlock(oldID);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::setRelocationHook(RelocationHook hook) {
+    std::unique_lock lock(compactionMutex);
+    relocationHook = std::move(hook);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+std::size_t PageBuffer<B, N>::compact(double maxFillRatio) {
+    std::unique_lock lock(compactionMutex);
+    if (!relocationHook) {
+        util::raise("The compaction requires a relocation hook!");
+    }
+    return relocatePages(maxFillRatio);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::compactInBackground() {
+    std::unique_lock lock(compactionMutex);
+    while (!compactionCondition.wait_for(lock, compactionInterval, [this]() { return stopCompaction; })) {
+        if (relocationHook) {
+            try {
+                relocatePages(compactionFillRatio);
+            } catch (...) {
+                // raised by the next flush or pin (like a failed cleaner write)
+                recordBackgroundError(std::current_exception());
+            }
+        }
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+std::size_t PageBuffer<B, N>::relocatePages(double maxFillRatio) {
+    // the selected segments are released by the next flush
+    if (segmentManager.isCompacting()) {
+        return 0;
+    }
+    const auto pageIDs = segmentManager.beginCompaction(maxFillRatio);
+    if (pageIDs.empty()) {
+        return 0;
+    }
+    try {
+        return relocationHook(pageIDs);
+    } catch (...) {
+        // the pages which were not moved stay where they are
+        segmentManager.cancelCompaction();
+        throw;
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
 std::size_t PageBuffer<B, N>::pageAmount() const {
     return segmentManager.allocatedBlocks();
 }
 // --------------------------------------------------------------------------
 template<std::size_t B, std::size_t N>
+file::io::IOStatisticsSnapshot PageBuffer<B, N>::getStatistics() const {
+    return segmentManager.getStatistics();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
 void PageBuffer<B, N>::flush() {
-    for (std::size_t index = 0; index < N; index++) {
-        if (!freeSlots.contains(index)) {
-            auto& page = pages[index];
-            if (page.dirty) {
-                savePage(index);
+    // the pages of a failed background write are still dirty (written below
+    // by the next flush)
+    raiseBackgroundError();
+    // no compaction relocates and no cleaner writes or evicts meanwhile
+    std::unique_lock compactionLock(compactionMutex);
+    std::unique_lock cleaningLock(cleaningMutex);
+    // write all dirty pages as one (coalesced) batch
+    std::vector<typename file::SegmentManager<B>::BlockWrite> writes;
+    std::vector<std::size_t> indexes;
+    for (auto& partition: partitions) {
+        for (const auto& [id, index]: partition.pageTable) {
+            const auto& page = pages[index];
+            if (page.dirty || page.checkpointing) {
+                writes.emplace_back(id, page.data);
+                indexes.push_back(index);
             }
         }
     }
+    segmentManager.writeBlocks(std::move(writes));// IO write
+    // the pages stay dirty if the write fails
+    for (std::size_t index: indexes) {
+        pages[index].dirty = false;
+        pages[index].checkpointing = false;
+    }
     segmentManager.flush();
 }
 // --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::sync() {
+    segmentManager.sync();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::setUserHeader(std::span<const unsigned char> data) {
+    segmentManager.setUserHeader(data);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+std::span<const unsigned char> PageBuffer<B, N>::getUserHeader() const {
+    return segmentManager.getUserHeader();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+typename PageBuffer<B, N>::Checkpoint PageBuffer<B, N>::beginCheckpoint() {
+    Checkpoint result;
+    if (!segmentManager.isLogStructured()) {
+        // the blocks are overwritten in place -> no snapshot, the dirty pages
+        // are written right away (the pages may be pinned meanwhile)
+        std::unique_lock cleaningLock(cleaningMutex);// no cleaner writes meanwhile
+        std::vector<std::size_t> indexes;
+        for (auto& partition: partitions) {
+            std::shared_lock tableLock(partition.tableMutex);
+            // an eviction which finds no unpinned page has to wait for us
+            ++partition.cleanerVersion;
+            for (const auto& [id, index]: partition.pageTable) {
+                auto& page = pages[index];
+                if (page.dirty || page.checkpointing) {
+                    // the pin keeps the page in its frame (no claim succeeds)
+                    ++page.pins;
+                    indexes.push_back(index);
+                }
+            }
+        }
+        // write copies as one (coalesced) batch, one page latch at a time
+        auto copies = std::make_unique<Frame[]>(indexes.size());
+        std::vector<typename file::SegmentManager<B>::BlockWrite> writes;
+        writes.reserve(indexes.size());
+        for (std::size_t i = 0; i < indexes.size(); i++) {
+            auto& page = pages[indexes[i]];
+            std::shared_lock pageLock(page);
+            std::unique_lock referenceLock(page.referenceMutex);
+            copies[i].data = page.data;
+            page.dirty = false;
+            page.checkpointing = false;
+            writes.emplace_back(page.id, copies[i].data);
+        }
+        segmentManager.writeBlocks(std::move(writes));// IO write
+        // the pages are unpinned after the write (no eviction reads the old
+        // block meanwhile)
+        for (std::size_t index: indexes) {
+            --pages[index].pins;
+        }
+        for (auto& partition: partitions) {
+            ++partition.cleanerVersion;
+        }
+        // not flush: the blocks are created and deleted concurrently
+        segmentManager.commitCheckpoint();
+        return result;
+    }
+    // no page is loaded or evicted meanwhile
+    std::vector<std::unique_lock<std::shared_mutex>> tableLocks;
+    std::vector<std::size_t> indexes;
+    for (auto& partition: partitions) {
+        tableLocks.emplace_back(partition.tableMutex);
+        for (const auto& [id, index]: partition.pageTable) {
+            const auto& page = pages[index];
+            // a pinned page may be evicted right now (written, not remapped yet)
+            if (page.dirty || page.checkpointing || page.pins > 0) {
+                result.ids.push_back(id);
+                indexes.push_back(index);
+            }
+        }
+    }
+    result.frames = std::make_unique<Frame[]>(result.ids.size());
+    for (std::size_t i = 0; i < result.ids.size(); i++) {
+        auto& page = pages[indexes[i]];
+        // waits for a load (the readers keep their pins)
+        std::shared_lock pageLock(page);
+        std::unique_lock referenceLock(page.referenceMutex);
+        result.frames[i].data = page.data;
+        page.checkpointing = true;
+        page.dirty = false;
+    }
+    segmentManager.beginCheckpoint();
+    return result;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B, std::size_t N>
+void PageBuffer<B, N>::writeCheckpoint(Checkpoint checkpoint) {
+    if (!segmentManager.isLogStructured()) {
+        segmentManager.sync();
+        return;
+    }
+    std::vector<typename file::SegmentManager<B>::BlockWrite> writes;
+    writes.reserve(checkpoint.ids.size());
+    for (std::size_t i = 0; i < checkpoint.ids.size(); i++) {
+        writes.emplace_back(checkpoint.ids[i], checkpoint.frames[i].data);
+    }
+    const auto current = segmentManager.writeCheckpoint(std::move(writes));// IO write
+    {
+        // the stored copy of these pages is current -> clean unless they
+        // were modified meanwhile
+        for (std::size_t i = 0; i < checkpoint.ids.size(); i++) {
+            auto& partition = getPartition(checkpoint.ids[i]);
+            std::shared_lock tableLock(partition.tableMutex);
+            auto pageIt = partition.pageTable.find(checkpoint.ids[i]);
+            if (current[i] && pageIt != partition.pageTable.end()) {
+                pages[pageIt->second].checkpointing = false;
+            }
+        }
+    }
+    segmentManager.endCheckpoint();
+}
+// --------------------------------------------------------------------------
 }// namespace buffer
 // --------------------------------------------------------------------------
 #endif//B_EPSILON_PAGEBUFFER_H
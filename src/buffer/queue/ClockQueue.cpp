@@ -0,0 +1,49 @@
+#include "ClockQueue.h"
+// --------------------------------------------------------------------------
+#include "src/util/ErrorHandler.h"
+#include <cassert>
+// --------------------------------------------------------------------------
+using namespace std;
+// --------------------------------------------------------------------------
+namespace buffer::queue {
+// --------------------------------------------------------------------------
+ClockQueue::ClockQueue(span<size_t> slots) : slots(slots) {
+}
+// --------------------------------------------------------------------------
+void ClockQueue::setSlots(span<size_t> newSlots) {
+    assert(ring.empty());
+    slots = newSlots;
+}
+// --------------------------------------------------------------------------
+size_t ClockQueue::size() const {
+    return ring.size();
+}
+// --------------------------------------------------------------------------
+const vector<size_t>& ClockQueue::getRing() const {
+    return ring;
+}
+// --------------------------------------------------------------------------
+void ClockQueue::insert(size_t frame) {
+    assert(frame < slots.size());
+    // inserted frames are just behind the hand (where the ring wraps)
+    slots[frame] = ring.size();
+    ring.push_back(frame);
+}
+// --------------------------------------------------------------------------
+void ClockQueue::remove(size_t frame) {
+    if (!contains(frame)) {
+        util::raise("Frame was not found! (CLOCK)");
+    }
+    const size_t position = slots[frame];
+    ring[position] = ring.back();
+    slots[ring[position]] = position;
+    ring.pop_back();
+}
+// --------------------------------------------------------------------------
+bool ClockQueue::contains(size_t frame) const {
+    // the slot may belong to the ring of another clock
+    return frame < slots.size() && slots[frame] < ring.size() && ring[slots[frame]] == frame;
+}
+// --------------------------------------------------------------------------
+}//namespace buffer::queue
+// --------------------------------------------------------------------------
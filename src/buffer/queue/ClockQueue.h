@@ -0,0 +1,81 @@
+#ifndef B_EPSILON_CLOCKQUEUE_H
+#define B_EPSILON_CLOCKQUEUE_H
+// --------------------------------------------------------------------------
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+// --------------------------------------------------------------------------
+namespace buffer::queue {
+// --------------------------------------------------------------------------
+class ClockQueue {
+    // CLOCK over the frames of a buffer: the frames form a ring (flat
+    // array), the hand sweeps over it and takes the first frame whose
+    // reference bit is not set, the set bits are cleared on the way (second
+    // chance) -> amortized O(1) per victim
+    // note: the frames stay in the ring while they are free, the predicate
+    // of findOne has to skip them
+    // note: the position of every frame in its ring is kept in a slot index
+    // (frame -> position) -> O(1) removal, the clocks of a buffer share
+    // one index (a frame is in one ring at a time)
+
+private:
+    std::vector<std::size_t> ring;
+    std::span<std::size_t> slots;
+    std::atomic_size_t hand = 0;
+
+public:
+    ClockQueue() = default;
+    explicit ClockQueue(std::span<std::size_t>);
+
+public:
+    // sets the slot index (one entry per frame), before the first insert
+    void setSlots(std::span<std::size_t>);
+    std::size_t size() const;
+    const std::vector<std::size_t>& getRing() const;
+    void insert(std::size_t);
+    // note: the last frame takes the position of the removed one
+    void remove(std::size_t);
+    bool contains(std::size_t) const;
+    // the next frame (from the hand on) which fulfills the predicate and
+    // whose reference bit was not set, referenced(frame) clears the bit and
+    // returns its old value, nullopt after two rounds (at most 2 * size
+    // steps, amortized O(1): a step clears a bit set by a pin or skips a
+    // frame the predicate rejects)
+    // note: thread-safe against other calls of findOne (the hand is atomic)
+    template<class Predicate, class Referenced>
+    std::optional<std::size_t> findOne(const Predicate&, const Referenced&);
+    // calls the function for the next frames the hand reaches (at most once
+    // per frame) until it returned true for the given amount of them
+    template<class Function>
+    void forNext(std::size_t, const Function&) const;
+};
+// --------------------------------------------------------------------------
+template<class Predicate, class Referenced>
+std::optional<std::size_t> ClockQueue::findOne(const Predicate& predicate, const Referenced& referenced) {
+    const std::size_t frames = ring.size();
+    // the first round may just clear the reference bits
+    for (std::size_t step = 0; step < 2 * frames; step++) {
+        const std::size_t frame = ring[hand.fetch_add(1, std::memory_order_relaxed) % frames];
+        if (predicate(frame) && !referenced(frame)) {
+            return frame;
+        }
+    }
+    return std::nullopt;
+}
+// --------------------------------------------------------------------------
+template<class Function>
+void ClockQueue::forNext(std::size_t amount, const Function& function) const {
+    const std::size_t frames = ring.size();
+    const std::size_t position = hand.load(std::memory_order_relaxed);
+    for (std::size_t step = 0, counted = 0; counted < amount && step < frames; step++) {
+        if (function(ring[(position + step) % frames])) {
+            counted++;
+        }
+    }
+}
+// --------------------------------------------------------------------------
+}//namespace buffer::queue
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_CLOCKQUEUE_H
@@ -0,0 +1,14 @@
+#include "Checksum.h"
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+std::uint32_t checksum(std::span<const unsigned char> data) {
+    std::uint32_t result = 2166136261U;
+    for (unsigned char byte: data) {
+        result = (result ^ byte) * 16777619U;
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
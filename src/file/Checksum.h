@@ -0,0 +1,14 @@
+#ifndef B_EPSILON_CHECKSUM_H
+#define B_EPSILON_CHECKSUM_H
+// --------------------------------------------------------------------------
+#include <cinttypes>
+#include <span>
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+// FNV-1a of the bytes
+std::uint32_t checksum(std::span<const unsigned char>);
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_CHECKSUM_H
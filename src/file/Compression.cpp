@@ -0,0 +1,170 @@
+#include "Compression.h"
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstring>
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+namespace {
+// --------------------------------------------------------------------------
+constexpr std::size_t MIN_MATCH = 4;
+constexpr std::size_t MAX_OFFSET = 65535;
+constexpr std::size_t HASH_BITS = 12;
+// --------------------------------------------------------------------------
+std::uint32_t load32(const unsigned char* data) {
+    std::uint32_t result;
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+}
+// --------------------------------------------------------------------------
+std::size_t hash(std::uint32_t value) {
+    return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+// --------------------------------------------------------------------------
+class Writer {
+    std::span<unsigned char> out;
+    std::size_t position = 0;
+    bool overflow = false;
+
+public:
+    explicit Writer(std::span<unsigned char> out) : out(out) {
+    }
+
+    void put(unsigned char value) {
+        if (position == out.size()) {
+            overflow = true;
+            return;
+        }
+        out[position++] = value;
+    }
+
+    void put(const unsigned char* data, std::size_t size) {
+        if (out.size() - position < size) {
+            overflow = true;
+            return;
+        }
+        std::memcpy(out.data() + position, data, size);
+        position += size;
+    }
+
+    // the remainder of a length of at least 15
+    void putLength(std::size_t length) {
+        for (length -= 15; length >= 255; length -= 255) {
+            put(255);
+        }
+        put(static_cast<unsigned char>(length));
+    }
+
+    // the literals [begin, end) followed by a match (matchLength 0: none)
+    void putSequence(const unsigned char* begin, const unsigned char* end, std::size_t offset,
+                     std::size_t matchLength) {
+        const auto literals = static_cast<std::size_t>(end - begin);
+        const std::size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+        put(static_cast<unsigned char>((std::min<std::size_t>(literals, 15) << 4) |
+                                       std::min<std::size_t>(matchCode, 15)));
+        if (literals >= 15) {
+            putLength(literals);
+        }
+        put(begin, literals);
+        if (matchLength > 0) {
+            put(static_cast<unsigned char>(offset));
+            put(static_cast<unsigned char>(offset >> 8));
+            if (matchCode >= 15) {
+                putLength(matchCode);
+            }
+        }
+    }
+
+    bool failed() const {
+        return overflow;
+    }
+
+    std::size_t size() const {
+        return overflow ? 0 : position;
+    }
+};
+// --------------------------------------------------------------------------
+}// namespace
+// --------------------------------------------------------------------------
+std::size_t compress(std::span<const unsigned char> in, std::span<unsigned char> out) {
+    // position + 1 of the last occurrence (0: none)
+    std::array<std::uint32_t, std::size_t(1) << HASH_BITS> table = {};
+    Writer writer(out);
+    const unsigned char* data = in.data();
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+    while (position + MIN_MATCH <= in.size() && !writer.failed()) {
+        const std::uint32_t value = load32(data + position);
+        auto& entry = table[hash(value)];
+        const std::size_t candidate = entry;
+        entry = static_cast<std::uint32_t>(position + 1);
+        if (candidate == 0 || position + 1 - candidate > MAX_OFFSET || load32(data + candidate - 1) != value) {
+            position++;
+            continue;
+        }
+        const std::size_t match = candidate - 1;
+        std::size_t length = MIN_MATCH;
+        while (position + length < in.size() && data[match + length] == data[position + length]) {
+            length++;
+        }
+        writer.putSequence(data + anchor, data + position, position - match, length);
+        position += length;
+        anchor = position;
+    }
+    if (anchor < in.size()) {
+        writer.putSequence(data + anchor, data + in.size(), 0, 0);
+    }
+    return writer.size();
+}
+// --------------------------------------------------------------------------
+bool decompress(std::span<const unsigned char> in, std::span<unsigned char> out) {
+    std::size_t input = 0;
+    std::size_t output = 0;
+    const auto readLength = [&](std::size_t length) {
+        if (length < 15) {
+            return length;
+        }
+        while (input < in.size()) {
+            const unsigned char next = in[input++];
+            length += next;
+            if (next != 255) {
+                break;
+            }
+        }
+        return length;
+    };
+    while (output < out.size()) {
+        if (input == in.size()) {
+            return false;
+        }
+        const unsigned char token = in[input++];
+        const std::size_t literals = readLength(token >> 4);
+        if (in.size() - input < literals || out.size() - output < literals) {
+            return false;
+        }
+        std::memcpy(out.data() + output, in.data() + input, literals);
+        input += literals;
+        output += literals;
+        if (output == out.size()) {
+            break;
+        }
+        if (in.size() - input < 2) {
+            return false;
+        }
+        const std::size_t offset = in[input] | (std::size_t(in[input + 1]) << 8);
+        input += 2;
+        const std::size_t length = readLength(token & 15) + MIN_MATCH;
+        if (offset == 0 || offset > output || out.size() - output < length) {
+            return false;
+        }
+        // byte by byte: the match may overlap its own output (runs)
+        for (std::size_t i = 0; i < length; i++, output++) {
+            out[output] = out[output - offset];
+        }
+    }
+    return true;
+}
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
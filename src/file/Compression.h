@@ -0,0 +1,24 @@
+#ifndef B_EPSILON_COMPRESSION_H
+#define B_EPSILON_COMPRESSION_H
+// --------------------------------------------------------------------------
+#include <cstddef>
+#include <span>
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+// small LZ77 codec for blocks (byte-aligned sequences, no entropy coding):
+// a sequence is a token (literal length << 4 | match length - 4), the
+// literals, a 2 byte offset and the match, lengths of 15 continue in the
+// following bytes (255 -> one more byte)
+// - fast enough to run on every block write
+// - runs of equal bytes (e.g. the unused space of a node) become matches
+// --------------------------------------------------------------------------
+// returns the compressed size, 0 if the data does not fit into <out>
+std::size_t compress(std::span<const unsigned char> in, std::span<unsigned char> out);
+// fills <out> completely (trailing input is ignored, e.g. padding),
+// returns false if the data is corrupted
+bool decompress(std::span<const unsigned char> in, std::span<unsigned char> out);
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_COMPRESSION_H
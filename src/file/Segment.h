@@ -1,7 +1,11 @@
 #ifndef B_EPSILON_SEGMENT_H
 #define B_EPSILON_SEGMENT_H
 // --------------------------------------------------------------------------
+#include "io/IOBackend.h"
 #include "src/util/ErrorHandler.h"
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <cinttypes>
 #include <cstddef>
@@ -9,6 +13,7 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -19,47 +24,85 @@ namespace file {
 // --------------------------------------------------------------------------
 template<std::size_t B>
 class Segment {
+    // layout: header block | free-space bitmap blocks | data blocks
+    // the bitmap is kept in memory (one bit per block, set if the block is
+    // free), so creating and deleting blocks never needs IO
+    // note: existing segments load their bitmap on the first allocation
 
-    // make sure that the block is capable of storing a list pointer
-    static_assert(B > sizeof(std::uint64_t));
+    // make sure that the bitmap fills whole blocks
+    static_assert(B % sizeof(std::uint64_t) == 0);
+    static constexpr std::size_t BITS_PER_WORD = 64;
+    static constexpr std::size_t BITS_PER_BLOCK = B * 8;
 
     struct alignas(alignof(std::max_align_t)) Header {
         std::uint64_t blockSize = 0;
         std::uint64_t allocatedBlocks = 0;
-        std::uint64_t occupiedBlocks = 0;
-        std::uint64_t deletedBlocks = 0;
-        std::optional<std::uint64_t> freeNodesHead;
+        std::uint64_t freeBlocks = 0;
     };
     // use B bytes for the header
     static_assert(sizeof(Header) <= B);
 
+public:
+    // everything but the bitmap (stored in the segment directory)
+    struct DirectoryEntry {
+        std::uint64_t offset;
+        std::uint64_t allocatedBlocks;
+        std::uint64_t freeBlocks;
+    };
+
 private:
-    int fd;
+    io::IOBackend* backend;
     std::size_t fileOffset;// marks the begin of the header
     Header header;
+    std::vector<std::uint64_t> freeMap;
+    bool freeMapLoaded = false;
+    bool dirty = false;         // header or bitmap changed since the last flush
+    std::size_t searchStart = 0;// no free blocks in the words before
 
 public:
-    Segment(int, std::size_t);               // construct an existing segment
-    Segment(int, std::size_t, std::uint64_t);// construct a new segment
+    Segment(io::IOBackend&, std::size_t);               // construct an existing segment
+    Segment(io::IOBackend&, const DirectoryEntry&);     // construct an existing segment (no IO)
+    Segment(io::IOBackend&, std::size_t, std::uint64_t);// construct a new segment
     Segment(const Segment<B>&) = delete;
     Segment(Segment<B>&&) noexcept = default;
 
 private:
-    std::uint64_t getIDInBlock(std::uint64_t);
-    void storeIDInBlock(std::uint64_t, std::uint64_t);
+    static std::size_t bitmapBlocks(std::uint64_t);
+    void loadFreeMap();
 
 public:
+    // the file size a segment with the given amount of blocks needs
+    static std::size_t requiredSize(std::uint64_t);
     constexpr std::size_t getBlockSize() const;
     std::size_t getOffset() const;
+    // file offset of the given block
+    std::size_t getBlockOffset(std::uint64_t) const;
     std::size_t getTotalSize() const;
 
     std::uint64_t freeBlocks() const;
     std::uint64_t allocatedBlocks() const;
+    DirectoryEntry getDirectoryEntry() const;
+    bool isFree(std::uint64_t);
 
     std::uint64_t createBlock();
+    // creates the free block closest to the given block (preferably behind it)
+    std::uint64_t createBlockNear(std::uint64_t);
+    // creates up to <amount> blocks, appends them and returns their amount
+    std::size_t createBlocks(std::size_t, std::vector<std::uint64_t>&);
     void deleteBlock(std::uint64_t);
+    // appends the ids of all occupied blocks
+    void collectLiveBlocks(std::vector<std::uint64_t>&);
+    // replaces the bitmap: only the given (distinct) blocks are occupied
+    // note: no IO, the stored bitmap stays as it is until the next change
+    void resetFreeMap(std::span<const std::uint64_t>);
+    // returns the space of all free blocks to the file system and returns
+    // the amount of released bytes
+    std::size_t punchFreeBlocks();
     std::array<unsigned char, B> readBlock(std::uint64_t);
     void writeBlock(std::uint64_t, std::array<unsigned char, B>);
+    // zero-copy variants (I/O goes directly into/out of the given memory)
+    void readBlockInto(std::uint64_t, std::span<unsigned char, B>);
+    void writeBlockFrom(std::uint64_t, std::span<const unsigned char, B>);
 
     void flush();
 
@@ -69,42 +112,49 @@ public:
 };
 // --------------------------------------------------------------------------
 template<std::size_t B>
-Segment<B>::Segment(int fd, std::size_t fileOffset)
-    : fd(fd), fileOffset(fileOffset) {
-    assert(fd >= 0);
+Segment<B>::Segment(io::IOBackend& backend, std::size_t fileOffset)
+    : backend(&backend), fileOffset(fileOffset) {
     // load the header
-    if (pread(fd, &header, sizeof(Header), fileOffset) != sizeof(Header)) {
-        util::raise("Invalid segment!");
-    }
+    this->backend->read(&header, sizeof(Header), fileOffset);
     if (header.blockSize != B) {
         util::raise("Different block sizes (segment)!");
     }
 }
 // --------------------------------------------------------------------------
 template<std::size_t B>
-Segment<B>::Segment(int fd, std::size_t fileOffset, std::uint64_t segmentSize)
-    : fd(fd), fileOffset(fileOffset) {
-    assert(fd >= 0);
+Segment<B>::Segment(io::IOBackend& backend, const DirectoryEntry& entry)
+    : backend(&backend), fileOffset(entry.offset) {
+    header = {B, entry.allocatedBlocks, entry.freeBlocks};
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+Segment<B>::Segment(io::IOBackend& backend, std::size_t fileOffset, std::uint64_t segmentSize)
+    : backend(&backend), fileOffset(fileOffset) {
     // create a new header
-    header = {B, segmentSize, 0, 0, std::nullopt};
+    header = {B, segmentSize, segmentSize};
+    resetFreeMap({});
+    dirty = true;
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
-std::uint64_t Segment<B>::getIDInBlock(std::uint64_t id) {
-    std::uint64_t result;
-    if (pread(fd, &result, sizeof(std::uint64_t),
-              fileOffset + B + id * B) != sizeof(std::uint64_t)) {
-        util::raise("Could not read id in block.");
-    }
-    return result;
+std::size_t Segment<B>::bitmapBlocks(std::uint64_t blocks) {
+    return (blocks + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
-void Segment<B>::storeIDInBlock(std::uint64_t id, std::uint64_t idToStore) {
-    if (pwrite(fd, &idToStore, sizeof(uint64_t),
-               fileOffset + B + id * B) != sizeof(std::uint64_t)) {
-        util::raise("Could not write id to block.");
+void Segment<B>::loadFreeMap() {
+    if (freeMapLoaded) {
+        return;
     }
+    freeMap.resize(bitmapBlocks(header.allocatedBlocks) * B / sizeof(std::uint64_t));
+    backend->read(freeMap.data(), freeMap.size() * sizeof(std::uint64_t), fileOffset + B);// IO read
+    freeMapLoaded = true;
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+std::size_t Segment<B>::requiredSize(std::uint64_t blocks) {
+    // header + bitmap + blocks
+    return B + bitmapBlocks(blocks) * B + blocks * B;
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
@@ -118,14 +168,19 @@ std::size_t Segment<B>::getOffset() const {
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
+std::size_t Segment<B>::getBlockOffset(std::uint64_t id) const {
+    // the header and the bitmap precede the blocks
+    return fileOffset + B + bitmapBlocks(header.allocatedBlocks) * B + id * B;
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
 std::size_t Segment<B>::getTotalSize() const {
-    // header + blocks
-    return B + header.allocatedBlocks * B;
+    return requiredSize(header.allocatedBlocks);
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
 std::uint64_t Segment<B>::freeBlocks() const {
-    return header.allocatedBlocks - header.occupiedBlocks + header.deletedBlocks;
+    return header.freeBlocks;
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
@@ -134,65 +189,182 @@ std::uint64_t Segment<B>::allocatedBlocks() const {
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
+typename Segment<B>::DirectoryEntry Segment<B>::getDirectoryEntry() const {
+    return {fileOffset, header.allocatedBlocks, header.freeBlocks};
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+bool Segment<B>::isFree(std::uint64_t id) {
+    assert(id < header.allocatedBlocks);
+    loadFreeMap();
+    return (freeMap[id / BITS_PER_WORD] >> (id % BITS_PER_WORD)) & 1;
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
 std::uint64_t Segment<B>::createBlock() {
-    if (header.deletedBlocks > 0) {
-        // default case if operations are delete-heavy
-        assert(header.freeNodesHead);
-        std::uint64_t result = *header.freeNodesHead;
-        if (header.deletedBlocks > 1) {
-            std::uint64_t nextID = getIDInBlock(result);// IO read
-            header.freeNodesHead = nextID;
-        } else {
-            header.freeNodesHead = std::nullopt;
+    if (header.freeBlocks == 0) {
+        util::raise("All blocks were occupied!");
+    }
+    loadFreeMap();// IO read (only once)
+    // find the first word with a free block
+    while (freeMap[searchStart] == 0) {
+        searchStart++;
+        assert(searchStart < freeMap.size());
+    }
+    std::uint64_t& word = freeMap[searchStart];
+    const std::uint64_t result = searchStart * BITS_PER_WORD + std::countr_zero(word);
+    assert(result < header.allocatedBlocks);
+    // clear the lowest set bit
+    word &= word - 1;
+    header.freeBlocks--;
+    dirty = true;
+    return result;
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+std::uint64_t Segment<B>::createBlockNear(std::uint64_t hint) {
+    if (header.freeBlocks == 0) {
+        util::raise("All blocks were occupied!");
+    }
+    loadFreeMap();// IO read (only once)
+    assert(hint < header.allocatedBlocks);
+    const std::size_t hintWord = hint / BITS_PER_WORD;
+    const std::size_t hintBit = hint % BITS_PER_WORD;
+    // search the words around the hint (alternating: behind, in front)
+    for (std::size_t distance = 0; distance < freeMap.size(); distance++) {
+        std::optional<std::uint64_t> result;
+        if (hintWord + distance < freeMap.size()) {
+            std::uint64_t word = freeMap[hintWord + distance];
+            if (distance == 0) {
+                // only the blocks behind the hint
+                word &= ~std::uint64_t(0) << hintBit;
+            }
+            if (word != 0) {
+                result = (hintWord + distance) * BITS_PER_WORD + std::countr_zero(word);
+            }
+        }
+        if (!result && distance <= hintWord) {
+            std::uint64_t word = freeMap[hintWord - distance];
+            if (distance == 0) {
+                // only the blocks in front of the hint
+                word &= (std::uint64_t(1) << hintBit) - 1;
+            }
+            if (word != 0) {
+                result = (hintWord - distance) * BITS_PER_WORD + (BITS_PER_WORD - 1 - std::countl_zero(word));
+            }
+        }
+        if (result) {
+            assert(*result < header.allocatedBlocks && isFree(*result));
+            freeMap[*result / BITS_PER_WORD] &= ~(std::uint64_t(1) << (*result % BITS_PER_WORD));
+            header.freeBlocks--;
+            dirty = true;
+            return *result;
         }
-        header.deletedBlocks--;
-        return result;
     }
-    assert(!header.freeNodesHead);
-    if (header.allocatedBlocks > header.occupiedBlocks) {
-        // default case if operations are create-heavy
-        std::uint64_t result = header.occupiedBlocks;
-        header.occupiedBlocks++;
-        return result;
+    util::raise("Invalid free-space bitmap!");
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+std::size_t Segment<B>::createBlocks(std::size_t amount, std::vector<std::uint64_t>& ids) {
+    const std::size_t result = std::min<std::size_t>(amount, header.freeBlocks);
+    for (std::size_t i = 0; i < result; i++) {
+        ids.push_back(createBlock());
     }
-    util::raise("All blocks were occupied!");
+    return result;
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
 void Segment<B>::deleteBlock(std::uint64_t id) {
-    if (header.deletedBlocks > 0) {
-        assert(header.freeNodesHead);
-        std::uint64_t nextID = *header.freeNodesHead;
-        storeIDInBlock(id, nextID);// IO write
-        header.freeNodesHead = id;
-    } else {
-        assert(!header.freeNodesHead);
-        header.freeNodesHead = id;
+    loadFreeMap();// IO read (only once)
+    assert(!isFree(id));
+    freeMap[id / BITS_PER_WORD] |= std::uint64_t(1) << (id % BITS_PER_WORD);
+    searchStart = std::min<std::size_t>(searchStart, id / BITS_PER_WORD);
+    header.freeBlocks++;
+    dirty = true;
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+void Segment<B>::collectLiveBlocks(std::vector<std::uint64_t>& ids) {
+    loadFreeMap();// IO read (only once)
+    for (std::uint64_t id = 0; id < header.allocatedBlocks; id++) {
+        if (!isFree(id)) {
+            ids.push_back(id);
+        }
     }
-    header.deletedBlocks++;
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+void Segment<B>::resetFreeMap(std::span<const std::uint64_t> liveBlocks) {
+    const std::uint64_t blocks = header.allocatedBlocks;
+    // all blocks are free, the padding bits behind the last block are not
+    freeMap.assign(bitmapBlocks(blocks) * B / sizeof(std::uint64_t), 0);
+    std::fill_n(freeMap.begin(), blocks / BITS_PER_WORD, ~std::uint64_t(0));
+    if (blocks % BITS_PER_WORD != 0) {
+        freeMap[blocks / BITS_PER_WORD] = (std::uint64_t(1) << (blocks % BITS_PER_WORD)) - 1;
+    }
+    for (std::uint64_t id: liveBlocks) {
+        assert(id < blocks);
+        freeMap[id / BITS_PER_WORD] &= ~(std::uint64_t(1) << (id % BITS_PER_WORD));
+    }
+    header.freeBlocks = blocks - liveBlocks.size();
+    freeMapLoaded = true;
+    searchStart = 0;
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+std::size_t Segment<B>::punchFreeBlocks() {
+    loadFreeMap();// IO read (only once)
+    std::size_t result = 0;
+    std::uint64_t id = 0;
+    while (id < header.allocatedBlocks) {
+        if (!isFree(id)) {
+            id++;
+            continue;
+        }
+        // punch the whole run of free blocks at once
+        std::uint64_t end = id + 1;
+        while (end < header.allocatedBlocks && isFree(end)) {
+            end++;
+        }
+        if (backend->punchHole((end - id) * B, getBlockOffset(id))) {
+            result += (end - id) * B;
+        }
+        id = end;
+    }
+    return result;
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
 std::array<unsigned char, B> Segment<B>::readBlock(std::uint64_t id) {
     std::array<unsigned char, B> result;
-    if (pread(fd, result.data(), B, fileOffset + B + id * B) != B) {
-        util::raise("Could not read the block.");
-    }
+    readBlockInto(id, result);
     return result;
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
 void Segment<B>::writeBlock(std::uint64_t id, std::array<unsigned char, B> data) {
-    if (pwrite(fd, data.data(), B, fileOffset + B + id * B) != B) {
-        util::raise("Could not write the block.");
-    }
+    writeBlockFrom(id, data);
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+void Segment<B>::readBlockInto(std::uint64_t id, std::span<unsigned char, B> data) {
+    backend->read(data.data(), B, getBlockOffset(id));
+}
+// --------------------------------------------------------------------------
+template<std::uint64_t B>
+void Segment<B>::writeBlockFrom(std::uint64_t id, std::span<const unsigned char, B> data) {
+    backend->write(data.data(), B, getBlockOffset(id));
 }
 // --------------------------------------------------------------------------
 template<std::uint64_t B>
 void Segment<B>::flush() {
-    if (pwrite(fd, &header, sizeof(Header), fileOffset) != sizeof(Header)) {
-        util::raise("Could not save the header.");
+    if (!dirty) {
+        return;
     }
+    assert(freeMapLoaded);
+    backend->write(&header, sizeof(Header), fileOffset);
+    backend->write(freeMap.data(), freeMap.size() * sizeof(std::uint64_t), fileOffset + B);
+    dirty = false;
 }
 // --------------------------------------------------------------------------
 }// namespace file
@@ -1,17 +1,39 @@
 #ifndef B_EPSILON_SEGMENTMANAGER_H
 #define B_EPSILON_SEGMENTMANAGER_H
 // --------------------------------------------------------------------------
+#include "Checksum.h"
+#include "Compression.h"
 #include "Segment.h"
+#include "SegmentTable.h"
+#include "StorageOptions.h"
+#include "io/IOBackend.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cinttypes>
+#include <condition_variable>
 #include <cstddef>
+#include <cstring>
+#include <deque>
 #include <fcntl.h>
 #include <filesystem>
 #include <functional>
+#include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <set>
 #include <shared_mutex>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -26,78 +48,628 @@ class SegmentManager {
     struct alignas(alignof(std::max_align_t)) Header {
         std::uint64_t numberOfSegments;
         std::size_t lastAllocatedBlocks;
+        std::uint64_t stripes;// segment i lives in file i % stripes
+        // the directory of this generation matches the segment headers
+        // (0 while they are written)
+        std::uint64_t generation;
+    };
+
+    // the metadata file: header | one directory entry per segment | block
+    // mapping (log-structured mode) | user header
+    struct MetadataHeader {
+        std::uint64_t blockSize;
+        std::uint64_t generation;
+        std::uint64_t numberOfSegments;
+        std::uint64_t mappingSize;// entries
+        std::uint64_t userHeaderSize;
+        std::uint64_t checksum;// of everything behind the header
     };
 
     struct SegmentContainer {
         // wrap it into an optional to delay the io read
         std::optional<Segment<B>> segment;
         std::shared_mutex mutex;
+        std::atomic_bool initialized = false;// segment is set (published)
+        bool draining = false;               // compacted (segment lock)
+    };
+
+    // block ids reserved by one thread, handed out without the global lock
+    // note: shared by the thread and the manager, lock order: cache -> manager
+    struct AllocationCache {
+        std::mutex mutex;
+        SegmentManager<B>* owner;      // null once the manager is destroyed
+        std::vector<std::uint64_t> ids;// handed out from the back
+    };
+
+    // the caches of the current thread (one per manager)
+    struct ThreadCaches {
+        std::unordered_map<std::uint64_t, std::shared_ptr<AllocationCache>> caches;
+        ~ThreadCaches();// returns the unused ids
+    };
+
+    // log-structured mode: the block ids are logical, every write appends
+    // the blocks to the head segment and remaps their ids
+    // - a block is stored in 1 to SLOTS slots of a physical block
+    //   (compressed blocks share the physical blocks)
+    // - a physical block is free once no location references it
+    // lock order: head -> mapping -> main -> segment, references last
+    struct LogStructure {
+        static constexpr std::uint64_t FREE = -1;     // the logical id is unused
+        static constexpr std::uint64_t UNWRITTEN = -2;// created, but never written
+        static constexpr std::size_t SLOTS = 16;
+        // location: segment (16 bit) | block (40 bit) | first slot (4 bit) | slots - 1 (4 bit)
+        static std::uint64_t makeLocation(std::uint64_t, std::size_t, std::size_t);
+        static std::uint64_t getPhysicalID(std::uint64_t);
+        static std::size_t getSlot(std::uint64_t);
+        static std::size_t getSlots(std::uint64_t);
+
+        const bool compression;
+        std::vector<std::uint64_t> mapping;// logical id -> location
+        // location -> logical id (ordered -> the blocks of a segment are a range)
+        std::map<std::uint64_t, std::uint64_t> owners;
+        std::vector<std::uint64_t> freeIDs;
+        std::shared_mutex mappingMutex;
+        // the reserved blocks of the head segment (appended in order), the
+        // first <headSlot> slots of the front block are used
+        std::deque<std::uint64_t> head;
+        std::size_t headSlot = 0;
+        std::mutex headMutex;
+        // physical id -> referencing locations (+1 while it is the head block)
+        std::unordered_map<std::uint64_t, std::size_t> references;
+        // the unreferenced blocks are freed after the next mapping write
+        // (the persisted mapping may still reference them)
+        std::vector<std::uint64_t> released;
+        // the blocks started since the mapping to persist was taken, freed
+        // right away (no persisted mapping references them)
+        std::unordered_set<std::uint64_t> unpersisted;
+        std::mutex referenceMutex;
+        // running checkpoint (see beginCheckpoint): the mapping and the user
+        // header to persist (mapping lock), the blocks released before it
+        // began (references lock) and the locations only the checkpoint
+        // references
+        std::vector<std::uint64_t> checkpointMapping;
+        std::vector<unsigned char> checkpointUserHeader;
+        std::vector<std::uint64_t> checkpointReleased;
+        std::vector<std::uint64_t> checkpointLocations;
+        bool checkpointing = false;
+        // segments whose blocks are moved (not used as head), main lock
+        std::set<std::size_t> cleaning;
+        std::mutex cleanerMutex;// one cleaning pass at a time
+        // background cleaner
+        const double cleanerThreshold;
+        const std::chrono::milliseconds cleanerInterval;
+        std::mutex cleanerThreadMutex;
+        std::condition_variable cleanerCondition;
+        bool stopCleaner = false;
+        std::thread cleanerThread;
+
+        LogStructure(double, std::chrono::milliseconds, bool);
+    };
+    static constexpr std::size_t SLOT_SIZE = B / LogStructure::SLOTS;
+    static_assert(B % LogStructure::SLOTS == 0);
+
+    // a contiguous range of a stripe file
+    struct Extent {
+        std::size_t stripe;
+        std::size_t offset;
+        std::span<const unsigned char> data;
     };
 
 private:
+    io::IOStatistics statistics;// outlives the backends
     std::string dirPath;
-    int fd;
+    std::vector<std::unique_ptr<io::IOBackend>> backends;// one per stripe file
+    std::vector<std::size_t> stripeEnds;                // end of the last segment per file
+    // the metadata (segment directory, block mapping and user header in one
+    // file, replaced on flush) -> a flush is committed at once, opening reads
+    // one file instead of every segment header
+    std::string metadataFile;
+    io::IOBackendOptions metadataOptions;// no io_uring, but on the same device
+    std::uint64_t generation = 0;        // of the last metadata
+    std::vector<unsigned char> userHeader;// persisted with the metadata
     Header header;
-    std::vector<std::unique_ptr<SegmentContainer>> segments;
-    std::unordered_set<std::size_t> freeSegments;
+    // lookups (block I/O) do not lock, changes hold the main lock
+    SegmentTable<SegmentContainer> segments;
+    std::set<std::size_t> freeSegments;// ordered -> fill the first segments first
+    // segments [drainBegin, drainEnd) are compacted (no new blocks)
+    std::size_t drainBegin = 0;
+    std::size_t drainEnd = 0;
     const double growthFactor;
     mutable std::shared_mutex mutex;// mutex for block creation and deletion (freelist)
+    // thread-local allocation
+    const std::uint64_t uid;// identifies the manager in the thread caches
+    const std::size_t allocationBatch;
+    std::vector<std::shared_ptr<AllocationCache>> caches;
+    std::mutex cacheMutex;
+    // extent preallocation
+    const bool preallocate;
+    const std::size_t preallocationChunk;
+    std::vector<std::size_t> preallocatedEnds;// per file
+    std::mutex preallocationMutex;
+    // background preallocation of the next segment
+    std::deque<std::pair<std::size_t, std::size_t>> preallocationQueue;// (file, end)
+    std::condition_variable preallocationCondition;
+    bool stopPreallocation = false;
+    std::thread preallocationThread;
+    std::unique_ptr<LogStructure> log;// null if the blocks are written in place
 
 public:
     SegmentManager() = delete;
-    SegmentManager(const std::string&, double);
+    SegmentManager(const std::string&, double, const StorageOptions& = {});
     SegmentManager(const SegmentManager<B>&) = delete;
     SegmentManager(SegmentManager<B>&&) noexcept = default;
+    ~SegmentManager();
 
 private:
+    static std::uint64_t nextUID();
+    // opens the file (in-memory storage: no file), null if that fails
+    static std::unique_ptr<io::IOBackend> openBackend(const std::string&, int, const io::IOBackendOptions&);
+    // replaces the file by one with the given content (temporary file +
+    // rename), durable once it returns
+    void replaceFile(const std::string&, std::span<const unsigned char>);
+    // reads the metadata (false if it is missing or invalid), the directory
+    // only if it matches the segment headers (see Header)
+    bool readMetadata(std::vector<typename Segment<B>::DirectoryEntry>&, std::vector<std::uint64_t>&);
+    std::size_t getStripe(std::size_t) const;
+    // makes sure that the file has (allocated) space up to the given end
+    void allocateSpace(std::size_t, std::size_t);
+    void preallocateInBackground();
     std::size_t getIndexFromID(std::uint64_t) const;
     std::size_t getBlockFromID(std::uint64_t) const;
+    // returns the (initialized) segment for block I/O
+    Segment<B>& accessSegment(std::size_t);
+    // reserves up to <amount> (at least one) blocks in one segment
+    // note: emptySegment reserves all blocks of a segment without live
+    // blocks (a new one if there is none), <amount> is ignored
+    void reserveBlocks(std::size_t, std::vector<std::uint64_t>&, bool = false);
+    AllocationCache& getAllocationCache();
+    // returns the unused ids of all caches
+    void drainAllocationCaches();
+    // marks the block as free (deleteBlock without the statistics)
+    void releaseBlock(std::uint64_t);
+    bool isDraining(std::size_t) const;
+    // removes the empty compacted segments at the end (before they are
+    // persisted) and returns the files to truncate: (file, new size)
+    std::vector<std::pair<std::size_t, std::size_t>> removeCompactedSegments();
+    // releases the space of the compacted segments (after they are persisted)
+    void releaseCompactedSegments(const std::vector<std::pair<std::size_t, std::size_t>>&);
+    // log-structured mode
+    void openMapping(std::vector<std::uint64_t>);
+    // takes the next slots of the head, one location per amount of slots
+    // note: the blocks are persisted with the running checkpoint unless
+    // <unpersisted> (see LogStructure::unpersisted)
+    void appendSlots(const std::vector<std::size_t>&, std::vector<std::uint64_t>&, bool = true);
+    // points the logical ids to the new locations and returns the replaced
+    // locations (released by the caller)
+    // note: a move (cleaner) is skipped if the block was written meanwhile
+    std::vector<std::uint64_t> remapBlocks(const std::vector<std::uint64_t>&, const std::vector<std::uint64_t>&,
+                                           const std::vector<std::uint64_t>* = nullptr);
+    // drops the references of the locations, the unreferenced blocks are
+    // freed on flush
+    void releaseLocations(const std::vector<std::uint64_t>&);
+    void dropReferences(const std::vector<std::uint64_t>&);
+    // reads the stored (maybe compressed) slots of the location
+    void readSlots(std::uint64_t, std::span<unsigned char, B>);
+    void writeLocations(const std::vector<std::uint64_t>&, const std::vector<std::span<const unsigned char>>&);
+    // moves the live blocks of the segment to the head
+    std::size_t cleanSegment(std::size_t);
+    void cleanInBackground();
+    // compresses the blocks and appends them to the head, returns their
+    // locations (not mapped yet)
+    std::vector<std::uint64_t> appendBlocks(const std::vector<std::pair<std::uint64_t, std::span<const unsigned char, B>>>&,
+                                            bool = true);
+    // writes the segment headers and replaces the metadata file (durable
+    // once it returns), checkpoint: with the snapshot of beginCheckpoint
+    // note: the segments are locked, the blocks may change concurrently
+    void writeMetadata(bool);
+    // writes the blocks to their (physical) location
+    void writeBlocksInPlace(std::vector<std::pair<std::uint64_t, std::span<const unsigned char, B>>>);
+    // adjacent extents are coalesced into vectored requests
+    void writeExtents(std::vector<Extent>);
 
 public:
     std::uint64_t createBlock();
+    // creates a block close to the given one (same segment or the closest
+    // segment of the same file) to keep related blocks together on disk
+    std::uint64_t createBlock(std::uint64_t);
     void deleteBlock(std::uint64_t);
     std::array<unsigned char, B> readBlock(std::uint64_t);
     void writeBlock(std::uint64_t, std::array<unsigned char, B>);
+    // zero-copy variants (I/O goes directly into/out of the given memory)
+    void readBlockInto(std::uint64_t, std::span<unsigned char, B>);
+    void writeBlockFrom(std::uint64_t, std::span<const unsigned char, B>);
+    // writes the first block and reads the second one (e.g. an evicted and
+    // a loaded page), as one batch if both are in the same file
+    // note: log-structured mode: the write is appended before the read
+    void writeAndReadBlock(std::uint64_t, std::span<const unsigned char, B>, std::uint64_t,
+                           std::span<unsigned char, B>);
+    // writes all blocks and returns once every write has completed
+    // note: the writes are sorted and adjacent blocks of a segment are
+    // coalesced into vectored requests, which are submitted as one batch
+    using BlockWrite = std::pair<std::uint64_t, std::span<const unsigned char, B>>;
+    void writeBlocks(std::vector<BlockWrite>);
+    // announces that the blocks will be read soon, the kernel reads them
+    // ahead in the background (adjacent blocks are coalesced)
+    // note: no-op with O_DIRECT
+    void prefetch(std::span<const std::uint64_t>);
+    // log-structured mode: moves the live blocks of the segments with at
+    // most <ratio> live blocks to the head, so the segments can be reused
+    // (after the next flush), and returns the amount of moved blocks
+    std::size_t clean(double);
+    // log-structured mode: fuzzy checkpoint, persists the mapping of the
+    // moment it began while the blocks are written concurrently
+    // - begin: snapshots the mapping and the user header (the caller makes
+    //   sure that no block changes meanwhile)
+    // - write: writes blocks as of the snapshot and returns which of them
+    //   are still current (not written meanwhile)
+    // - end: commits the snapshot like flush (after the blocks are durable)
+    // note: one checkpoint at a time, not together with flush
+    void beginCheckpoint();
+    std::vector<bool> writeCheckpoint(std::vector<BlockWrite>);
+    void endCheckpoint();
+    // in-place mode: persists the blocks written so far and the metadata
+    // while blocks are created and deleted concurrently (the header and the
+    // amount of segments are taken under the main lock, the segments are
+    // only appended meanwhile)
+    // note: the compacted segments are released and the allocation caches
+    // drained by the next flush (their reserved blocks are allocated in the
+    // persisted bitmaps until then), not together with flush
+    void commitCheckpoint();
+    bool isLogStructured() const;
+
+    // compaction: selects the sparse segments at the end of the files
+    // (as long as their live blocks fit into the free blocks in front) and
+    // returns the ids of their live blocks
+    // - no new blocks are created in these segments until the next flush
+    // - the caller relocates the live blocks (createBlock + deleteBlock)
+    // - the next flush truncates the files / punches holes into them
+    // note: log-structured mode: cleans the segments instead (the ids do
+    // not change) and returns no ids
+    std::vector<std::uint64_t> beginCompaction(double);
+    // true if the segments of the last compaction are not released yet
+    bool isCompacting() const;
+    // the caller could not relocate the blocks (e.g. an error): the
+    // segments take new blocks again, nothing is released by the next flush
+    // note: not together with flush
+    void cancelCompaction();
 
     std::size_t allocatedBlocks() const;
-    void flush();// not thread-safe
+    // state of the user (e.g. the root of a tree), persisted atomically with
+    // the blocks by the next flush (or checkpoint)
+    // note: not thread-safe
+    void setUserHeader(std::span<const unsigned char>);
+    std::span<const unsigned char> getUserHeader() const;
+    // all I/O of the manager (blocks, segment metadata)
+    io::IOStatisticsSnapshot getStatistics() const;
+    // persists the blocks and the metadata (durable once it returns)
+    // note: not thread-safe
+    void flush();
+    // makes the written blocks durable (fdatasync of all files)
+    void sync();
 
     SegmentManager<B>& operator=(const SegmentManager<B>&) = delete;
     SegmentManager<B>& operator=(SegmentManager<B>&&) noexcept = default;
 };
 // --------------------------------------------------------------------------
 template<std::size_t B>
-SegmentManager<B>::SegmentManager(const std::string& dirPath, double growthFactor)
-    : dirPath(dirPath), growthFactor(growthFactor) {
-    const std::string headerFile = dirPath + "/segments";
-    if (std::filesystem::exists(dirPath) && std::filesystem::is_directory(dirPath) &&
-        std::filesystem::exists(headerFile) && std::filesystem::is_regular_file(headerFile)) {
-        fd = open(headerFile.c_str(), O_RDWR);
-        if (pread(fd, &header, sizeof(Header), 0) != sizeof(Header)) {
-            throw std::runtime_error("Invalid segment file!");
+SegmentManager<B>::SegmentManager(const std::string& dirPath, double growthFactor,
+                                  const StorageOptions& options)
+    : dirPath(dirPath), growthFactor(growthFactor), uid(nextUID()),
+      allocationBatch(options.allocationBatch), preallocate(options.preallocate),
+      preallocationChunk(options.preallocationChunk) {
+    if (options.directIO && B % io::IOBackend::DIRECT_IO_ALIGNMENT != 0) {
+        util::raise("O_DIRECT requires the block size to be a multiple of 4 KiB!");
+    }
+    if (options.compression && (!options.logStructured || options.directIO)) {
+        util::raise("Compression requires the log-structured mode without O_DIRECT!");
+    }
+    const int directFlag = options.directIO ? O_DIRECT : 0;
+    // the first file also stores the header, the others only the stripe
+    std::vector<std::string> stripeFiles = {dirPath + "/segments"};
+    for (const auto& stripeDirectory: options.stripeDirectories) {
+        stripeFiles.push_back(stripeDirectory + "/segments." + std::to_string(stripeFiles.size()));
+    }
+    const std::string& headerFile = stripeFiles.front();
+    metadataFile = dirPath + "/metadata";
+    metadataOptions.type = options.io.type == io::IOBackendType::MEMORY ? io::IOBackendType::MEMORY
+                                                                        : io::IOBackendType::POSIX;
+    metadataOptions.throttle = options.io.throttle;
+    std::vector<std::uint64_t> mapping;// log-structured mode
+    const bool reopen = options.io.type != io::IOBackendType::MEMORY &&
+                        std::filesystem::exists(dirPath) && std::filesystem::is_directory(dirPath) &&
+                        std::filesystem::exists(headerFile) && std::filesystem::is_regular_file(headerFile);
+    if (reopen) {
+        for (const auto& stripeFile: stripeFiles) {
+            backends.push_back(openBackend(stripeFile, O_RDWR | directFlag, options.io));
+            if (!backends.back()) {
+                throw std::runtime_error("Invalid segment file!");
+            }
+            backends.back()->setStatistics(&statistics);
         }
-        std::size_t currentSegmentOffset = B;
+        backends.front()->read(&header, sizeof(Header), 0);
+        if (header.stripes != backends.size()) {
+            util::raise("Different amount of stripe files (segment)!");
+        }
+        stripeEnds.assign(backends.size(), B);
+        // otherwise, the segment headers are read (crash during a flush)
+        std::vector<typename Segment<B>::DirectoryEntry> directory;
+        if (!readMetadata(directory, mapping) && options.logStructured && std::filesystem::exists(metadataFile)) {
+            util::raise("Invalid block mapping!");
+        }
+        const bool useDirectory = !directory.empty();
         for (std::size_t i = 0; i < header.numberOfSegments; i++) {
             auto segmentContainerPtr = std::make_unique<SegmentContainer>();
-            segmentContainerPtr->segment = std::make_optional<Segment<B>>(fd, currentSegmentOffset);
+            auto& stripeEnd = stripeEnds[getStripe(i)];
+            if (useDirectory) {
+                assert(directory[i].offset == stripeEnd);
+                segmentContainerPtr->segment = std::make_optional<Segment<B>>(*backends[getStripe(i)], directory[i]);
+            } else {
+                // IO read (segment header)
+                segmentContainerPtr->segment = std::make_optional<Segment<B>>(*backends[getStripe(i)], stripeEnd);
+            }
+            segmentContainerPtr->initialized = true;
             if (segmentContainerPtr->segment->freeBlocks() > 0) {
                 freeSegments.insert(i);
             }
             // increase the offset
-            currentSegmentOffset = segmentContainerPtr->segment->getOffset() +
-                                   segmentContainerPtr->segment->getTotalSize();
+            stripeEnd = segmentContainerPtr->segment->getOffset() +
+                        segmentContainerPtr->segment->getTotalSize();
             segments.push_back(std::move(segmentContainerPtr));
         }
     } else {
-        std::filesystem::create_directories(dirPath);
-        fd = open(headerFile.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-        if (fd < 0) {
-            throw std::runtime_error("Could not create the segment file!");
+        if (options.io.type != io::IOBackendType::MEMORY) {
+            std::filesystem::create_directories(dirPath);
+            for (const auto& stripeDirectory: options.stripeDirectories) {
+                std::filesystem::create_directories(stripeDirectory);
+            }
+        }
+        for (const auto& stripeFile: stripeFiles) {
+            backends.push_back(openBackend(stripeFile, O_RDWR | O_CREAT | O_TRUNC | directFlag, options.io));
+            if (!backends.back()) {
+                throw std::runtime_error("Could not create the segment file!");
+            }
+            backends.back()->setStatistics(&statistics);
+            // the first block is reserved for the header
+            if (!backends.back()->resize(B)) {
+                throw std::runtime_error("Could not increase the file size (segment file).");
+            }
+        }
+        if (options.io.type != io::IOBackendType::MEMORY) {
+            std::filesystem::remove(metadataFile);
+        }
+        header = {0, 0, backends.size(), 0};
+        stripeEnds.assign(backends.size(), B);
+    }
+    for (const auto& backend: backends) {
+        preallocatedEnds.push_back(backend->size());
+    }
+    if (preallocate && options.backgroundPreallocation) {
+        preallocationThread = std::thread(&SegmentManager<B>::preallocateInBackground, this);
+    }
+    if (options.logStructured) {
+        log = std::make_unique<LogStructure>(options.cleanerThreshold, options.cleanerInterval, options.compression);
+        openMapping(std::move(mapping));
+        if (options.cleanerInterval.count() > 0) {
+            log->cleanerThread = std::thread(&SegmentManager<B>::cleanInBackground, this);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+SegmentManager<B>::~SegmentManager() {
+    if (log && log->cleanerThread.joinable()) {
+        {
+            std::unique_lock lock(log->cleanerThreadMutex);
+            log->stopCleaner = true;
         }
-        header = {0, 0};
-        if (ftruncate(fd, B) < 0) {
-            throw std::runtime_error("Could not increase the file size (segment file).");
+        log->cleanerCondition.notify_one();
+        log->cleanerThread.join();
+    }
+    if (preallocationThread.joinable()) {
+        {
+            std::unique_lock lock(preallocationMutex);
+            stopPreallocation = true;
         }
+        preallocationCondition.notify_one();
+        preallocationThread.join();
+    }
+    // the threads may outlive the manager -> detach their caches
+    std::unique_lock lock(cacheMutex);
+    for (auto& cache: caches) {
+        std::unique_lock cacheLock(cache->mutex);
+        cache->owner = nullptr;
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+SegmentManager<B>::ThreadCaches::~ThreadCaches() {
+    for (auto& [uid, cache]: caches) {
+        std::unique_lock lock(cache->mutex);
+        if (cache->owner) {
+            for (std::uint64_t id: cache->ids) {
+                cache->owner->releaseBlock(id);
+            }
+        }
+        cache->ids.clear();
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+SegmentManager<B>::LogStructure::LogStructure(double cleanerThreshold, std::chrono::milliseconds cleanerInterval,
+                                              bool compression)
+    : compression(compression), cleanerThreshold(cleanerThreshold), cleanerInterval(cleanerInterval) {
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::uint64_t SegmentManager<B>::LogStructure::makeLocation(std::uint64_t physicalID, std::size_t slot,
+                                                            std::size_t slots) {
+    const std::uint64_t block = physicalID & ((std::uint64_t(1) << 48) - 1);
+    assert(block < (std::uint64_t(1) << 40) && slot + slots <= SLOTS && slots > 0);
+    return (physicalID >> 48 << 48) | (block << 8) | (slot << 4) | (slots - 1);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::uint64_t SegmentManager<B>::LogStructure::getPhysicalID(std::uint64_t location) {
+    return (location >> 48 << 48) | ((location & ((std::uint64_t(1) << 48) - 1)) >> 8);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::size_t SegmentManager<B>::LogStructure::getSlot(std::uint64_t location) {
+    return (location >> 4) & (SLOTS - 1);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::size_t SegmentManager<B>::LogStructure::getSlots(std::uint64_t location) {
+    return (location & (SLOTS - 1)) + 1;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::uint64_t SegmentManager<B>::nextUID() {
+    static std::atomic<std::uint64_t> counter = 0;
+    return counter++;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::unique_ptr<io::IOBackend> SegmentManager<B>::openBackend(const std::string& path, int flags,
+                                                              const io::IOBackendOptions& options) {
+    if (options.type == io::IOBackendType::MEMORY) {
+        return io::createBackend(-1, options);
+    }
+    int fd = open(path.c_str(), flags, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return io::createBackend(fd, options);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::replaceFile(const std::string& path, std::span<const unsigned char> data) {
+    if (metadataOptions.type == io::IOBackendType::MEMORY) {
+        // nothing is persisted
+        return;
+    }
+    const std::string temporaryPath = path + ".tmp";
+    {
+        auto backend = openBackend(temporaryPath, O_RDWR | O_CREAT | O_TRUNC, metadataOptions);
+        if (!backend) {
+            util::raise("Could not create " + temporaryPath + ".");
+        }
+        backend->setStatistics(&statistics);
+        if (!data.empty()) {
+            backend->write(data.data(), data.size(), 0);// IO write
+        }
+        if (!backend->sync()) {
+            util::raise("Could not sync " + temporaryPath + ".");
+        }
+    }
+    std::filesystem::rename(temporaryPath, path);
+    // the rename is durable once the directory is synced
+    int fd = open(dirPath.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || fsync(fd) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        util::raise("Could not sync " + dirPath + ".");
+    }
+    close(fd);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+bool SegmentManager<B>::readMetadata(std::vector<typename Segment<B>::DirectoryEntry>& directory,
+                                     std::vector<std::uint64_t>& mapping) {
+    generation = header.generation;
+    auto backend = openBackend(metadataFile, O_RDONLY, metadataOptions);
+    if (!backend) {
+        return false;
+    }
+    backend->setStatistics(&statistics);
+    const std::size_t size = backend->size();
+    if (size < sizeof(MetadataHeader)) {
+        return false;
+    }
+    std::vector<unsigned char> data(size);
+    backend->read(data.data(), size, 0);// IO read (all segments)
+    MetadataHeader metadataHeader;
+    std::memcpy(&metadataHeader, data.data(), sizeof(MetadataHeader));
+    const std::size_t directorySize = metadataHeader.numberOfSegments * sizeof(typename Segment<B>::DirectoryEntry);
+    const std::size_t mappingSize = metadataHeader.mappingSize * sizeof(std::uint64_t);
+    const std::span<const unsigned char> content(data.begin() + sizeof(MetadataHeader), data.end());
+    // written for this block size and not torn
+    if (metadataHeader.blockSize != B ||
+        content.size() != directorySize + mappingSize + metadataHeader.userHeaderSize ||
+        checksum(content) != metadataHeader.checksum) {
+        return false;
+    }
+    generation = std::max(header.generation, metadataHeader.generation);
+    // the directory was written by a flush whose segment headers are
+    // persisted (and not changed since)
+    if (metadataHeader.generation == header.generation && header.generation != 0 &&
+        metadataHeader.numberOfSegments == header.numberOfSegments) {
+        directory.resize(header.numberOfSegments);
+        if (directorySize > 0) {
+            std::memcpy(directory.data(), content.data(), directorySize);
+        }
+    }
+    mapping.resize(metadataHeader.mappingSize);
+    if (mappingSize > 0) {
+        std::memcpy(mapping.data(), content.data() + directorySize, mappingSize);
+    }
+    userHeader.assign(content.begin() + directorySize + mappingSize, content.end());
+    return true;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::size_t SegmentManager<B>::getStripe(std::size_t segmentIndex) const {
+    return segmentIndex % backends.size();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::allocateSpace(std::size_t stripe, std::size_t end) {
+    std::unique_lock lock(preallocationMutex);
+    std::size_t& preallocatedEnd = preallocatedEnds[stripe];
+    if (end <= preallocatedEnd) {
+        // done ahead of time (or by the background thread)
+        return;
+    }
+    auto& backend = *backends[stripe];
+    if (preallocate) {
+        // allocate whole chunks -> contiguous extents, less fragmentation
+        std::size_t chunkEnd = end;
+        if (preallocationChunk > 0) {
+            chunkEnd = (end + preallocationChunk - 1) / preallocationChunk * preallocationChunk;
+        }
+        if (backend.allocate(chunkEnd - preallocatedEnd, preallocatedEnd)) {
+            preallocatedEnd = chunkEnd;
+            return;
+        }
+        // the file system does not support it -> fall back to a sparse file
+        // note: other errors (e.g. no space left) raise
+    }
+    if (!backend.resize(end)) {
+        util::raise("Could not increase the file size (segment file).");
+    }
+    preallocatedEnd = end;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::preallocateInBackground() {
+    std::unique_lock lock(preallocationMutex);
+    while (true) {
+        preallocationCondition.wait(lock, [this]() {
+            return stopPreallocation || !preallocationQueue.empty();
+        });
+        if (stopPreallocation) {
+            return;
+        }
+        const auto [stripe, end] = preallocationQueue.front();
+        preallocationQueue.pop_front();
+        lock.unlock();
+        try {
+            allocateSpace(stripe, end);// IO (metadata)
+        } catch (const std::runtime_error&) {
+            // the allocation (on use of the segment) tries again and raises
+        }
+        lock.lock();
     }
 }
 // --------------------------------------------------------------------------
@@ -112,69 +684,304 @@ std::size_t SegmentManager<B>::getBlockFromID(std::uint64_t id) const {
 }
 // --------------------------------------------------------------------------
 template<std::size_t B>
-std::uint64_t SegmentManager<B>::createBlock() {
+Segment<B>& SegmentManager<B>::accessSegment(std::size_t segmentIndex) {
+    // no lock: the segments are published by the table
+    auto& segmentContainer = *segments.at(segmentIndex);
+    if (!segmentContainer.initialized.load(std::memory_order_acquire)) {
+        // the segment has not been initialized -> wait until it has
+        {
+            std::shared_lock segmentLock(segmentContainer.mutex);
+        }
+    }
+    assert(segmentContainer.segment);
+    return *segmentContainer.segment;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::reserveBlocks(std::size_t amount, std::vector<std::uint64_t>& ids,
+                                      bool emptySegment) {
+    assert(amount > 0);
     // lock the segment manager
     std::unique_lock mainLock(mutex);
-    if (segments.empty() || freeSegments.empty()) {
+    std::optional<std::size_t> freeSegment;
+    if (!emptySegment && !freeSegments.empty()) {
+        freeSegment = *freeSegments.begin();
+    }
+    for (auto it = freeSegments.begin(); emptySegment && it != freeSegments.end(); ++it) {
+        auto& segmentContainer = *segments[*it];
+        std::shared_lock segmentLock(segmentContainer.mutex);
+        const auto& segment = *segmentContainer.segment;
+        if (segment.freeBlocks() == segment.allocatedBlocks() && !log->cleaning.contains(*it)) {
+            freeSegment = *it;
+            amount = segment.freeBlocks();
+            break;
+        }
+    }
+    if (!freeSegment) {
         // here, the segments are created
         if (segments.empty()) {
             assert(header.numberOfSegments == 0);
         }
-        assert(freeSegments.empty());
+        assert(emptySegment || freeSegments.empty());
         header.lastAllocatedBlocks = std::max<std::size_t>(10, header.lastAllocatedBlocks * growthFactor);
         // we need these for the segment
-        const std::size_t segmentOffset = (header.numberOfSegments == 0)
-                                                  ? B
-                                                  : segments.back()->segment->getOffset() +
-                                                            segments.back()->segment->getTotalSize();
         const std::size_t segmentSize = header.lastAllocatedBlocks;
+        if (emptySegment) {
+            amount = segmentSize;
+        }
+        const std::size_t stripe = getStripe(segments.size());
+        auto& backend = *backends[stripe];
+        const std::size_t segmentOffset = stripeEnds[stripe];
+        stripeEnds[stripe] += Segment<B>::requiredSize(segmentSize);
+        // the header, the bitmap and all blocks are B bytes -> offsets stay block-aligned (O_DIRECT)
+        assert(segmentOffset % B == 0);
         auto segmentContainerPtr = std::make_unique<SegmentContainer>();
         segments.push_back(std::move(segmentContainerPtr));
         const std::size_t segmentIndex = segments.size() - 1;
-        // mark the new segment as free
-        freeSegments.insert(segmentIndex);
+        if (amount < segmentSize) {
+            // mark the new segment as free
+            freeSegments.insert(segmentIndex);
+        }
         header.numberOfSegments++;
         // now access and load the segment
-        std::uint64_t blockID;
+        std::vector<std::uint64_t> blockIDs;
         {
             auto& segmentContainer = *segments.back();
             // first, make space for the new segment
-            ftruncate(fd, segmentOffset + B + segmentSize * B);
+            allocateSpace(stripe, stripeEnds[stripe]);
+            if (preallocationThread.joinable()) {
+                // and already for the next one
+                const std::size_t nextStripe = getStripe(segments.size());
+                const std::size_t nextSize = std::max<std::size_t>(10, segmentSize * growthFactor);
+                {
+                    std::unique_lock lock(preallocationMutex);
+                    preallocationQueue.emplace_back(nextStripe,
+                                                    stripeEnds[nextStripe] + Segment<B>::requiredSize(nextSize));
+                }
+                preallocationCondition.notify_one();
+            }
             // lock the segment
             std::unique_lock segmentLock(segmentContainer.mutex);
             // unlock the segment manager
             mainLock.unlock();
             // initialize the segment
-            segmentContainer.segment = std::move(Segment<B>(fd, segmentOffset, segmentSize));
-            // create a new block
-            blockID = segmentContainer.segment->createBlock();
+            segmentContainer.segment = std::move(Segment<B>(backend, segmentOffset, segmentSize));
+            segmentContainer.initialized.store(true, std::memory_order_release);
+            // create the new blocks
+            segmentContainer.segment->createBlocks(amount, blockIDs);
             // unlock the segment
         }
-        return (segmentIndex << 48) | blockID;
+        for (std::uint64_t blockID: blockIDs) {
+            ids.push_back((segmentIndex << 48) | blockID);
+        }
+        return;
     }
-    const std::size_t segmentIndex = *freeSegments.begin();
+    const std::size_t segmentIndex = *freeSegment;
     auto& segmentContainer = *segments.at(segmentIndex);
-    std::size_t blockID;
-    // create a new block
+    std::vector<std::uint64_t> blockIDs;
+    // create the new blocks
     {
         // lock the segment
         std::unique_lock segmentLock(segmentContainer.mutex);
         assert(segmentContainer.segment->freeBlocks() > 0);
-        if (segmentContainer.segment->freeBlocks() == 1) {
+        if (segmentContainer.segment->freeBlocks() <= amount) {
             // mark the segment as full
             freeSegments.erase(segmentIndex);// only operation which needs both locks
         }
         // unlock the segment manager
         mainLock.unlock();
-        // create the blockID
-        blockID = segmentContainer.segment->createBlock();
+        // create the blockIDs (no IO)
+        segmentContainer.segment->createBlocks(amount, blockIDs);
         // unlock the segment
     }
-    return (segmentIndex << 48) | blockID;
+    for (std::uint64_t blockID: blockIDs) {
+        ids.push_back((segmentIndex << 48) | blockID);
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+typename SegmentManager<B>::AllocationCache& SegmentManager<B>::getAllocationCache() {
+    static thread_local ThreadCaches threadCaches;
+    auto it = threadCaches.caches.find(uid);
+    if (it != threadCaches.caches.end()) {
+        return *it->second;
+    }
+    // forget the caches of destroyed managers
+    std::erase_if(threadCaches.caches, [](const auto& entry) {
+        std::unique_lock lock(entry.second->mutex);
+        return entry.second->owner == nullptr;
+    });
+    auto cache = std::make_shared<AllocationCache>();
+    cache->owner = this;
+    {
+        std::unique_lock lock(cacheMutex);
+        caches.push_back(cache);
+    }
+    return *threadCaches.caches.emplace(uid, std::move(cache)).first->second;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::drainAllocationCaches() {
+    std::unique_lock lock(cacheMutex);
+    for (auto& cache: caches) {
+        std::unique_lock cacheLock(cache->mutex);
+        for (std::uint64_t id: cache->ids) {
+            releaseBlock(id);
+        }
+        cache->ids.clear();
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::uint64_t SegmentManager<B>::createBlock() {
+    statistics.recordAllocations(1);
+    if (log) {
+        // the block gets its location once it is written
+        std::unique_lock mappingLock(log->mappingMutex);
+        if (!log->freeIDs.empty()) {
+            const std::uint64_t result = log->freeIDs.back();
+            log->freeIDs.pop_back();
+            log->mapping[result] = LogStructure::UNWRITTEN;
+            return result;
+        }
+        log->mapping.push_back(LogStructure::UNWRITTEN);
+        return log->mapping.size() - 1;
+    }
+    if (allocationBatch == 0) {
+        std::vector<std::uint64_t> ids;
+        reserveBlocks(1, ids);
+        return ids.front();
+    }
+    auto& cache = getAllocationCache();
+    // only contended while the cache is drained
+    std::unique_lock lock(cache.mutex);
+    if (cache.ids.empty()) {
+        reserveBlocks(allocationBatch, cache.ids);
+        // hand out the lowest ids first
+        std::reverse(cache.ids.begin(), cache.ids.end());
+    }
+    const std::uint64_t result = cache.ids.back();
+    cache.ids.pop_back();
+    return result;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::uint64_t SegmentManager<B>::createBlock(std::uint64_t hintID) {
+    if (log) {
+        // the writes decide the location
+        return createBlock();
+    }
+    const std::size_t hintSegment = getIndexFromID(hintID);
+    const std::uint64_t hintBlock = getBlockFromID(hintID);
+    if (allocationBatch > 0) {
+        auto& cache = getAllocationCache();
+        std::unique_lock lock(cache.mutex);
+        // the reserved ids all belong to one segment
+        if (!cache.ids.empty() && getIndexFromID(cache.ids.front()) == hintSegment) {
+            const auto distance = [hintBlock, this](std::uint64_t id) {
+                const std::uint64_t block = getBlockFromID(id);
+                return block > hintBlock ? block - hintBlock : hintBlock - block;
+            };
+            auto it = std::min_element(cache.ids.begin(), cache.ids.end(),
+                                       [&distance](std::uint64_t a, std::uint64_t b) {
+                                           return distance(a) < distance(b);
+                                       });
+            const std::uint64_t result = *it;
+            cache.ids.erase(it);
+            statistics.recordAllocations(1);
+            return result;
+        }
+    }
+    if (hintSegment < segments.size() && segments[hintSegment]->initialized) {
+        // only the latch of the hinted segment (the main lock is needed
+        // once the segment gets full -> its last block takes the path below)
+        auto& segmentContainer = *segments[hintSegment];
+        std::unique_lock segmentLock(segmentContainer.mutex);
+        auto& segment = *segmentContainer.segment;
+        if (!segmentContainer.draining && segment.freeBlocks() > 1) {
+            const std::uint64_t blockID = segment.createBlockNear(hintBlock);// potential IO read
+            segmentLock.unlock();
+            statistics.recordAllocations(1);
+            return (hintSegment << 48) | blockID;
+        }
+    }
+    // lock the segment manager
+    std::unique_lock mainLock(mutex);
+    // find the closest free segment in the same file
+    std::optional<std::size_t> segmentIndex;
+    auto segmentIt = freeSegments.lower_bound(hintSegment);
+    for (auto it = segmentIt; it != freeSegments.end(); ++it) {
+        if (getStripe(*it) == getStripe(hintSegment)) {
+            segmentIndex = *it;
+            break;
+        }
+    }
+    for (auto it = std::make_reverse_iterator(segmentIt); it != freeSegments.rend(); ++it) {
+        if (getStripe(*it) == getStripe(hintSegment)) {
+            if (!segmentIndex || hintSegment - *it < *segmentIndex - hintSegment) {
+                segmentIndex = *it;
+            }
+            break;
+        }
+    }
+    if (!segmentIndex) {
+        // unlock the segment manager
+        mainLock.unlock();
+        return createBlock();
+    }
+    auto& segmentContainer = *segments.at(*segmentIndex);
+    std::uint64_t blockID;
+    {
+        // lock the segment
+        std::unique_lock segmentLock(segmentContainer.mutex);
+        auto& segment = *segmentContainer.segment;
+        assert(segment.freeBlocks() > 0);
+        if (segment.freeBlocks() == 1) {
+            // mark the segment as full
+            freeSegments.erase(*segmentIndex);// only operation which needs both locks
+        }
+        // unlock the segment manager
+        mainLock.unlock();
+        // create the blockID (no IO) as close to the hint as possible
+        if (*segmentIndex == hintSegment) {
+            blockID = segment.createBlockNear(hintBlock);
+        } else if (*segmentIndex < hintSegment) {
+            blockID = segment.createBlockNear(segment.allocatedBlocks() - 1);
+        } else {
+            blockID = segment.createBlock();
+        }
+        // unlock the segment
+    }
+    statistics.recordAllocations(1);
+    return (*segmentIndex << 48) | blockID;
 }
 // --------------------------------------------------------------------------
 template<std::size_t B>
 void SegmentManager<B>::deleteBlock(std::uint64_t id) {
+    statistics.recordDeletes(1);
+    if (log) {
+        std::uint64_t location;
+        {
+            std::unique_lock mappingLock(log->mappingMutex);
+            if (id >= log->mapping.size() || log->mapping[id] == LogStructure::FREE) {
+                util::raise("Invalid block id!");
+            }
+            location = log->mapping[id];
+            log->mapping[id] = LogStructure::FREE;
+            log->freeIDs.push_back(id);
+            if (location == LogStructure::UNWRITTEN) {
+                return;
+            }
+            log->owners.erase(location);
+        }
+        releaseLocations({location});
+        return;
+    }
+    releaseBlock(id);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::releaseBlock(std::uint64_t id) {
     const std::size_t segmentIndex = getIndexFromID(id);
     const std::size_t blockID = getBlockFromID(id);
     // lock the segment manager
@@ -186,10 +993,12 @@ void SegmentManager<B>::deleteBlock(std::uint64_t id) {
         std::unique_lock segmentLock(segmentContainer.mutex);
         assert(segmentContainer.segment);
         // mark the segment as free
-        freeSegments.insert(segmentIndex);// only operation which needs both locks
+        if (!isDraining(segmentIndex)) {
+            freeSegments.insert(segmentIndex);// only operation which needs both locks
+        }
         // unlock the segment manager
         mainLock.unlock();
-        // IO write
+        // only marks the block as free (no IO)
         segmentContainer.segment->deleteBlock(blockID);
         // unlock the segment
     }
@@ -197,67 +1006,905 @@ void SegmentManager<B>::deleteBlock(std::uint64_t id) {
 // --------------------------------------------------------------------------
 template<std::size_t B>
 std::array<unsigned char, B> SegmentManager<B>::readBlock(std::uint64_t id) {
-    const std::size_t segmentIndex = getIndexFromID(id);
-    const std::size_t blockID = getBlockFromID(id);
-    // lock the segment manager
-    std::shared_lock mainLock(mutex);
-    auto& segmentContainer = *segments.at(segmentIndex);
-    // unlock the segment manager
-    mainLock.unlock();
     std::array<unsigned char, B> result;
+    readBlockInto(id, result);
+    return result;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeBlock(std::uint64_t id, std::array<unsigned char, B> data) {
+    writeBlockFrom(id, data);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::readBlockInto(std::uint64_t id, std::span<unsigned char, B> data) {
+    if (log) {
+        std::shared_lock mappingLock(log->mappingMutex);
+        if (id >= log->mapping.size() || log->mapping[id] == LogStructure::FREE) {
+            util::raise("Invalid block id!");
+        }
+        const std::uint64_t location = log->mapping[id];
+        if (location == LogStructure::UNWRITTEN) {
+            std::fill(data.begin(), data.end(), 0);
+            return;
+        }
+        // the block is freed only after its readers are done
+        auto& segmentContainer = *segments[getIndexFromID(LogStructure::getPhysicalID(location))];
+        std::shared_lock segmentLock(segmentContainer.mutex);
+        mappingLock.unlock();
+        const std::size_t slots = LogStructure::getSlots(location);
+        if (slots == LogStructure::SLOTS) {
+            // stored uncompressed
+            readSlots(location, data);// IO read
+            return;
+        }
+        std::array<unsigned char, B> stored;
+        readSlots(location, stored);// IO read
+        if (!decompress(std::span(stored.data(), slots * SLOT_SIZE), data)) {
+            util::raise("Corrupted block!");
+        }
+        return;
+    }
+    accessSegment(getIndexFromID(id)).readBlockInto(getBlockFromID(id), data);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeBlockFrom(std::uint64_t id, std::span<const unsigned char, B> data) {
+    if (log) {
+        writeBlocks({{id, data}});
+        return;
+    }
+    accessSegment(getIndexFromID(id)).writeBlockFrom(getBlockFromID(id), data);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeAndReadBlock(std::uint64_t writeID, std::span<const unsigned char, B> writeData,
+                                          std::uint64_t readID, std::span<unsigned char, B> readData) {
+    if (!log) {
+        const std::size_t writeSegment = getIndexFromID(writeID);
+        const std::size_t readSegment = getIndexFromID(readID);
+        auto& backend = *backends[getStripe(writeSegment)];
+        std::array<io::IORequest, 2> requests = {{
+                {io::IOOperation::WRITE, const_cast<unsigned char*>(writeData.data()), B,
+                 accessSegment(writeSegment).getBlockOffset(getBlockFromID(writeID))},
+                {io::IOOperation::READ, readData.data(), B,
+                 accessSegment(readSegment).getBlockOffset(getBlockFromID(readID))},
+        }};
+        if (getStripe(writeSegment) == getStripe(readSegment) && backend.isAligned(requests[0]) &&
+            backend.isAligned(requests[1])) {
+            backend.submit(requests);// IO write + read
+            return;
+        }
+    }
+    // different files (or unaligned frames with O_DIRECT, which go through
+    // a bounce buffer) -> one after the other
+    writeBlockFrom(writeID, writeData);// IO write
+    readBlockInto(readID, readData);   // IO read
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeBlocks(std::vector<BlockWrite> writes) {
+    if (!log) {
+        writeBlocksInPlace(std::move(writes));
+        return;
+    }
+    if (writes.empty()) {
+        return;
+    }
+    // the blocks are appended to the head (sequential writes)
+    const auto locations = appendBlocks(writes);
+    std::vector<std::uint64_t> logicalIDs;
+    logicalIDs.reserve(writes.size());
+    for (const auto& write: writes) {
+        logicalIDs.push_back(write.first);
+    }
+    releaseLocations(remapBlocks(logicalIDs, locations));
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::vector<std::uint64_t> SegmentManager<B>::appendBlocks(const std::vector<BlockWrite>& writes, bool unpersisted) {
+    std::vector<std::size_t> slots;
+    std::vector<std::span<const unsigned char>> data;
+    std::vector<std::array<unsigned char, B>> buffers(log->compression ? writes.size() : 0);
+    for (std::size_t i = 0; i < writes.size(); i++) {
+        // a block which needs all slots is stored uncompressed
+        const std::size_t size = log->compression
+                                         ? compress(writes[i].second, std::span(buffers[i]).first(B - SLOT_SIZE))
+                                         : 0;
+        if (size == 0) {
+            slots.push_back(LogStructure::SLOTS);
+            data.push_back(writes[i].second);
+        } else {
+            slots.push_back((size + SLOT_SIZE - 1) / SLOT_SIZE);
+            std::fill(buffers[i].begin() + size, buffers[i].begin() + slots.back() * SLOT_SIZE, 0);
+            data.push_back(std::span(buffers[i]).first(slots.back() * SLOT_SIZE));
+        }
+        if (log->compression) {
+            statistics.recordCompression(B, slots.back() * SLOT_SIZE);
+        }
+    }
+    std::vector<std::uint64_t> locations;
+    appendSlots(slots, locations, unpersisted);
+    writeLocations(locations, data);
+    return locations;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeBlocksInPlace(std::vector<BlockWrite> writes) {
+    std::vector<Extent> extents;
+    extents.reserve(writes.size());
+    for (const auto& [id, data]: writes) {
+        const std::size_t segmentIndex = getIndexFromID(id);
+        extents.push_back({getStripe(segmentIndex),
+                           accessSegment(segmentIndex).getBlockOffset(getBlockFromID(id)), data});
+    }
+    writeExtents(std::move(extents));
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeExtents(std::vector<Extent> extents) {
+    if (extents.empty()) {
+        return;
+    }
+    // sorting the extents groups them by file
+    std::sort(extents.begin(), extents.end(), [](const Extent& a, const Extent& b) {
+        return std::tie(a.stripe, a.offset) < std::tie(b.stripe, b.offset);
+    });
+    std::vector<iovec> buffers;
+    buffers.reserve(extents.size());
+    // (first buffer, amount of buffers, file offset, size, stripe)
+    std::vector<std::tuple<std::size_t, std::size_t, std::size_t, std::size_t, std::size_t>> runs;
+    for (std::size_t i = 0; i < extents.size(); i++) {
+        const auto& extent = extents[i];
+        assert(i == 0 || extents[i - 1].stripe != extent.stripe ||
+               extents[i - 1].offset + extents[i - 1].data.size() <= extent.offset);
+        if (!runs.empty() && std::get<4>(runs.back()) == extent.stripe &&
+            std::get<2>(runs.back()) + std::get<3>(runs.back()) == extent.offset &&
+            std::get<1>(runs.back()) < io::IOBackend::MAX_VECTORS) {
+            std::get<1>(runs.back())++;
+            std::get<3>(runs.back()) += extent.data.size();
+        } else {
+            runs.emplace_back(buffers.size(), 1, extent.offset, extent.data.size(), extent.stripe);
+        }
+        buffers.push_back({const_cast<unsigned char*>(extent.data.data()), extent.data.size()});
+    }
+    // one batch per stripe file
+    std::vector<std::vector<io::IORequest>> requests(backends.size());
+    for (const auto& [first, amount, offset, size, stripe]: runs) {
+        if (amount == 1) {
+            requests[stripe].push_back({io::IOOperation::WRITE, buffers[first].iov_base, size, offset});
+        } else {
+            requests[stripe].push_back({io::IOOperation::WRITE, nullptr, size, offset,
+                                        std::span<const iovec>(buffers.data() + first, amount)});
+        }
+    }
+    // the files may be on different devices -> write them concurrently
+    std::vector<std::future<void>> stripeWrites;
+    for (std::size_t stripe = 1; stripe < backends.size(); stripe++) {
+        if (!requests[stripe].empty()) {
+            stripeWrites.push_back(std::async(std::launch::async, [this, &requests, stripe]() {
+                backends[stripe]->submit(requests[stripe]);// IO write
+            }));
+        }
+    }
+    if (!requests.front().empty()) {
+        backends.front()->submit(requests.front());// IO write
+    }
+    for (auto& stripeWrite: stripeWrites) {
+        stripeWrite.get();
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::prefetch(std::span<const std::uint64_t> ids) {
+    if (ids.empty() || backends.front()->isDirect()) {
+        return;
+    }
+    // (stripe, file offset, size)
+    std::vector<std::tuple<std::size_t, std::size_t, std::size_t>> ranges;
+    if (log) {
+        std::shared_lock mappingLock(log->mappingMutex);
+        for (std::uint64_t id: ids) {
+            // the unwritten blocks are not read
+            if (id >= log->mapping.size() || log->mapping[id] >= LogStructure::UNWRITTEN) {
+                continue;
+            }
+            const std::uint64_t location = log->mapping[id];
+            const std::uint64_t physicalID = LogStructure::getPhysicalID(location);
+            const std::size_t segmentIndex = getIndexFromID(physicalID);
+            ranges.emplace_back(getStripe(segmentIndex),
+                                accessSegment(segmentIndex).getBlockOffset(getBlockFromID(physicalID)) +
+                                        LogStructure::getSlot(location) * SLOT_SIZE,
+                                LogStructure::getSlots(location) * SLOT_SIZE);
+        }
+    } else {
+        for (std::uint64_t id: ids) {
+            const std::size_t segmentIndex = getIndexFromID(id);
+            ranges.emplace_back(getStripe(segmentIndex),
+                                accessSegment(segmentIndex).getBlockOffset(getBlockFromID(id)), B);
+        }
+    }
+    if (ranges.empty()) {
+        return;
+    }
+    std::sort(ranges.begin(), ranges.end());
+    // the current run
+    auto [runStripe, runOffset, runSize] = ranges.front();
+    for (std::size_t i = 1; i < ranges.size(); i++) {
+        const auto [stripe, offset, size] = ranges[i];
+        if (stripe == runStripe && offset <= runOffset + runSize) {
+            runSize = std::max(runSize, offset + size - runOffset);
+            continue;
+        }
+        backends[runStripe]->willNeed(runSize, runOffset);
+        runStripe = stripe;
+        runOffset = offset;
+        runSize = size;
+    }
+    backends[runStripe]->willNeed(runSize, runOffset);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+bool SegmentManager<B>::isDraining(std::size_t segmentIndex) const {
+    return segmentIndex >= drainBegin && segmentIndex < drainEnd;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::vector<std::uint64_t> SegmentManager<B>::beginCompaction(double maxFillRatio) {
+    if (log) {
+        // the ids are logical -> nothing to relocate for the caller
+        clean(maxFillRatio);
+        return {};
+    }
     {
-        if (!segmentContainer.segment) {
-            // the segment has not been initialized -> wait until it has
-            {
-                std::shared_lock segmentLock(segmentContainer.mutex);
+        // lock the segment manager
+        std::unique_lock mainLock(mutex);
+        if (drainBegin != drainEnd) {
+            util::raise("The segments are already compacted!");
+        }
+        std::size_t totalFree = 0;
+        for (std::size_t segmentIndex = 0; segmentIndex < segments.size(); segmentIndex++) {
+            const auto& segmentContainerPtr = segments[segmentIndex];
+            if (!segmentContainerPtr->initialized) {
+                // a segment is still created
+                return {};
             }
+            totalFree += segmentContainerPtr->segment->freeBlocks();
+        }
+        // select the sparse tail
+        std::size_t begin = segments.size();
+        std::size_t tailLive = 0;
+        std::size_t tailFree = 0;
+        while (begin > 0) {
+            const auto& segment = *segments[begin - 1]->segment;
+            const std::size_t live = segment.allocatedBlocks() - segment.freeBlocks();
+            if (live > maxFillRatio * segment.allocatedBlocks()) {
+                break;
+            }
+            // the live blocks have to fit into the segments in front
+            if (tailLive + live > totalFree - tailFree - segment.freeBlocks()) {
+                break;
+            }
+            tailLive += live;
+            tailFree += segment.freeBlocks();
+            begin--;
+        }
+        if (begin == segments.size()) {
+            return {};
+        }
+        drainBegin = begin;
+        drainEnd = segments.size();
+        for (std::size_t segmentIndex = drainBegin; segmentIndex < drainEnd; segmentIndex++) {
+            freeSegments.erase(segmentIndex);
+            // no hinted allocation either (see createBlock)
+            std::unique_lock segmentLock(segments[segmentIndex]->mutex);
+            segments[segmentIndex]->draining = true;
+        }
+    }
+    // the reserved but unused ids are not live
+    drainAllocationCaches();
+    std::vector<std::uint64_t> result;
+    // lock the segment manager (the segments may grow concurrently)
+    std::shared_lock mainLock(mutex);
+    for (std::size_t segmentIndex = drainBegin; segmentIndex < drainEnd; segmentIndex++) {
+        auto& segmentContainer = *segments[segmentIndex];
+        std::unique_lock segmentLock(segmentContainer.mutex);
+        std::vector<std::uint64_t> blockIDs;
+        segmentContainer.segment->collectLiveBlocks(blockIDs);// potential IO read
+        for (std::uint64_t blockID: blockIDs) {
+            result.push_back((segmentIndex << 48) | blockID);
         }
-        assert(segmentContainer.segment);
-        result = std::move(segmentContainer.segment->readBlock(blockID));
     }
     return result;
 }
 // --------------------------------------------------------------------------
 template<std::size_t B>
-void SegmentManager<B>::writeBlock(std::uint64_t id, std::array<unsigned char, B> data) {
-    const std::size_t segmentIndex = getIndexFromID(id);
-    const std::size_t blockID = getBlockFromID(id);
-    // lock the segment manager
+bool SegmentManager<B>::isCompacting() const {
     std::shared_lock mainLock(mutex);
-    auto& segmentContainer = *segments.at(segmentIndex);
-    // unlock the segment manager
-    mainLock.unlock();
-    std::optional<std::array<unsigned char, B>> result;
+    return drainBegin != drainEnd;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::cancelCompaction() {
+    // lock the segment manager
+    std::unique_lock mainLock(mutex);
+    // the blocks relocated so far stay free (reused by the next creates)
+    for (std::size_t segmentIndex = drainBegin; segmentIndex < drainEnd; segmentIndex++) {
+        auto& segmentContainer = *segments[segmentIndex];
+        std::unique_lock segmentLock(segmentContainer.mutex);
+        if (segmentContainer.segment->freeBlocks() > 0) {
+            freeSegments.insert(segmentIndex);
+        }
+        segmentContainer.draining = false;
+    }
+    drainBegin = 0;
+    drainEnd = 0;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::vector<std::pair<std::size_t, std::size_t>> SegmentManager<B>::removeCompactedSegments() {
+    std::vector<std::pair<std::size_t, std::size_t>> truncations;
+    // only the last segments can be removed (the ids of the others stay valid)
+    while (segments.size() > drainBegin && segments.size() == drainEnd) {
+        const auto& segment = *segments.back()->segment;
+        if (segment.freeBlocks() != segment.allocatedBlocks()) {
+            break;
+        }
+        const std::size_t stripe = getStripe(segments.size() - 1);
+        stripeEnds[stripe] = segment.getOffset();
+        truncations.emplace_back(stripe, stripeEnds[stripe]);
+        freeSegments.erase(segments.size() - 1);
+        segments.pop_back();
+        drainEnd--;
+        header.numberOfSegments--;
+    }
+    if (!truncations.empty()) {
+        // grow from the (new) last segment again
+        header.lastAllocatedBlocks = segments.empty() ? 0 : segments.back()->segment->allocatedBlocks();
+    }
+    return truncations;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::releaseCompactedSegments(
+        const std::vector<std::pair<std::size_t, std::size_t>>& truncations) {
+    for (const auto& [stripe, end]: truncations) {
+        std::unique_lock lock(preallocationMutex);
+        if (!backends[stripe]->resize(end)) {
+            util::raise("Could not decrease the file size (segment file).");
+        }
+        preallocatedEnds[stripe] = std::min(preallocatedEnds[stripe], end);
+    }
+    for (std::size_t segmentIndex = drainBegin; segmentIndex < drainEnd; segmentIndex++) {
+        auto& segment = *segments[segmentIndex]->segment;
+        segment.punchFreeBlocks();// IO (metadata)
+        if (segment.freeBlocks() > 0) {
+            freeSegments.insert(segmentIndex);
+        }
+        segments[segmentIndex]->draining = false;
+    }
+    drainBegin = 0;
+    drainEnd = 0;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::openMapping(std::vector<std::uint64_t> mapping) {
+    log->mapping = std::move(mapping);
+    for (std::size_t id = 0; id < log->mapping.size(); id++) {
+        const std::uint64_t location = log->mapping[id];
+        if (location == LogStructure::FREE) {
+            log->freeIDs.push_back(id);
+        } else if (location != LogStructure::UNWRITTEN) {
+            log->owners.emplace(location, id);
+            log->references[LogStructure::getPhysicalID(location)]++;
+        }
+    }
+    // the blocks of the writes in flight during the flush and the unused
+    // blocks of the head are garbage -> the bitmaps follow from the mapping
+    // (no segment is read)
+    std::vector<std::vector<std::uint64_t>> liveBlocks(segments.size());
+    for (const auto& [physicalID, count]: log->references) {
+        if (getIndexFromID(physicalID) >= segments.size()) {
+            util::raise("Invalid block mapping!");
+        }
+        liveBlocks[getIndexFromID(physicalID)].push_back(getBlockFromID(physicalID));
+    }
+    for (std::size_t segmentIndex = 0; segmentIndex < segments.size(); segmentIndex++) {
+        auto& segment = accessSegment(segmentIndex);
+        segment.resetFreeMap(liveBlocks[segmentIndex]);
+        if (segment.freeBlocks() > 0) {
+            freeSegments.insert(segmentIndex);
+        } else {
+            freeSegments.erase(segmentIndex);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::appendSlots(const std::vector<std::size_t>& slots, std::vector<std::uint64_t>& locations,
+                                    bool unpersisted) {
+    // the references are added at once, the filled blocks lose the head's
+    // reference afterwards
+    std::vector<std::uint64_t> referenced;
+    std::vector<std::uint64_t> started;
+    std::vector<std::uint64_t> filled;
+    std::unique_lock headLock(log->headMutex);
+    for (std::size_t amount: slots) {
+        assert(amount > 0 && amount <= LogStructure::SLOTS);
+        if (!log->head.empty() && log->headSlot + amount > LogStructure::SLOTS) {
+            // the rest of the block stays unused
+            filled.push_back(log->head.front());
+            log->head.pop_front();
+            log->headSlot = 0;
+        }
+        if (log->head.empty()) {
+            // continue in the next empty segment
+            std::vector<std::uint64_t> blockIDs;
+            reserveBlocks(1, blockIDs, true);
+            std::sort(blockIDs.begin(), blockIDs.end());
+            log->head.assign(blockIDs.begin(), blockIDs.end());
+        }
+        const std::uint64_t physicalID = log->head.front();
+        if (log->headSlot == 0) {
+            referenced.push_back(physicalID);
+            started.push_back(physicalID);
+        }
+        locations.push_back(LogStructure::makeLocation(physicalID, log->headSlot, amount));
+        referenced.push_back(physicalID);
+        log->headSlot += amount;
+        if (log->headSlot == LogStructure::SLOTS) {
+            filled.push_back(physicalID);
+            log->head.pop_front();
+            log->headSlot = 0;
+        }
+    }
+    {
+        std::unique_lock referenceLock(log->referenceMutex);
+        for (std::uint64_t physicalID: referenced) {
+            log->references[physicalID]++;
+        }
+        if (unpersisted) {
+            log->unpersisted.insert(started.begin(), started.end());
+        } else {
+            // the block holds slots of the checkpoint
+            for (std::uint64_t physicalID: referenced) {
+                log->unpersisted.erase(physicalID);
+            }
+        }
+    }
+    headLock.unlock();
+    dropReferences(filled);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::vector<std::uint64_t> SegmentManager<B>::remapBlocks(const std::vector<std::uint64_t>& logicalIDs,
+                                                          const std::vector<std::uint64_t>& locations,
+                                                          const std::vector<std::uint64_t>* expectedLocations) {
+    assert(logicalIDs.size() == locations.size());
+    std::vector<std::uint64_t> replaced;
+    std::vector<std::uint64_t> unused;
     {
-        if (!segmentContainer.segment) {
-            // the segment has not been initialized -> wait until it has
-            {
-                std::shared_lock segmentLock(segmentContainer.mutex);
+        std::unique_lock mappingLock(log->mappingMutex);
+        for (std::size_t i = 0; i < logicalIDs.size(); i++) {
+            assert(logicalIDs[i] < log->mapping.size());
+            auto& entry = log->mapping[logicalIDs[i]];
+            // the moved block was written or the block was deleted meanwhile
+            if (expectedLocations ? entry != (*expectedLocations)[i] : entry == LogStructure::FREE) {
+                unused.push_back(locations[i]);
+                continue;
             }
+            if (entry != LogStructure::UNWRITTEN) {
+                log->owners.erase(entry);
+                replaced.push_back(entry);
+            }
+            entry = locations[i];
+            log->owners.emplace(locations[i], logicalIDs[i]);
         }
-        assert(segmentContainer.segment);
-        segmentContainer.segment->writeBlock(blockID, std::move(data));
+    }
+    releaseLocations(unused);
+    return replaced;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::releaseLocations(const std::vector<std::uint64_t>& locations) {
+    std::vector<std::uint64_t> physicalIDs;
+    physicalIDs.reserve(locations.size());
+    for (std::uint64_t location: locations) {
+        physicalIDs.push_back(LogStructure::getPhysicalID(location));
+    }
+    dropReferences(physicalIDs);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::dropReferences(const std::vector<std::uint64_t>& physicalIDs) {
+    std::vector<std::uint64_t> unused;
+    {
+        std::unique_lock referenceLock(log->referenceMutex);
+        for (std::uint64_t physicalID: physicalIDs) {
+            auto it = log->references.find(physicalID);
+            assert(it != log->references.end() && it->second > 0);
+            if (--it->second == 0) {
+                log->references.erase(it);
+                if (log->unpersisted.erase(physicalID) > 0) {
+                    unused.push_back(physicalID);
+                } else {
+                    log->released.push_back(physicalID);
+                }
+            }
+        }
+    }
+    // waits for the readers of the blocks (segment lock)
+    for (std::uint64_t physicalID: unused) {
+        releaseBlock(physicalID);
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::readSlots(std::uint64_t location, std::span<unsigned char, B> data) {
+    const std::uint64_t physicalID = LogStructure::getPhysicalID(location);
+    const std::size_t segmentIndex = getIndexFromID(physicalID);
+    auto& segment = accessSegment(segmentIndex);
+    const std::size_t slots = LogStructure::getSlots(location);
+    if (slots == LogStructure::SLOTS) {
+        segment.readBlockInto(getBlockFromID(physicalID), data);// IO read
+        return;
+    }
+    const std::size_t offset = segment.getBlockOffset(getBlockFromID(physicalID)) +
+                               LogStructure::getSlot(location) * SLOT_SIZE;
+    backends[getStripe(segmentIndex)]->read(data.data(), slots * SLOT_SIZE, offset);// IO read
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeLocations(const std::vector<std::uint64_t>& locations,
+                                       const std::vector<std::span<const unsigned char>>& data) {
+    assert(locations.size() == data.size());
+    std::vector<Extent> extents;
+    extents.reserve(locations.size());
+    for (std::size_t i = 0; i < locations.size(); i++) {
+        const std::uint64_t physicalID = LogStructure::getPhysicalID(locations[i]);
+        const std::size_t segmentIndex = getIndexFromID(physicalID);
+        assert(data[i].size() == LogStructure::getSlots(locations[i]) * SLOT_SIZE);
+        extents.push_back({getStripe(segmentIndex),
+                           accessSegment(segmentIndex).getBlockOffset(getBlockFromID(physicalID)) +
+                                   LogStructure::getSlot(locations[i]) * SLOT_SIZE,
+                           data[i]});
+    }
+    // the slots of the head are adjacent -> few large requests
+    writeExtents(std::move(extents));
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::size_t SegmentManager<B>::clean(double maxLiveRatio) {
+    if (!log) {
+        return 0;
+    }
+    std::unique_lock cleanerLock(log->cleanerMutex);
+    std::set<std::size_t> headSegments;
+    {
+        std::unique_lock headLock(log->headMutex);
+        for (std::uint64_t id: log->head) {
+            headSegments.insert(getIndexFromID(id));
+        }
+    }
+    // live slots per segment (the garbage inside of shared blocks counts)
+    std::unordered_map<std::size_t, std::size_t> liveSlots;
+    {
+        std::shared_lock mappingLock(log->mappingMutex);
+        for (const auto& [location, logicalID]: log->owners) {
+            liveSlots[getIndexFromID(location)] += LogStructure::getSlots(location);
+        }
+    }
+    // (live ratio, segment)
+    std::vector<std::pair<double, std::size_t>> victims;
+    {
+        // lock the segment manager
+        std::unique_lock mainLock(mutex);
+        for (const auto& [segmentIndex, live]: liveSlots) {
+            if (headSegments.contains(segmentIndex) || isDraining(segmentIndex)) {
+                continue;
+            }
+            auto& segmentContainer = *segments[segmentIndex];
+            std::shared_lock segmentLock(segmentContainer.mutex);
+            const std::size_t capacity = segmentContainer.segment->allocatedBlocks() * LogStructure::SLOTS;
+            const double ratio = static_cast<double>(live) / static_cast<double>(capacity);
+            if (live < capacity && ratio <= maxLiveRatio) {
+                victims.emplace_back(ratio, segmentIndex);
+            }
+        }
+        // the emptiest segments first (least to move per freed block)
+        std::sort(victims.begin(), victims.end());
+        for (const auto& [ratio, segmentIndex]: victims) {
+            log->cleaning.insert(segmentIndex);
+        }
+    }
+    std::size_t result = 0;
+    for (const auto& [ratio, segmentIndex]: victims) {
+        result += cleanSegment(segmentIndex);
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::size_t SegmentManager<B>::cleanSegment(std::size_t segmentIndex) {
+    struct alignas(io::IOBackend::DIRECT_IO_ALIGNMENT) Frame {
+        std::array<unsigned char, B> data;
+    };
+    static constexpr std::size_t BATCH = 64;
+    // (location, logical id) of the blocks to move
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> blocks;
+    {
+        std::shared_lock mappingLock(log->mappingMutex);
+        auto it = log->owners.lower_bound(std::uint64_t(segmentIndex) << 48);
+        for (; it != log->owners.end() && getIndexFromID(it->first) == segmentIndex; ++it) {
+            blocks.emplace_back(it->first, it->second);
+        }
+    }
+    std::size_t result = 0;
+    auto frames = std::make_unique<Frame[]>(BATCH);
+    for (std::size_t begin = 0; begin < blocks.size(); begin += BATCH) {
+        const std::size_t end = std::min(begin + BATCH, blocks.size());
+        std::vector<std::uint64_t> logicalIDs;
+        std::vector<std::uint64_t> oldLocations;
+        std::vector<std::size_t> slots;
+        std::vector<std::span<const unsigned char>> data;
+        for (std::size_t i = begin; i < end; i++) {
+            const auto [location, logicalID] = blocks[i];
+            auto& frame = frames[i - begin].data;
+            // the segment is not reused before the cleaning is done
+            // note: the stored slots are moved as they are (no recompression)
+            readSlots(location, frame);// IO read
+            logicalIDs.push_back(logicalID);
+            oldLocations.push_back(location);
+            slots.push_back(LogStructure::getSlots(location));
+            data.push_back(std::span(frame).first(slots.back() * SLOT_SIZE));
+        }
+        std::vector<std::uint64_t> newLocations;
+        appendSlots(slots, newLocations);
+        writeLocations(newLocations, data);
+        const auto replaced = remapBlocks(logicalIDs, newLocations, &oldLocations);
+        releaseLocations(replaced);
+        result += replaced.size();
+    }
+    {
+        // lock the segment manager
+        std::unique_lock mainLock(mutex);
+        log->cleaning.erase(segmentIndex);
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::cleanInBackground() {
+    std::unique_lock lock(log->cleanerThreadMutex);
+    while (!log->cleanerCondition.wait_for(lock, log->cleanerInterval, [this]() { return log->stopCleaner; })) {
+        lock.unlock();
+        clean(log->cleanerThreshold);
+        lock.lock();
     }
 }
 // --------------------------------------------------------------------------
 template<std::size_t B>
 std::size_t SegmentManager<B>::allocatedBlocks() const {
     std::size_t result = 0;
-    for (const auto& segmentContainerPtr: segments) {
-        assert(segmentContainerPtr->segment);
-        result += segmentContainerPtr->segment->allocatedBlocks();
+    for (std::size_t segmentIndex = 0; segmentIndex < segments.size(); segmentIndex++) {
+        assert(segments[segmentIndex]->segment);
+        result += segments[segmentIndex]->segment->allocatedBlocks();
     }
     return result;
 }
 // --------------------------------------------------------------------------
 template<std::size_t B>
+void SegmentManager<B>::setUserHeader(std::span<const unsigned char> data) {
+    userHeader.assign(data.begin(), data.end());
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::span<const unsigned char> SegmentManager<B>::getUserHeader() const {
+    return userHeader;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+io::IOStatisticsSnapshot SegmentManager<B>::getStatistics() const {
+    return statistics.snapshot();
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
 void SegmentManager<B>::flush() {
-    for (auto& segmentContainerPtr: segments) {
-        assert(segmentContainerPtr->segment);
-        segmentContainerPtr->segment->flush();
+    // the reserved but unused blocks are free on disk
+    drainAllocationCaches();
+    // the cleaner must not move blocks between the segment flush and the
+    // mapping write (the bitmaps would not match the mapping)
+    // note: the head is kept, its unused blocks are freed on reopen
+    std::unique_lock<std::mutex> cleanerLock;
+    if (log) {
+        cleanerLock = std::unique_lock(log->cleanerMutex);
+    }
+    // finish the compaction: the persisted segments must not contain the
+    // removed ones, the released space must not be referenced anymore
+    const auto truncations = removeCompactedSegments();
+    // the blocks released so far are not referenced by the written mapping
+    std::vector<std::uint64_t> released;
+    if (log) {
+        std::unique_lock referenceLock(log->referenceMutex);
+        released.swap(log->released);
+    }
+    writeMetadata(false);
+    releaseCompactedSegments(truncations);
+    // waits for the readers of the blocks (segment lock), persisted by the
+    // next flush (or freed on reopen)
+    for (std::uint64_t physicalID: released) {
+        releaseBlock(physicalID);
+    }
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::writeMetadata(bool checkpoint) {
+    // the mapping is taken first -> the blocks it references are written
+    // and synced below, their segments are part of the directory
+    std::vector<std::uint64_t> persistedMapping;
+    const auto& persistedUserHeader = checkpoint ? log->checkpointUserHeader : userHeader;
+    if (log) {
+        if (checkpoint) {
+            persistedMapping = log->checkpointMapping;
+        } else {
+            std::shared_lock mappingLock(log->mappingMutex);
+            persistedMapping = log->mapping;
+            // the written mapping may reference the blocks started so far
+            std::unique_lock referenceLock(log->referenceMutex);
+            log->unpersisted.clear();
+        }
+    }
+    // the segments may grow meanwhile (the header has to match the directory)
+    Header persistedHeader;
+    std::size_t numberOfSegments;
+    {
+        std::shared_lock mainLock(mutex);
+        persistedHeader = header;
+        numberOfSegments = segments.size();
+    }
+    // the current directory does not match the segment headers once they
+    // are written (a crash meanwhile -> they are read on reopen)
+    persistedHeader.generation = 0;
+    backends.front()->write(&persistedHeader, sizeof(Header), 0);
+    if (!backends.front()->sync()) {
+        util::raise("Could not sync the segment file.");
+    }
+    std::vector<typename Segment<B>::DirectoryEntry> directory;
+    directory.reserve(numberOfSegments);
+    for (std::size_t segmentIndex = 0; segmentIndex < numberOfSegments; segmentIndex++) {
+        auto& segmentContainer = *segments.at(segmentIndex);
+        std::unique_lock segmentLock(segmentContainer.mutex);
+        assert(segmentContainer.segment);
+        // only writes the segments which changed
+        segmentContainer.segment->flush();
+        directory.push_back(segmentContainer.segment->getDirectoryEntry());
+    }
+    for (auto& backend: backends) {
+        if (!backend->sync()) {
+            util::raise("Could not sync the segment files.");
+        }
+    }
+    // header | directory | mapping | user header
+    std::vector<unsigned char> metadata(sizeof(MetadataHeader));
+    const auto* entries = reinterpret_cast<const unsigned char*>(directory.data());
+    metadata.insert(metadata.end(), entries, entries + directory.size() * sizeof(typename Segment<B>::DirectoryEntry));
+    const auto* locations = reinterpret_cast<const unsigned char*>(persistedMapping.data());
+    metadata.insert(metadata.end(), locations, locations + persistedMapping.size() * sizeof(std::uint64_t));
+    metadata.insert(metadata.end(), persistedUserHeader.begin(), persistedUserHeader.end());
+    const MetadataHeader metadataHeader{B,
+                                        generation + 1,
+                                        directory.size(),
+                                        persistedMapping.size(),
+                                        persistedUserHeader.size(),
+                                        checksum(std::span(metadata).subspan(sizeof(MetadataHeader)))};
+    std::memcpy(metadata.data(), &metadataHeader, sizeof(MetadataHeader));
+    // commit: the directory, the mapping and the user header are replaced
+    // at once (the blocks they reference are durable)
+    replaceFile(metadataFile, metadata);
+    persistedHeader.generation = ++generation;
+    // not synced: if it is lost, the segment headers are read on reopen
+    backends.front()->write(&persistedHeader, sizeof(Header), 0);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::beginCheckpoint() {
+    assert(log && !log->checkpointing);
+    std::shared_lock mappingLock(log->mappingMutex);
+    log->checkpointMapping = log->mapping;
+    // the user state of the same moment (see setUserHeader)
+    log->checkpointUserHeader = userHeader;
+    // freed once the snapshot is persisted, the later ones may be
+    // referenced by it
+    std::unique_lock referenceLock(log->referenceMutex);
+    assert(log->checkpointReleased.empty());
+    log->checkpointReleased.swap(log->released);
+    // the snapshot may reference the blocks started so far
+    log->unpersisted.clear();
+    log->checkpointing = true;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+std::vector<bool> SegmentManager<B>::writeCheckpoint(std::vector<BlockWrite> writes) {
+    assert(log && log->checkpointing);
+    std::vector<bool> result(writes.size());
+    if (writes.empty()) {
+        return result;
+    }
+    const auto locations = appendBlocks(writes, false);
+    std::vector<std::uint64_t> replaced;
+    {
+        std::unique_lock mappingLock(log->mappingMutex);
+        for (std::size_t i = 0; i < writes.size(); i++) {
+            const std::uint64_t logicalID = writes[i].first;
+            assert(logicalID < log->checkpointMapping.size());
+            auto& persisted = log->checkpointMapping[logicalID];
+            auto& entry = log->mapping[logicalID];
+            if (entry == persisted && entry != LogStructure::FREE) {
+                // not written since the snapshot -> the copy is current
+                if (entry != LogStructure::UNWRITTEN) {
+                    log->owners.erase(entry);
+                    replaced.push_back(entry);
+                }
+                entry = locations[i];
+                log->owners.emplace(locations[i], logicalID);
+                result[i] = true;
+            } else {
+                // released after the next checkpoint (see endCheckpoint)
+                log->checkpointLocations.push_back(locations[i]);
+            }
+            persisted = locations[i];
+        }
+    }
+    // the snapshot referenced them, kept until the next checkpoint
+    releaseLocations(replaced);
+    return result;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::endCheckpoint() {
+    assert(log && log->checkpointing);
+    {
+        // see flush, the blocks of the snapshot are synced before the commit
+        std::unique_lock cleanerLock(log->cleanerMutex);
+        writeMetadata(true);
+    }
+    // the persisted mapping does not reference them
+    std::vector<std::uint64_t> released;
+    {
+        std::unique_lock referenceLock(log->referenceMutex);
+        released.swap(log->checkpointReleased);
+    }
+    for (std::uint64_t physicalID: released) {
+        releaseBlock(physicalID);
+    }
+    // only referenced by the persisted mapping -> freed by the next one
+    releaseLocations(log->checkpointLocations);
+    log->checkpointLocations.clear();
+    log->checkpointMapping.clear();
+    log->checkpointUserHeader.clear();
+    log->checkpointing = false;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::commitCheckpoint() {
+    assert(!log);
+    // unlike flush: no segment is removed, no allocation cache drained
+    writeMetadata(false);
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+bool SegmentManager<B>::isLogStructured() const {
+    return log != nullptr;
+}
+// --------------------------------------------------------------------------
+template<std::size_t B>
+void SegmentManager<B>::sync() {
+    bool success = true;
+    for (auto& backend: backends) {
+        success = backend->sync() && success;
     }
-    if (pwrite(fd, &header, sizeof(Header), 0) != sizeof(Header)) {
-        throw std::runtime_error("Could not save the header (segment file).");
+    if (!success) {
+        util::raise("Could not sync the segment files.");
     }
 }
 // --------------------------------------------------------------------------
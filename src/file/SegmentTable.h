@@ -0,0 +1,132 @@
+#ifndef B_EPSILON_SEGMENTTABLE_H
+#define B_EPSILON_SEGMENTTABLE_H
+// --------------------------------------------------------------------------
+#include "src/util/ErrorHandler.h"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <utility>
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+template<class T>
+class SegmentTable {
+    // append-only array of segments, readers do not lock (no atomic
+    // read-modify-write): the entries never move, a new entry is published
+    // by a release store of the size
+    // - push_back: writers are serialized by the caller
+    // - pop_back: no concurrent readers (the entry is destroyed)
+
+    // chunk k holds FIRST_CHUNK << k entries, the chunks cover the 2^16
+    // segment indices of the block ids
+    static constexpr std::size_t FIRST_CHUNK = 64;
+    static constexpr std::size_t CHUNKS = 11;
+
+private:
+    std::array<std::atomic<std::unique_ptr<T>*>, CHUNKS> chunks = {};
+    std::atomic_size_t count = 0;
+
+public:
+    SegmentTable() = default;
+    SegmentTable(const SegmentTable<T>&) = delete;
+    ~SegmentTable();
+
+private:
+    // (chunk, index in the chunk)
+    static std::pair<std::size_t, std::size_t> locate(std::size_t);
+    std::unique_ptr<T>& entry(std::size_t) const;
+
+public:
+    std::size_t size() const;
+    bool empty() const;
+    const std::unique_ptr<T>& operator[](std::size_t) const;
+    // raises if the entry is not published
+    const std::unique_ptr<T>& at(std::size_t) const;
+    const std::unique_ptr<T>& back() const;
+    void push_back(std::unique_ptr<T>);
+    void pop_back();
+
+    SegmentTable<T>& operator=(const SegmentTable<T>&) = delete;
+};
+// --------------------------------------------------------------------------
+template<class T>
+SegmentTable<T>::~SegmentTable() {
+    for (auto& chunk: chunks) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+// --------------------------------------------------------------------------
+template<class T>
+std::pair<std::size_t, std::size_t> SegmentTable<T>::locate(std::size_t index) {
+    // chunk k starts at FIRST_CHUNK * (2^k - 1)
+    const std::size_t chunk = std::bit_width(index / FIRST_CHUNK + 1) - 1;
+    return {chunk, index - FIRST_CHUNK * ((std::size_t(1) << chunk) - 1)};
+}
+// --------------------------------------------------------------------------
+template<class T>
+std::unique_ptr<T>& SegmentTable<T>::entry(std::size_t index) const {
+    const auto [chunk, offset] = locate(index);
+    assert(chunk < CHUNKS);
+    return chunks[chunk].load(std::memory_order_acquire)[offset];
+}
+// --------------------------------------------------------------------------
+template<class T>
+std::size_t SegmentTable<T>::size() const {
+    return count.load(std::memory_order_acquire);
+}
+// --------------------------------------------------------------------------
+template<class T>
+bool SegmentTable<T>::empty() const {
+    return size() == 0;
+}
+// --------------------------------------------------------------------------
+template<class T>
+const std::unique_ptr<T>& SegmentTable<T>::operator[](std::size_t index) const {
+    assert(index < size());
+    return entry(index);
+}
+// --------------------------------------------------------------------------
+template<class T>
+const std::unique_ptr<T>& SegmentTable<T>::at(std::size_t index) const {
+    if (index >= size()) {
+        util::raise("Invalid segment index!");
+    }
+    return entry(index);
+}
+// --------------------------------------------------------------------------
+template<class T>
+const std::unique_ptr<T>& SegmentTable<T>::back() const {
+    assert(!empty());
+    return entry(size() - 1);
+}
+// --------------------------------------------------------------------------
+template<class T>
+void SegmentTable<T>::push_back(std::unique_ptr<T> value) {
+    const std::size_t index = count.load(std::memory_order_relaxed);
+    const auto [chunk, offset] = locate(index);
+    if (chunk >= CHUNKS) {
+        util::raise("Too many segments!");
+    }
+    if (offset == 0 && chunks[chunk].load(std::memory_order_relaxed) == nullptr) {
+        chunks[chunk].store(new std::unique_ptr<T>[FIRST_CHUNK << chunk], std::memory_order_release);
+    }
+    entry(index) = std::move(value);
+    // publish the entry
+    count.store(index + 1, std::memory_order_release);
+}
+// --------------------------------------------------------------------------
+template<class T>
+void SegmentTable<T>::pop_back() {
+    assert(!empty());
+    const std::size_t index = count.load(std::memory_order_relaxed) - 1;
+    count.store(index, std::memory_order_release);
+    entry(index).reset();
+}
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_SEGMENTTABLE_H
@@ -0,0 +1,106 @@
+#ifndef B_EPSILON_STORAGEOPTIONS_H
+#define B_EPSILON_STORAGEOPTIONS_H
+// --------------------------------------------------------------------------
+#include "io/IOBackend.h"
+#include <chrono>
+#include <string>
+#include <vector>
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+// how the buffer selects the pages it evicts
+enum class ReplacementPolicy {
+    // FIFO queue for the pages pinned once, LRU queue for the others
+    TWO_QUEUE,
+    // second chance over the frames (reference bit per frame)
+    CLOCK
+};
+// --------------------------------------------------------------------------
+struct StorageOptions {
+    // how the blocks are transferred from/to the segment file
+    io::IOBackendOptions io;
+    // bypass the kernel page cache (O_DIRECT)
+    // note: requires a block size which is a multiple of 4 KiB
+    bool directIO = false;
+    // additional directories (e.g. on other devices) to stripe the
+    // segments across: segment i is stored in file i % (1 + amount)
+    // note: the same directories have to be passed when reopening
+    std::vector<std::string> stripeDirectories;
+    // allocate the extents of new segments with fallocate, so the first
+    // write to a block does not pay for the allocation (falls back to a
+    // sparse file if the file system does not support it)
+    bool preallocate = true;
+    // the files grow in multiples of this size (0: exactly per segment)
+    std::size_t preallocationChunk = 1 << 20;
+    // preallocate the next segment on a background thread
+    bool backgroundPreallocation = false;
+    // amount of block ids a thread reserves at once (0 disables the
+    // thread-local allocation caches)
+    // note: unused ids are returned at thread exit and on flush
+    std::size_t allocationBatch = 32;
+    // log-structured mode: every write appends the block to the head of
+    // the log (sequential writes), the block ids are logical and mapped to
+    // the current location of the block
+    // note: the same mode has to be used when reopening, the space of the
+    // overwritten blocks is reused after the next flush
+    bool logStructured = false;
+    // log-structured mode: the cleaner moves the live blocks out of the
+    // segments with at most this ratio of live blocks
+    double cleanerThreshold = 0.5;
+    // log-structured mode: how often the background cleaner runs (0: only
+    // on SegmentManager::clean/beginCompaction)
+    std::chrono::milliseconds cleanerInterval{0};
+    // log-structured mode: compress the blocks, a block occupies as many
+    // 1/16 block slots as it needs (several blocks share a physical block)
+    // note: not with O_DIRECT (the slots are not sector aligned)
+    bool compression = false;
+    // every insert/update/erase of the trees is logged (<path>/wal) and
+    // durable once it returns, the log is replayed on open and dropped by
+    // the flush (checkpoint)
+    // note: requires the log-structured mode (the blocks written between
+    // two flushes must not overwrite the checkpoint)
+    bool writeAheadLog = false;
+    // write-ahead log: how long a committer waits for others to share its
+    // fdatasync (group commit, 0: only the ones arriving during a sync)
+    std::chrono::microseconds groupCommitDelay{0};
+    // the trees swizzle the child references of the nodes in the buffer:
+    // a resident child is pinned through its frame (no page table lookup)
+    // note: the references are validated on every pin, no unswizzling on
+    // eviction (see PageBuffer::pinSwizzled)
+    bool swizzling = true;
+    // replacement policy of the buffer
+    // note: CLOCK does not need the exclusive page table latch for the
+    // pins of resident pages (it just sets their reference bit)
+    ReplacementPolicy replacementPolicy = ReplacementPolicy::TWO_QUEUE;
+    // background threads of the buffer which write the dirty, unpinned
+    // pages at the cold end of the replacement queues (in front of the
+    // clock hand), so that an eviction rarely has to write its victim (0
+    // disables the page cleaners)
+    // note: at most one thread per partition of the page table
+    std::size_t pageCleanerThreads = 0;
+    // page cleaners: how many pages at the end of each queue are kept clean
+    std::size_t pageCleanerWindow = 64;
+    // page cleaners: how often they run (an eviction which had to write a
+    // dirty page wakes them up earlier)
+    std::chrono::milliseconds pageCleanerInterval{1};
+    // free frame reserve: once less than the low watermark of the frames
+    // are free, the page cleaners evict clean pages up to the high
+    // watermark -> a miss takes a free frame and only waits for its read
+    // (0: the misses evict their victims themselves)
+    // note: requires the page cleaners (raises otherwise), the watermarks
+    // are split among the partitions of the page table
+    std::size_t evictorLowWatermark = 0;
+    std::size_t evictorHighWatermark = 0;
+    // background compaction: how often the buffer relocates the pages in
+    // sparse segments at the end of the file through the hook of the trees
+    // (0: only on compact), the next flush shrinks the file
+    // note: skipped until the last compaction is flushed
+    std::chrono::milliseconds compactionInterval{0};
+    // background compaction: the segments with at most this ratio of live
+    // blocks are compacted (see SegmentManager::beginCompaction)
+    double compactionFillRatio = 0.5;
+};
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_STORAGEOPTIONS_H
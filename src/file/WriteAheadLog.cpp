@@ -0,0 +1,174 @@
+#include "WriteAheadLog.h"
+#include "src/util/ErrorHandler.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+WriteAheadLog::WriteAheadLog(const std::string& path, const io::IOBackendOptions& options,
+                             std::chrono::microseconds groupCommitDelay)
+    : groupCommitDelay(groupCommitDelay) {
+    int fd = -1;
+    if (options.type != io::IOBackendType::MEMORY) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            util::raise("Could not open the write-ahead log!");
+        }
+    }
+    backend = io::createBackend(fd, options);
+    backend->setStatistics(&statistics);
+    if (backend->size() < HEADER_SIZE) {
+        setBegin(HEADER_SIZE);
+    }
+    bufferOffset = backend->size();
+    durableLSN = bufferOffset;
+}
+// --------------------------------------------------------------------------
+void WriteAheadLog::setBegin(std::uint64_t begin) {
+    backend->write(&begin, sizeof(begin), 0);// IO write
+}
+// --------------------------------------------------------------------------
+std::uint64_t WriteAheadLog::append(std::span<const unsigned char> record) {
+    const RecordHeader header{static_cast<std::uint32_t>(record.size()), checksum(record)};
+    std::unique_lock lock(mutex);
+    const auto* headerBytes = reinterpret_cast<const unsigned char*>(&header);
+    buffer.insert(buffer.end(), headerBytes, headerBytes + sizeof(RecordHeader));
+    buffer.insert(buffer.end(), record.begin(), record.end());
+    return bufferOffset + buffer.size();
+}
+// --------------------------------------------------------------------------
+void WriteAheadLog::commit(std::uint64_t lsn) {
+    std::unique_lock lock(mutex);
+    while (durableLSN < lsn) {
+        if (syncing) {
+            // the leader syncs our record (or the next one will)
+            durableCondition.wait(lock);
+            continue;
+        }
+        // become the leader
+        syncing = true;
+        if (groupCommitDelay.count() > 0) {
+            // give the other committers the chance to join the batch
+            lock.unlock();
+            std::this_thread::sleep_for(groupCommitDelay);
+            lock.lock();
+        }
+        std::vector<unsigned char> records;
+        records.swap(buffer);
+        const std::uint64_t offset = bufferOffset;
+        bufferOffset += records.size();
+        lock.unlock();
+        try {
+            backend->write(records.data(), records.size(), offset);// IO write
+            if (!backend->sync()) {
+                util::raise("Could not sync the write-ahead log.");
+            }
+        } catch (...) {
+            lock.lock();
+            // put the records back in front of the ones appended meanwhile
+            // (their offsets stay valid), the next leader writes them again
+            records.insert(records.end(), buffer.begin(), buffer.end());
+            buffer.swap(records);
+            bufferOffset = offset;
+            syncing = false;
+            durableCondition.notify_all();
+            throw;
+        }
+        lock.lock();
+        // a checkpoint may have made later records durable meanwhile
+        durableLSN = std::max(durableLSN, offset + records.size());
+        syncing = false;
+        durableCondition.notify_all();
+    }
+}
+// --------------------------------------------------------------------------
+void WriteAheadLog::replay(const std::function<void(std::span<const unsigned char>)>& function,
+                           std::uint64_t lsn) {
+    std::unique_lock lock(mutex);
+    assert(buffer.empty());
+    std::uint64_t begin;
+    backend->read(&begin, sizeof(begin), 0);// IO read
+    if (begin < HEADER_SIZE) {
+        util::raise("Invalid write-ahead log!");
+    }
+    // crash after the checkpoint was persisted, but before the log was cut
+    begin = std::max(begin, lsn);
+    if (begin > bufferOffset) {
+        // the checkpoint contains records which were never written
+        bufferOffset = begin;
+        durableLSN = begin;
+    }
+    std::vector<unsigned char> data(bufferOffset - begin);
+    if (!data.empty()) {
+        backend->read(data.data(), data.size(), begin);// IO read
+    }
+    std::size_t offset = 0;
+    while (data.size() - offset >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        std::memcpy(&header, data.data() + offset, sizeof(RecordHeader));
+        if (data.size() - offset - sizeof(RecordHeader) < header.size) {
+            break;
+        }
+        const std::span<const unsigned char> record(data.data() + offset + sizeof(RecordHeader), header.size);
+        if (checksum(record) != header.checksum) {
+            break;
+        }
+        function(record);
+        offset += sizeof(RecordHeader) + header.size;
+    }
+    if (offset < data.size()) {
+        // the new records must follow the last complete one
+        if (!backend->resize(begin + offset)) {
+            util::raise("Could not cut off the torn write-ahead log record.");
+        }
+        bufferOffset = begin + offset;
+        durableLSN = bufferOffset;
+    }
+}
+// --------------------------------------------------------------------------
+std::uint64_t WriteAheadLog::lastLSN() {
+    std::unique_lock lock(mutex);
+    return bufferOffset + buffer.size();
+}
+// --------------------------------------------------------------------------
+void WriteAheadLog::truncate() {
+    std::unique_lock lock(mutex);
+    assert(!syncing);
+    buffer.clear();
+    if (!backend->resize(HEADER_SIZE)) {
+        util::raise("Could not truncate the write-ahead log.");
+    }
+    setBegin(HEADER_SIZE);
+    if (!backend->sync()) {
+        util::raise("Could not truncate the write-ahead log.");
+    }
+    bufferOffset = HEADER_SIZE;
+    durableLSN = HEADER_SIZE;
+}
+// --------------------------------------------------------------------------
+void WriteAheadLog::truncate(std::uint64_t lsn) {
+    {
+        std::unique_lock lock(mutex);
+        assert(lsn <= bufferOffset + buffer.size());
+        // the leader writes behind the header (no conflict)
+        durableLSN = std::max(durableLSN, lsn);
+    }
+    durableCondition.notify_all();
+    setBegin(lsn);
+    if (!backend->sync()) {
+        util::raise("Could not truncate the write-ahead log.");
+    }
+    // only releases the space (fails without file system support)
+    backend->punchHole(lsn - HEADER_SIZE, HEADER_SIZE);
+}
+// --------------------------------------------------------------------------
+io::IOStatisticsSnapshot WriteAheadLog::getStatistics() const {
+    return statistics.snapshot();
+}
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+#ifndef B_EPSILON_WRITEAHEADLOG_H
+#define B_EPSILON_WRITEAHEADLOG_H
+// --------------------------------------------------------------------------
+#include "Checksum.h"
+#include "io/IOBackend.h"
+#include "io/IOStatistics.h"
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+// --------------------------------------------------------------------------
+namespace file {
+// --------------------------------------------------------------------------
+class WriteAheadLog {
+    // append-only log of records: [size (4 B) | checksum (4 B) | payload]
+    // - append buffers the record and returns its log sequence number (the
+    //   end offset of the record in the file)
+    // - group commit: the first committer (leader) writes and syncs the
+    //   records of all committers, the others wait until it is done
+    // - the records are dropped once a checkpoint made them redundant, the
+    //   file starts with the offset of the first record which is not
+
+    struct RecordHeader {
+        std::uint32_t size;
+        std::uint32_t checksum;
+    };
+
+private:
+    io::IOStatistics statistics;// outlives the backend
+    std::unique_ptr<io::IOBackend> backend;
+    // the leader waits that long for more committers before it syncs
+    const std::chrono::microseconds groupCommitDelay;
+    std::mutex mutex;
+    std::condition_variable durableCondition;
+    std::vector<unsigned char> buffer;// appended, but not yet written
+    std::uint64_t bufferOffset = 0;   // file offset of the buffer
+    std::uint64_t durableLSN = 0;
+    bool syncing = false;// a leader is writing
+
+    static constexpr std::uint64_t HEADER_SIZE = sizeof(std::uint64_t);
+    // sets the offset of the first record
+    void setBegin(std::uint64_t);
+
+public:
+    // opens (or creates) the log, nothing is persisted with MEMORY
+    WriteAheadLog(const std::string&, const io::IOBackendOptions&, std::chrono::microseconds = {});
+    WriteAheadLog(const WriteAheadLog&) = delete;
+
+    std::uint64_t append(std::span<const unsigned char>);
+    // returns once the record with the given log sequence number is durable
+    // note: raises if the write or sync of the leader fails, the records
+    // stay buffered and the waiting committers try again
+    void commit(std::uint64_t);
+    // calls the function for every complete record in order, the records
+    // up to the log sequence number are skipped (already in the checkpoint)
+    // note: a torn record at the end (crash during the write) is cut off
+    void replay(const std::function<void(std::span<const unsigned char>)>&, std::uint64_t = 0);
+    // the log sequence number of the last appended record
+    std::uint64_t lastLSN();
+    // drops all records (after a checkpoint)
+    // note: not thread-safe
+    void truncate();
+    // drops the records up to the log sequence number (after a checkpoint
+    // which contains them), their commits return immediately
+    // note: the space is released by punching a hole into the file
+    void truncate(std::uint64_t);
+    // statistics of the log file (writes, syncs)
+    io::IOStatisticsSnapshot getStatistics() const;
+
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+};
+// --------------------------------------------------------------------------
+}// namespace file
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_WRITEAHEADLOG_H
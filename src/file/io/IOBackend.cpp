@@ -0,0 +1,265 @@
+#include "IOBackend.h"
+#include "IOUringBackend.h"
+#include "MemoryBackend.h"
+#include "PosixBackend.h"
+#include "ThrottledBackend.h"
+#include "src/util/ErrorHandler.h"
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+namespace {
+// --------------------------------------------------------------------------
+struct AlignedDeleter {
+    void operator()(unsigned char* pointer) const {
+        std::free(pointer);
+    }
+};
+// --------------------------------------------------------------------------
+using AlignedBuffer = std::unique_ptr<unsigned char[], AlignedDeleter>;
+// --------------------------------------------------------------------------
+AlignedBuffer allocateAligned(std::size_t size) {
+    auto* pointer = static_cast<unsigned char*>(
+            std::aligned_alloc(IOBackend::DIRECT_IO_ALIGNMENT, size));
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return AlignedBuffer(pointer);
+}
+// --------------------------------------------------------------------------
+}// namespace
+// --------------------------------------------------------------------------
+IOBackend::IOBackend(int fd) {
+    setFD(fd);
+}
+// --------------------------------------------------------------------------
+IOBackend::~IOBackend() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+// --------------------------------------------------------------------------
+void IOBackend::setFD(int newFD) {
+    fd = newFD;
+    direct = fd >= 0 && (fcntl(fd, F_GETFL) & O_DIRECT) != 0;
+}
+// --------------------------------------------------------------------------
+int IOBackend::getFD() const {
+    return fd;
+}
+// --------------------------------------------------------------------------
+bool IOBackend::isDirect() const {
+    return direct;
+}
+// --------------------------------------------------------------------------
+void IOBackend::setStatistics(IOStatistics* newStatistics) {
+    statistics = newStatistics;
+}
+// --------------------------------------------------------------------------
+void IOBackend::submit(std::span<IORequest> requests) {
+    if (statistics == nullptr) {
+        submitRequests(requests);
+        return;
+    }
+    const auto begin = IOStatistics::Clock::now();
+    submitRequests(requests);// IO
+    const auto latency = IOStatistics::Clock::now() - begin;
+    std::size_t reads = 0;
+    std::size_t readBytes = 0;
+    std::size_t writeBytes = 0;
+    for (const auto& request: requests) {
+        if (request.operation == IOOperation::READ) {
+            reads++;
+            readBytes += request.size;
+        } else {
+            writeBytes += request.size;
+        }
+    }
+    // the batch completes as a whole (its slowest request) -> a mixed one
+    // is neither a read nor a write latency
+    if (reads == requests.size()) {
+        if (reads > 0) {
+            statistics->recordReads(reads, readBytes, latency);
+        }
+    } else if (reads == 0) {
+        statistics->recordWrites(requests.size(), writeBytes, latency);
+    } else {
+        statistics->recordMixed(reads, readBytes, requests.size() - reads, writeBytes, latency);
+    }
+}
+// --------------------------------------------------------------------------
+void IOBackend::advance(IORequest& request, std::size_t transferred, std::vector<iovec>& buffers) {
+    assert(transferred < request.size);
+    request.offset += transferred;
+    request.size -= transferred;
+    if (request.buffers.empty()) {
+        request.data = static_cast<unsigned char*>(request.data) + transferred;
+        return;
+    }
+    // the request may point to the vector already
+    std::vector<iovec> remaining;
+    for (const iovec& buffer: request.buffers) {
+        if (transferred >= buffer.iov_len) {
+            transferred -= buffer.iov_len;
+            continue;
+        }
+        remaining.push_back({static_cast<unsigned char*>(buffer.iov_base) + transferred,
+                             buffer.iov_len - transferred});
+        transferred = 0;
+    }
+    buffers = std::move(remaining);
+    request.buffers = buffers;
+}
+// --------------------------------------------------------------------------
+std::size_t IOBackend::alignedSize(std::size_t size) const {
+    if (!direct) {
+        return size;
+    }
+    return (size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+}
+// --------------------------------------------------------------------------
+bool IOBackend::isAligned(const void* data, std::size_t size, std::size_t offset) const {
+    return !direct ||
+           (reinterpret_cast<std::uintptr_t>(data) % DIRECT_IO_ALIGNMENT == 0 &&
+            size % DIRECT_IO_ALIGNMENT == 0 &&
+            offset % DIRECT_IO_ALIGNMENT == 0);
+}
+// --------------------------------------------------------------------------
+bool IOBackend::isAligned(const IORequest& request) const {
+    if (request.buffers.empty()) {
+        return isAligned(request.data, request.size, request.offset);
+    }
+    if (!isAligned(nullptr, 0, request.offset)) {
+        return false;
+    }
+    for (const iovec& buffer: request.buffers) {
+        if (!isAligned(buffer.iov_base, buffer.iov_len, 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+// --------------------------------------------------------------------------
+void IOBackend::read(void* data, std::size_t size, std::size_t offset) {
+    if (isAligned(data, size, offset)) {
+        IORequest request{IOOperation::READ, data, size, offset};
+        submit({&request, 1});
+        return;
+    }
+    // read the surrounding aligned region into a bounce buffer
+    const std::size_t begin = offset / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    const std::size_t end = alignedSize(offset + size);
+    AlignedBuffer buffer = allocateAligned(end - begin);
+    IORequest request{IOOperation::READ, buffer.get(), end - begin, begin};
+    submit({&request, 1});
+    std::memcpy(data, buffer.get() + (offset - begin), size);
+}
+// --------------------------------------------------------------------------
+void IOBackend::write(const void* data, std::size_t size, std::size_t offset) {
+    if (isAligned(data, size, offset)) {
+        // the request is only read from -> the cast is safe
+        IORequest request{IOOperation::WRITE, const_cast<void*>(data), size, offset};
+        submit({&request, 1});
+        return;
+    }
+    // read-modify-write of the surrounding aligned region
+    const std::size_t begin = offset / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    const std::size_t end = alignedSize(offset + size);
+    AlignedBuffer buffer = allocateAligned(end - begin);
+    IORequest request{IOOperation::READ, buffer.get(), end - begin, begin};
+    submit({&request, 1});
+    std::memcpy(buffer.get() + (offset - begin), data, size);
+    request.operation = IOOperation::WRITE;
+    submit({&request, 1});
+}
+// --------------------------------------------------------------------------
+void IOBackend::willNeed(std::size_t size, std::size_t offset) const {
+    if (direct || size == 0) {
+        return;
+    }
+    // just a hint -> errors are ignored
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+}
+// --------------------------------------------------------------------------
+std::size_t IOBackend::size() const {
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0) {
+        util::raise("Invalid file!");
+    }
+    return fileStat.st_size;
+}
+// --------------------------------------------------------------------------
+bool IOBackend::resize(std::size_t newSize) {
+    return ftruncate(fd, static_cast<off_t>(newSize)) == 0;
+}
+// --------------------------------------------------------------------------
+bool IOBackend::allocate(std::size_t size, std::size_t offset) {
+    // mode 0 also extends the file size
+    if (fallocate(fd, 0, static_cast<off_t>(offset), static_cast<off_t>(size)) == 0) {
+        return true;
+    }
+    if (errno == EOPNOTSUPP || errno == ENOSYS) {
+        return false;
+    }
+    // e.g. out of space -> a sparse file would only fail later
+    util::raise(std::string("fallocate: ") + std::strerror(errno));
+    return false;
+}
+// --------------------------------------------------------------------------
+bool IOBackend::punchHole(std::size_t size, std::size_t offset) {
+    return fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                     static_cast<off_t>(offset), static_cast<off_t>(size)) == 0;
+}
+// --------------------------------------------------------------------------
+bool IOBackend::syncData() {
+    return fdatasync(fd) == 0;
+}
+// --------------------------------------------------------------------------
+bool IOBackend::sync() {
+    if (statistics == nullptr) {
+        return syncData();
+    }
+    const auto begin = IOStatistics::Clock::now();
+    const bool result = syncData();// IO
+    statistics->recordSyncs(1, IOStatistics::Clock::now() - begin);
+    return result;
+}
+// --------------------------------------------------------------------------
+bool ThrottleOptions::enabled() const {
+    return readLatency.count() > 0 || writeLatency.count() > 0 || bandwidth > 0;
+}
+// --------------------------------------------------------------------------
+std::unique_ptr<IOBackend> createBackend(int fd, const IOBackendOptions& options) {
+    std::unique_ptr<IOBackend> backend;
+    if (options.type == IOBackendType::MEMORY) {
+        backend = std::make_unique<MemoryBackend>();
+    } else if (options.type == IOBackendType::IO_URING) {
+        try {
+            backend = std::make_unique<IOUringBackend>(fd, options.queueDepth,
+                                                       options.pollIterations);
+        } catch (const std::runtime_error&) {
+            if (!options.fallback) {
+                throw;
+            }
+        }
+    }
+    if (!backend) {
+        backend = std::make_unique<PosixBackend>(fd);
+    }
+    if (options.throttle.enabled()) {
+        return std::make_unique<ThrottledBackend>(std::move(backend), options.throttle);
+    }
+    return backend;
+}
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
@@ -0,0 +1,133 @@
+#ifndef B_EPSILON_IOBACKEND_H
+#define B_EPSILON_IOBACKEND_H
+// --------------------------------------------------------------------------
+#include "IOStatistics.h"
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <sys/uio.h>
+#include <vector>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+enum class IOBackendType : unsigned char {
+    POSIX = 0,   // synchronous pread/pwrite
+    IO_URING = 1,// batched submissions + completion polling
+    MEMORY = 2,  // volatile byte array (no file, nothing is persisted)
+};
+// --------------------------------------------------------------------------
+enum class IOOperation : unsigned char {
+    READ = 0,
+    WRITE = 1,
+};
+// --------------------------------------------------------------------------
+struct IORequest {
+    IOOperation operation;
+    void* data;
+    std::size_t size;
+    std::size_t offset;
+    // vectored request: if not empty, <data> is ignored and <size> is the
+    // sum of all buffer lengths (at most MAX_VECTORS buffers)
+    std::span<const iovec> buffers = {};
+};
+// --------------------------------------------------------------------------
+class IOBackend {
+    // the backend owns the file descriptor and closes it on destruction
+    // note: backends without a file use -1 and override the file operations
+
+public:
+    // O_DIRECT requires aligned buffers, offsets and sizes
+    static constexpr std::size_t DIRECT_IO_ALIGNMENT = 4096;
+    // maximum amount of buffers in a vectored request (IOV_MAX)
+    static constexpr std::size_t MAX_VECTORS = 1024;
+
+protected:
+    int fd;
+    bool direct = false;// fd was opened with O_DIRECT
+    IOStatistics* statistics = nullptr;// records every submission (if set)
+
+public:
+    explicit IOBackend(int);
+    IOBackend(const IOBackend&) = delete;
+    virtual ~IOBackend();
+
+protected:
+    void setFD(int);
+    // performs the requests (see submit)
+    virtual void submitRequests(std::span<IORequest>) = 0;
+    // flushes the written data to the device (see sync)
+    virtual bool syncData();
+    // skips the transferred bytes of a short read or write, so that the
+    // remainder can be submitted (the remaining buffers of a vectored
+    // request are stored in the given vector)
+    static void advance(IORequest&, std::size_t, std::vector<iovec>&);
+
+public:
+    int getFD() const;
+    bool isDirect() const;
+    // note: the statistics have to outlive the backend
+    void setStatistics(IOStatistics*);
+    // the size a file region needs to be accessible with read/write
+    std::size_t alignedSize(std::size_t) const;
+    bool isAligned(const void*, std::size_t, std::size_t) const;
+    bool isAligned(const IORequest&) const;
+    // synchronous helpers (a batch with a single request)
+    // note: with O_DIRECT, unaligned accesses go through a bounce buffer
+    // (writes become read-modify-writes of the surrounding aligned region)
+    void read(void*, std::size_t, std::size_t);
+    void write(const void*, std::size_t, std::size_t);
+    // hints the kernel to read the file region (size, offset) ahead
+    // note: no-op with O_DIRECT (there is no page cache to fill)
+    virtual void willNeed(std::size_t, std::size_t) const;
+    // file operations (fstat, ftruncate, fallocate), false on failure
+    virtual std::size_t size() const;
+    virtual bool resize(std::size_t);
+    // allocates the region (size, offset), may extend the file
+    // note: false only if the file system does not support it, raises on
+    // other errors (e.g. no space left)
+    virtual bool allocate(std::size_t, std::size_t);
+    // releases the region (size, offset), it reads as zeros afterwards
+    virtual bool punchHole(std::size_t, std::size_t);
+    // submits all requests and returns once every one of them has completed
+    // note: raises if any request could not be fully performed
+    // note: with O_DIRECT, all requests must be aligned
+    // note: with statistics, a batch of reads and writes is timed as a
+    // mixed one (see IOStatisticsSnapshot::mixedLatency)
+    void submit(std::span<IORequest>);
+    // returns once the written data is durable (fdatasync), false on failure
+    bool sync();
+
+    IOBackend& operator=(const IOBackend&) = delete;
+};
+// --------------------------------------------------------------------------
+struct ThrottleOptions {
+    // emulated device, 0 = no limit (see ThrottledBackend)
+    std::chrono::nanoseconds readLatency{0}; // per submission
+    std::chrono::nanoseconds writeLatency{0};// per submission
+    std::size_t bandwidth = 0;               // bytes per second (all threads)
+
+    bool enabled() const;
+};
+// --------------------------------------------------------------------------
+struct IOBackendOptions {
+    IOBackendType type = IOBackendType::POSIX;
+    // io_uring: number of submission queue entries
+    unsigned queueDepth = 128;
+    // io_uring: how often the completion queue is polled before blocking
+    unsigned pollIterations = 64;
+    // io_uring: use POSIX if io_uring is not available (raises otherwise)
+    bool fallback = true;
+    // wraps the backend into a ThrottledBackend if enabled
+    ThrottleOptions throttle;
+};
+// --------------------------------------------------------------------------
+// creates the requested backend for <fd>
+// note: falls back to POSIX if io_uring is not available (see fallback)
+// note: MEMORY ignores <fd> (should be -1)
+std::unique_ptr<IOBackend> createBackend(int, const IOBackendOptions&);
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_IOBACKEND_H
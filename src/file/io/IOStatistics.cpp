@@ -0,0 +1,179 @@
+#include "IOStatistics.h"
+#include <algorithm>
+#include <bit>
+#include <ostream>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+namespace {
+// --------------------------------------------------------------------------
+void add(LatencyHistogram& target, const LatencyHistogram& source, bool subtract) {
+    for (std::size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        target[i] = subtract ? target[i] - source[i] : target[i] + source[i];
+    }
+}
+// --------------------------------------------------------------------------
+}// namespace
+// --------------------------------------------------------------------------
+std::uint64_t IOStatisticsSnapshot::percentile(const LatencyHistogram& histogram, double fraction) {
+    std::uint64_t total = 0;
+    for (std::uint64_t count: histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const auto target = static_cast<std::uint64_t>(fraction * static_cast<double>(total));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen > target || seen == total) {
+            return i == 0 ? 0 : std::uint64_t(1) << i;
+        }
+    }
+    return std::uint64_t(1) << (LATENCY_BUCKETS - 1);
+}
+// --------------------------------------------------------------------------
+double IOStatisticsSnapshot::compressionRatio() const {
+    if (compressedBytes == 0) {
+        return 1;
+    }
+    return static_cast<double>(uncompressedBytes) / static_cast<double>(compressedBytes);
+}
+// --------------------------------------------------------------------------
+IOStatisticsSnapshot IOStatisticsSnapshot::operator-(const IOStatisticsSnapshot& older) const {
+    IOStatisticsSnapshot result = *this;
+    result.reads -= older.reads;
+    result.readBytes -= older.readBytes;
+    result.writes -= older.writes;
+    result.writeBytes -= older.writeBytes;
+    result.allocations -= older.allocations;
+    result.deletes -= older.deletes;
+    result.uncompressedBytes -= older.uncompressedBytes;
+    result.compressedBytes -= older.compressedBytes;
+    result.syncs -= older.syncs;
+    add(result.readLatency, older.readLatency, true);
+    add(result.writeLatency, older.writeLatency, true);
+    add(result.mixedLatency, older.mixedLatency, true);
+    add(result.syncLatency, older.syncLatency, true);
+    return result;
+}
+// --------------------------------------------------------------------------
+IOStatisticsSnapshot& IOStatisticsSnapshot::operator+=(const IOStatisticsSnapshot& other) {
+    reads += other.reads;
+    readBytes += other.readBytes;
+    writes += other.writes;
+    writeBytes += other.writeBytes;
+    allocations += other.allocations;
+    deletes += other.deletes;
+    uncompressedBytes += other.uncompressedBytes;
+    compressedBytes += other.compressedBytes;
+    syncs += other.syncs;
+    add(readLatency, other.readLatency, false);
+    add(writeLatency, other.writeLatency, false);
+    add(mixedLatency, other.mixedLatency, false);
+    add(syncLatency, other.syncLatency, false);
+    return *this;
+}
+// --------------------------------------------------------------------------
+std::ostream& operator<<(std::ostream& out, const IOStatisticsSnapshot& snapshot) {
+    out << "reads: " << snapshot.reads << " (" << snapshot.readBytes << " B, p50 <= "
+        << IOStatisticsSnapshot::percentile(snapshot.readLatency, 0.5) << " ns, p99 <= "
+        << IOStatisticsSnapshot::percentile(snapshot.readLatency, 0.99) << " ns)"
+        << ", writes: " << snapshot.writes << " (" << snapshot.writeBytes << " B, p50 <= "
+        << IOStatisticsSnapshot::percentile(snapshot.writeLatency, 0.5) << " ns, p99 <= "
+        << IOStatisticsSnapshot::percentile(snapshot.writeLatency, 0.99) << " ns)"
+        << ", mixed batches: p99 <= " << IOStatisticsSnapshot::percentile(snapshot.mixedLatency, 0.99) << " ns"
+        << ", allocations: " << snapshot.allocations
+        << ", deletes: " << snapshot.deletes;
+    if (snapshot.syncs > 0) {
+        out << ", syncs: " << snapshot.syncs << " (p99 <= "
+            << IOStatisticsSnapshot::percentile(snapshot.syncLatency, 0.99) << " ns)";
+    }
+    if (snapshot.compressedBytes > 0) {
+        out << ", compression: " << snapshot.compressionRatio() << "x";
+    }
+    return out;
+}
+// --------------------------------------------------------------------------
+IOStatistics::Shard& IOStatistics::localShard() {
+    // threads are assigned to the shards round robin
+    static std::atomic_size_t nextShard = 0;
+    thread_local const std::size_t index = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return shards[index];
+}
+// --------------------------------------------------------------------------
+std::size_t IOStatistics::bucket(Clock::duration latency) {
+    const auto nanoseconds = static_cast<std::uint64_t>(
+            std::max<std::int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+    return std::min<std::size_t>(std::bit_width(nanoseconds), LATENCY_BUCKETS - 1);
+}
+// --------------------------------------------------------------------------
+void IOStatistics::recordReads(std::size_t requests, std::size_t bytes, Clock::duration latency) {
+    auto& current = localShard();
+    current.reads.fetch_add(requests, std::memory_order_relaxed);
+    current.readBytes.fetch_add(bytes, std::memory_order_relaxed);
+    current.readLatency[bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------
+void IOStatistics::recordWrites(std::size_t requests, std::size_t bytes, Clock::duration latency) {
+    auto& current = localShard();
+    current.writes.fetch_add(requests, std::memory_order_relaxed);
+    current.writeBytes.fetch_add(bytes, std::memory_order_relaxed);
+    current.writeLatency[bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------
+void IOStatistics::recordMixed(std::size_t reads, std::size_t readBytes, std::size_t writes,
+                               std::size_t writeBytes, Clock::duration latency) {
+    auto& current = localShard();
+    current.reads.fetch_add(reads, std::memory_order_relaxed);
+    current.readBytes.fetch_add(readBytes, std::memory_order_relaxed);
+    current.writes.fetch_add(writes, std::memory_order_relaxed);
+    current.writeBytes.fetch_add(writeBytes, std::memory_order_relaxed);
+    current.mixedLatency[bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------
+void IOStatistics::recordSyncs(std::size_t syncs, Clock::duration latency) {
+    auto& current = localShard();
+    current.syncs.fetch_add(syncs, std::memory_order_relaxed);
+    current.syncLatency[bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------
+void IOStatistics::recordAllocations(std::size_t amount) {
+    localShard().allocations.fetch_add(amount, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------
+void IOStatistics::recordDeletes(std::size_t amount) {
+    localShard().deletes.fetch_add(amount, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------
+void IOStatistics::recordCompression(std::size_t uncompressed, std::size_t compressed) {
+    auto& current = localShard();
+    current.uncompressedBytes.fetch_add(uncompressed, std::memory_order_relaxed);
+    current.compressedBytes.fetch_add(compressed, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------
+IOStatisticsSnapshot IOStatistics::snapshot() const {
+    IOStatisticsSnapshot result;
+    for (const auto& current: shards) {
+        result.reads += current.reads.load(std::memory_order_relaxed);
+        result.readBytes += current.readBytes.load(std::memory_order_relaxed);
+        result.writes += current.writes.load(std::memory_order_relaxed);
+        result.writeBytes += current.writeBytes.load(std::memory_order_relaxed);
+        result.allocations += current.allocations.load(std::memory_order_relaxed);
+        result.deletes += current.deletes.load(std::memory_order_relaxed);
+        result.uncompressedBytes += current.uncompressedBytes.load(std::memory_order_relaxed);
+        result.compressedBytes += current.compressedBytes.load(std::memory_order_relaxed);
+        result.syncs += current.syncs.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            result.readLatency[i] += current.readLatency[i].load(std::memory_order_relaxed);
+            result.writeLatency[i] += current.writeLatency[i].load(std::memory_order_relaxed);
+            result.mixedLatency[i] += current.mixedLatency[i].load(std::memory_order_relaxed);
+            result.syncLatency[i] += current.syncLatency[i].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
@@ -0,0 +1,102 @@
+#ifndef B_EPSILON_IOSTATISTICS_H
+#define B_EPSILON_IOSTATISTICS_H
+// --------------------------------------------------------------------------
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <iosfwd>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+// bucket i counts the latencies in [2^(i-1), 2^i) ns (bucket 0: 0 ns)
+static constexpr std::size_t LATENCY_BUCKETS = 40;
+using LatencyHistogram = std::array<std::uint64_t, LATENCY_BUCKETS>;
+// --------------------------------------------------------------------------
+struct IOStatisticsSnapshot {
+    std::uint64_t reads = 0;// requests (a vectored request counts once)
+    std::uint64_t readBytes = 0;
+    std::uint64_t writes = 0;
+    std::uint64_t writeBytes = 0;
+    std::uint64_t allocations = 0;// created blocks
+    std::uint64_t deletes = 0;    // deleted blocks
+    // block compression: bytes before/after compressing the written blocks
+    std::uint64_t uncompressedBytes = 0;
+    std::uint64_t compressedBytes = 0;
+    std::uint64_t syncs = 0;// fdatasync calls
+    // latency of the submissions (a batch completes as a whole), a batch
+    // with reads and writes counts as mixed
+    LatencyHistogram readLatency = {};
+    LatencyHistogram writeLatency = {};
+    LatencyHistogram mixedLatency = {};
+    LatencyHistogram syncLatency = {};
+
+    // the latency (ns, upper bucket bound) below which <fraction> of the
+    // submissions completed
+    static std::uint64_t percentile(const LatencyHistogram&, double);
+    // uncompressed / compressed size (1 without compression)
+    double compressionRatio() const;
+    // the activity since an older snapshot (e.g. of one workload)
+    IOStatisticsSnapshot operator-(const IOStatisticsSnapshot&) const;
+    IOStatisticsSnapshot& operator+=(const IOStatisticsSnapshot&);
+};
+std::ostream& operator<<(std::ostream&, const IOStatisticsSnapshot&);
+// --------------------------------------------------------------------------
+class IOStatistics {
+    // always-on counters: every thread updates its own shard (relaxed, no
+    // contended cache lines), a snapshot sums up all shards
+
+    static constexpr std::size_t SHARDS = 16;
+
+    struct alignas(64) Shard {
+        std::atomic_uint64_t reads = 0;
+        std::atomic_uint64_t readBytes = 0;
+        std::atomic_uint64_t writes = 0;
+        std::atomic_uint64_t writeBytes = 0;
+        std::atomic_uint64_t allocations = 0;
+        std::atomic_uint64_t deletes = 0;
+        std::atomic_uint64_t uncompressedBytes = 0;
+        std::atomic_uint64_t compressedBytes = 0;
+        std::atomic_uint64_t syncs = 0;
+        std::array<std::atomic_uint64_t, LATENCY_BUCKETS> readLatency = {};
+        std::array<std::atomic_uint64_t, LATENCY_BUCKETS> writeLatency = {};
+        std::array<std::atomic_uint64_t, LATENCY_BUCKETS> mixedLatency = {};
+        std::array<std::atomic_uint64_t, LATENCY_BUCKETS> syncLatency = {};
+    };
+
+private:
+    std::array<Shard, SHARDS> shards;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    IOStatistics() = default;
+    IOStatistics(const IOStatistics&) = delete;
+
+private:
+    // the shard of the calling thread
+    Shard& localShard();
+    static std::size_t bucket(Clock::duration);
+
+public:
+    // a submission of <requests> requests (<bytes> in total) which took <latency>
+    void recordReads(std::size_t, std::size_t, Clock::duration);
+    void recordWrites(std::size_t, std::size_t, Clock::duration);
+    // a submission of reads (requests, bytes) and writes (requests, bytes)
+    void recordMixed(std::size_t, std::size_t, std::size_t, std::size_t, Clock::duration);
+    // <syncs> syncs which took <latency> together
+    void recordSyncs(std::size_t, Clock::duration);
+    void recordAllocations(std::size_t);
+    void recordDeletes(std::size_t);
+    // a block of <uncompressed> bytes was stored in <compressed> bytes
+    void recordCompression(std::size_t, std::size_t);
+    // note: concurrent updates may or may not be included
+    IOStatisticsSnapshot snapshot() const;
+
+    IOStatistics& operator=(const IOStatistics&) = delete;
+};
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_IOSTATISTICS_H
@@ -0,0 +1,274 @@
+#include "IOUringBackend.h"
+#include "src/util/ErrorHandler.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+namespace {
+// --------------------------------------------------------------------------
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+// --------------------------------------------------------------------------
+int ioUringEnter(int ringFD, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFD, toSubmit, minComplete,
+                                    flags, nullptr, 0));
+}
+// --------------------------------------------------------------------------
+unsigned loadAcquire(unsigned* pointer) {
+    return std::atomic_ref<unsigned>(*pointer).load(std::memory_order_acquire);
+}
+// --------------------------------------------------------------------------
+void storeRelease(unsigned* pointer, unsigned value) {
+    std::atomic_ref<unsigned>(*pointer).store(value, std::memory_order_release);
+}
+// --------------------------------------------------------------------------
+}// namespace
+// --------------------------------------------------------------------------
+IOUringBackend::IOUringBackend(int fd, unsigned queueDepth, unsigned pollIterations)
+    : IOBackend(-1), pollIterations(pollIterations) {
+    // don't take ownership of the fd before the ring exists (the caller
+    // falls back to another backend if this constructor throws)
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFD = ioUringSetup(std::max(1u, queueDepth), &params);
+    if (ringFD < 0) {
+        throw std::runtime_error(std::string("io_uring_setup: ") + std::strerror(errno));
+    }
+    // map the submission queue
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQ_RING);
+    // map the submission queue entries
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQES));
+    // map the completion queue
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_CQ_RING);
+    if (sqRing == MAP_FAILED || sqes == MAP_FAILED || cqRing == MAP_FAILED) {
+        const std::string error = std::strerror(errno);
+        if (sqRing != MAP_FAILED) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED) {
+            munmap(cqRing, cqRingSize);
+        }
+        close(ringFD);
+        throw std::runtime_error("io_uring mmap: " + error);
+    }
+    auto* sqBase = static_cast<unsigned char*>(sqRing);
+    sqHead = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+    sqEntries = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_entries);
+    sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+    auto* cqBase = static_cast<unsigned char*>(cqRing);
+    cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+    cqEntries = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_entries);
+    cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+    // from here on, the backend owns the fd
+    setFD(fd);
+}
+// --------------------------------------------------------------------------
+IOUringBackend::~IOUringBackend() {
+    munmap(sqes, sqesSize);
+    munmap(sqRing, sqRingSize);
+    munmap(cqRing, cqRingSize);
+    close(ringFD);
+}
+// --------------------------------------------------------------------------
+std::size_t IOUringBackend::enqueue(std::span<IORequest> requests,
+                                    std::span<Completion> completions, int& error) {
+    std::unique_lock lock(submissionMutex);
+    // never overcommit the completion queue
+    const unsigned currentlyInFlight = inFlight.load();
+    if (currentlyInFlight >= cqEntries) {
+        return 0;
+    }
+    const unsigned tail = *sqTail;
+    const unsigned freeEntries = sqEntries - (tail - loadAcquire(sqHead));
+    const std::size_t amount = std::min<std::size_t>(
+            {requests.size(), freeEntries, cqEntries - currentlyInFlight});
+    if (amount == 0) {
+        return 0;
+    }
+    for (std::size_t i = 0; i < amount; i++) {
+        const IORequest& request = requests[i];
+        assert(isAligned(request));
+        assert(request.buffers.size() <= MAX_VECTORS);
+        const bool read = request.operation == IOOperation::READ;
+        const unsigned index = (tail + i) & sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(io_uring_sqe));
+        sqe.fd = fd;
+        sqe.off = request.offset;
+        if (request.buffers.empty() && vectoredOnly.load(std::memory_order_relaxed)) {
+            Completion& completion = completions[i];
+            completion.vectored = true;
+            completion.buffer = {request.data, request.size};
+            sqe.opcode = read ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe.addr = reinterpret_cast<std::uint64_t>(&completion.buffer);
+            sqe.len = 1;
+        } else if (request.buffers.empty()) {
+            sqe.opcode = read ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe.addr = reinterpret_cast<std::uint64_t>(request.data);
+            sqe.len = static_cast<std::uint32_t>(request.size);
+        } else {
+            sqe.opcode = read ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe.addr = reinterpret_cast<std::uint64_t>(request.buffers.data());
+            sqe.len = static_cast<std::uint32_t>(request.buffers.size());
+        }
+        sqe.user_data = reinterpret_cast<std::uint64_t>(&completions[i]);
+        sqArray[index] = index;
+    }
+    inFlight += amount;
+    // publish the entries to the kernel
+    storeRelease(sqTail, tail + amount);
+    std::size_t submitted = 0;
+    while (submitted < amount) {
+        int result = ioUringEnter(ringFD, amount - submitted, 0, 0);
+        if (result < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            // the kernel only reads the entries in io_uring_enter -> take
+            // back the ones it did not consume
+            error = errno;
+            storeRelease(sqTail, tail + submitted);
+            inFlight -= amount - submitted;
+            return submitted;
+        }
+        submitted += result;
+    }
+    return amount;
+}
+// --------------------------------------------------------------------------
+void IOUringBackend::reap(bool wait) {
+    std::unique_lock lock(completionMutex);
+    unsigned head = *cqHead;
+    if (head == loadAcquire(cqTail)) {
+        if (!wait || inFlight.load() == 0) {
+            return;
+        }
+        // block until the kernel posts at least one completion
+        if (ioUringEnter(ringFD, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            util::raise(std::string("io_uring_enter: ") + std::strerror(errno));
+        }
+    }
+    const unsigned tail = loadAcquire(cqTail);
+    for (; head != tail; head++) {
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        auto* completion = reinterpret_cast<Completion*>(cqe.user_data);
+        completion->result = cqe.res;
+        completion->done.store(true, std::memory_order_release);
+        inFlight--;
+    }
+    storeRelease(cqHead, head);
+}
+// --------------------------------------------------------------------------
+void IOUringBackend::perform(std::span<IORequest> requests, std::span<Completion> completions) {
+    std::size_t submitted = 0;
+    std::size_t completed = 0;
+    const auto collect = [&]() {
+        while (completed < submitted && completions[completed].done.load(std::memory_order_acquire)) {
+            completed++;
+        }
+    };
+    try {
+        while (completed < requests.size()) {
+            if (submitted < requests.size()) {
+                int error = 0;
+                const std::size_t enqueued = enqueue(requests.subspan(submitted),
+                                                     std::span(completions).subspan(submitted), error);
+                submitted += enqueued;
+                if (error != 0) {
+                    util::raise(std::string("io_uring_enter: ") + std::strerror(error));
+                }
+                if (enqueued == 0 && completed == submitted) {
+                    // the rings are full with requests of other threads
+                    reap(true);
+                    continue;
+                }
+            }
+            // poll the completion queue before falling back to a blocking wait
+            for (unsigned i = 0; i <= pollIterations; i++) {
+                reap(i == pollIterations);
+                collect();
+                if (completed == submitted) {
+                    break;
+                }
+            }
+        }
+    } catch (...) {
+        // the kernel still writes into the buffers and completions of the
+        // submitted requests -> wait for them (polling, no syscall)
+        while (completed < submitted) {
+            reap(false);
+            collect();
+            std::this_thread::yield();
+        }
+        throw;
+    }
+}
+// --------------------------------------------------------------------------
+void IOUringBackend::submitRequests(std::span<IORequest> requests) {
+    std::vector<IORequest> batch(requests.begin(), requests.end());
+    // the remaining buffers of the vectored requests after short transfers
+    std::vector<std::vector<iovec>> remainders;
+    while (!batch.empty()) {
+        std::vector<Completion> completions(batch.size());
+        perform(batch, completions);
+        // a short transfer (legal for io_uring) is resubmitted with its
+        // remainder, like the POSIX backend does
+        std::vector<IORequest> retries;
+        for (std::size_t i = 0; i < batch.size(); i++) {
+            IORequest& request = batch[i];
+            const int result = completions[i].result;
+            if (result == static_cast<int>(request.size)) {
+                continue;
+            }
+            if (result == -EINTR || result == -EAGAIN) {
+                retries.push_back(request);
+                continue;
+            }
+            if (result == -EINVAL && request.buffers.empty() && !completions[i].vectored) {
+                // old kernel -> READV/WRITEV from now on
+                vectoredOnly = true;
+                retries.push_back(request);
+                continue;
+            }
+            if (result <= 0) {
+                // an error or the end of the file
+                if (request.operation == IOOperation::READ) {
+                    util::raise("Could not read the blocks.");
+                }
+                util::raise("Could not write the blocks.");
+            }
+            advance(request, result, remainders.emplace_back());
+            retries.push_back(request);
+        }
+        batch = std::move(retries);
+    }
+}
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
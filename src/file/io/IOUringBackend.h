@@ -0,0 +1,75 @@
+#ifndef B_EPSILON_IOURINGBACKEND_H
+#define B_EPSILON_IOURINGBACKEND_H
+// --------------------------------------------------------------------------
+#include "IOBackend.h"
+#include <atomic>
+#include <cstddef>
+#include <linux/io_uring.h>
+#include <mutex>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+class IOUringBackend : public IOBackend {
+    // one ring is shared by all threads:
+    // - submissions are batched and serialized by the submission mutex
+    // - whoever holds the completion mutex reaps the completions of all
+    //   threads and marks them as done (user_data points to a Completion)
+
+    struct Completion {
+        std::atomic_bool done = false;
+        int result = 0;
+        // a plain request submitted as vectored one (see vectoredOnly)
+        bool vectored = false;
+        iovec buffer;
+    };
+
+private:
+    int ringFD = -1;
+    const unsigned pollIterations;
+    // submission queue
+    void* sqRing = nullptr;
+    std::size_t sqRingSize = 0;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned* sqArray;
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sqesSize = 0;
+    // completion queue
+    void* cqRing = nullptr;
+    std::size_t cqRingSize = 0;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    unsigned cqEntries;
+    io_uring_cqe* cqes;
+    // requests which were submitted but not reaped yet
+    std::atomic<unsigned> inFlight = 0;
+    std::mutex submissionMutex;
+    std::mutex completionMutex;
+    // the kernel rejected IORING_OP_READ/WRITE (before 5.6) -> the plain
+    // requests are submitted as READV/WRITEV with a single buffer
+    std::atomic_bool vectoredOnly = false;
+
+public:
+    IOUringBackend(int, unsigned, unsigned);
+    ~IOUringBackend() override;
+
+private:
+    // submits as many requests as the rings allow and returns their amount
+    // note: if the kernel does not take all of them, the others are taken
+    // back and <error> is set (errno)
+    std::size_t enqueue(std::span<IORequest>, std::span<Completion>, int&);
+    // reaps all available completions, optionally waits for at least one
+    void reap(bool);
+    // submits the requests and waits until all of them have completed
+    void perform(std::span<IORequest>, std::span<Completion>);
+
+protected:
+    void submitRequests(std::span<IORequest>) override;
+};
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_IOURINGBACKEND_H
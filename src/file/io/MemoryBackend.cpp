@@ -0,0 +1,88 @@
+#include "MemoryBackend.h"
+#include "src/util/ErrorHandler.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+MemoryBackend::MemoryBackend() : IOBackend(-1) {
+}
+// --------------------------------------------------------------------------
+void MemoryBackend::submitRequests(std::span<IORequest> requests) {
+    std::size_t end = 0;
+    for (const auto& request: requests) {
+        if (request.operation == IOOperation::WRITE) {
+            end = std::max(end, request.offset + request.size);
+        }
+    }
+    {
+        // the writes extend the file first
+        std::unique_lock lock(mutex);
+        if (end > data.size()) {
+            data.resize(end);
+        }
+    }
+    std::shared_lock lock(mutex);
+    for (auto& request: requests) {
+        assert(request.buffers.size() <= MAX_VECTORS);
+        if (request.offset + request.size > data.size()) {
+            util::raise("Could not read the block (behind the end).");
+        }
+        unsigned char* position = data.data() + request.offset;
+        const auto copy = [&position, &request](void* buffer, std::size_t length) {
+            if (request.operation == IOOperation::READ) {
+                std::memcpy(buffer, position, length);
+            } else {
+                std::memcpy(position, buffer, length);
+            }
+            position += length;
+        };
+        if (request.buffers.empty()) {
+            copy(request.data, request.size);
+        } else {
+            for (const iovec& buffer: request.buffers) {
+                copy(buffer.iov_base, buffer.iov_len);
+            }
+        }
+    }
+}
+// --------------------------------------------------------------------------
+void MemoryBackend::willNeed(std::size_t, std::size_t) const {
+    // always resident
+}
+// --------------------------------------------------------------------------
+bool MemoryBackend::syncData() {
+    // nothing to persist
+    return true;
+}
+// --------------------------------------------------------------------------
+std::size_t MemoryBackend::size() const {
+    std::shared_lock lock(mutex);
+    return data.size();
+}
+// --------------------------------------------------------------------------
+bool MemoryBackend::resize(std::size_t newSize) {
+    std::unique_lock lock(mutex);
+    data.resize(newSize);
+    return true;
+}
+// --------------------------------------------------------------------------
+bool MemoryBackend::allocate(std::size_t size, std::size_t offset) {
+    std::unique_lock lock(mutex);
+    data.resize(std::max(data.size(), offset + size));
+    return true;
+}
+// --------------------------------------------------------------------------
+bool MemoryBackend::punchHole(std::size_t size, std::size_t offset) {
+    std::unique_lock lock(mutex);
+    if (offset < data.size()) {
+        std::fill_n(data.begin() + static_cast<std::ptrdiff_t>(offset),
+                    std::min(size, data.size() - offset), 0);
+    }
+    return true;
+}
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
@@ -0,0 +1,36 @@
+#ifndef B_EPSILON_MEMORYBACKEND_H
+#define B_EPSILON_MEMORYBACKEND_H
+// --------------------------------------------------------------------------
+#include "IOBackend.h"
+#include <shared_mutex>
+#include <vector>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+class MemoryBackend : public IOBackend {
+    // a volatile "file" in memory (e.g. to test algorithms without a device)
+    // - writes behind the end extend the file, holes read as zeros
+    // - requests copy concurrently, resizing is exclusive
+
+private:
+    std::vector<unsigned char> data;
+    mutable std::shared_mutex mutex;
+
+public:
+    MemoryBackend();
+
+protected:
+    void submitRequests(std::span<IORequest>) override;
+    bool syncData() override;
+
+public:
+    void willNeed(std::size_t, std::size_t) const override;
+    std::size_t size() const override;
+    bool resize(std::size_t) override;
+    bool allocate(std::size_t, std::size_t) override;
+    bool punchHole(std::size_t, std::size_t) override;
+};
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_MEMORYBACKEND_H
@@ -0,0 +1,49 @@
+#include "PosixBackend.h"
+#include "src/util/ErrorHandler.h"
+#include <cassert>
+#include <cerrno>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+PosixBackend::PosixBackend(int fd) : IOBackend(fd) {
+}
+// --------------------------------------------------------------------------
+void PosixBackend::submitRequests(std::span<IORequest> requests) {
+    for (IORequest request: requests) {
+        assert(isAligned(request));
+        assert(request.buffers.size() <= MAX_VECTORS);
+        const bool read = request.operation == IOOperation::READ;
+        // the remaining buffers after a short transfer
+        std::vector<iovec> buffers;
+        while (true) {
+            ssize_t result;
+            if (!request.buffers.empty()) {
+                // vectored request
+                const int count = static_cast<int>(request.buffers.size());
+                result = read ? preadv(fd, request.buffers.data(), count, request.offset)
+                              : pwritev(fd, request.buffers.data(), count, request.offset);
+            } else {
+                result = read ? pread(fd, request.data, request.size, request.offset)
+                              : pwrite(fd, request.data, request.size, request.offset);
+            }
+            if (result == static_cast<ssize_t>(request.size)) {
+                break;
+            }
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                // an error or the end of the file
+                util::raise(read ? "Could not read the blocks." : "Could not write the blocks.");
+            }
+            // short read or write -> transfer the remainder
+            advance(request, result, buffers);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
@@ -0,0 +1,20 @@
+#ifndef B_EPSILON_POSIXBACKEND_H
+#define B_EPSILON_POSIXBACKEND_H
+// --------------------------------------------------------------------------
+#include "IOBackend.h"
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+class PosixBackend : public IOBackend {
+    // performs every request synchronously with pread/pwrite
+
+public:
+    explicit PosixBackend(int);
+
+protected:
+    void submitRequests(std::span<IORequest>) override;
+};
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_POSIXBACKEND_H
@@ -0,0 +1,66 @@
+#include "ThrottledBackend.h"
+#include <algorithm>
+#include <thread>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+ThrottledBackend::ThrottledBackend(std::unique_ptr<IOBackend> backend, const ThrottleOptions& options)
+    : IOBackend(-1), backend(std::move(backend)), options(options) {
+    // the requests are passed through -> same alignment rules
+    direct = this->backend->isDirect();
+    fd = this->backend->getFD();
+}
+// --------------------------------------------------------------------------
+ThrottledBackend::~ThrottledBackend() {
+    // the wrapped backend owns the file descriptor
+    fd = -1;
+}
+// --------------------------------------------------------------------------
+void ThrottledBackend::submitRequests(std::span<IORequest> requests) {
+    const auto begin = Clock::now();
+    std::size_t bytes = 0;
+    bool write = false;
+    for (const auto& request: requests) {
+        bytes += request.size;
+        write = write || request.operation == IOOperation::WRITE;
+    }
+    auto done = begin + (write ? options.writeLatency : options.readLatency);
+    if (options.bandwidth > 0) {
+        const auto transfer = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(static_cast<double>(bytes) / static_cast<double>(options.bandwidth)));
+        // queue the transfer behind the ones of the other threads
+        std::unique_lock lock(deviceMutex);
+        deviceFree = std::max(deviceFree, begin) + transfer;
+        done = std::max(done, deviceFree);
+    }
+    backend->submit(requests);// IO
+    std::this_thread::sleep_until(done);
+}
+// --------------------------------------------------------------------------
+void ThrottledBackend::willNeed(std::size_t size, std::size_t offset) const {
+    backend->willNeed(size, offset);
+}
+// --------------------------------------------------------------------------
+bool ThrottledBackend::syncData() {
+    // the emulated device persists the data with the write latency
+    return backend->sync();
+}
+// --------------------------------------------------------------------------
+std::size_t ThrottledBackend::size() const {
+    return backend->size();
+}
+// --------------------------------------------------------------------------
+bool ThrottledBackend::resize(std::size_t newSize) {
+    return backend->resize(newSize);
+}
+// --------------------------------------------------------------------------
+bool ThrottledBackend::allocate(std::size_t size, std::size_t offset) {
+    return backend->allocate(size, offset);
+}
+// --------------------------------------------------------------------------
+bool ThrottledBackend::punchHole(std::size_t size, std::size_t offset) {
+    return backend->punchHole(size, offset);
+}
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
@@ -0,0 +1,44 @@
+#ifndef B_EPSILON_THROTTLEDBACKEND_H
+#define B_EPSILON_THROTTLEDBACKEND_H
+// --------------------------------------------------------------------------
+#include "IOBackend.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+// --------------------------------------------------------------------------
+namespace file::io {
+// --------------------------------------------------------------------------
+class ThrottledBackend : public IOBackend {
+    // emulates a slower device on top of another backend:
+    // - every submission takes at least the read/write latency (the requests
+    //   of a batch are in flight together)
+    // - the transfers of all threads share the bandwidth (one device queue)
+
+    using Clock = std::chrono::steady_clock;
+
+private:
+    std::unique_ptr<IOBackend> backend;
+    const ThrottleOptions options;
+    // the emulated device is busy until then
+    Clock::time_point deviceFree = Clock::now();
+    std::mutex deviceMutex;
+
+public:
+    ThrottledBackend(std::unique_ptr<IOBackend>, const ThrottleOptions&);
+    ~ThrottledBackend() override;
+
+protected:
+    void submitRequests(std::span<IORequest>) override;
+    bool syncData() override;
+
+public:
+    void willNeed(std::size_t, std::size_t) const override;
+    std::size_t size() const override;
+    bool resize(std::size_t) override;
+    bool allocate(std::size_t, std::size_t) override;
+    bool punchHole(std::size_t, std::size_t) override;
+};
+// --------------------------------------------------------------------------
+}// namespace file::io
+// --------------------------------------------------------------------------
+#endif//B_EPSILON_THROTTLEDBACKEND_H
@@ -2,10 +2,12 @@
 // --------------------------------------------------------------------------
 #include "src/btree/BTree.h"
 #include "thirdparty/ThreadPool/ThreadPool.h"
+#include <atomic>
 #include <filesystem>
 #include <new>
 #include <random>
 #include <ranges>
+#include <thread>
 // --------------------------------------------------------------------------
 using namespace std;
 using namespace btree;
@@ -494,4 +496,456 @@ TEST(BTree, KeepData) {
             ASSERT_EQ(*find, 2 * i + 1);
         }
     }
-}
\ No newline at end of file
+}
+// --------------------------------------------------------------------------
+TEST(BTree, KeepDataDirectIO) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t PAGE_AMOUNT = 100;
+    file::StorageOptions options;
+    options.directIO = true;
+    vector<uint64_t> inserts(20000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            tree.insert(i, i);
+        }
+        tree.flush();
+    }
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
+namespace btree {
+// --------------------------------------------------------------------------
+// the test accesses the page buffer (friend)
+TEST(BTree, Compaction) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 100;
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25);
+        // deleted pages in front + sparse segments at the end
+        vector<uint64_t> fillers;
+        for (int i = 0; i < 2000; i++) {
+            fillers.push_back(tree.pageBuffer.createPage());
+        }
+        for (size_t i = 0; i < inserts.size(); i++) {
+            tree.insert(inserts[i], inserts[i]);
+            if (i >= inserts.size() / 2) {
+                fillers.push_back(tree.pageBuffer.createPage());
+                fillers.push_back(tree.pageBuffer.createPage());
+            }
+        }
+        for (uint64_t id: fillers) {
+            tree.pageBuffer.deletePage(id);
+        }
+        tree.flush();
+        const size_t fileSize = std::filesystem::file_size(DIRNAME + "/segments");
+        ASSERT_GT(tree.compact(), 0);
+        tree.flush();
+        ASSERT_LT(std::filesystem::file_size(DIRNAME + "/segments"), fileSize);
+        for (uint64_t i: inserts) {
+            auto find = tree.find(i);
+            ASSERT_TRUE(find);
+            ASSERT_EQ(*find, i);
+        }
+    }
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BTree, BackgroundCompaction) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 100;
+    file::StorageOptions options;
+    options.compactionInterval = std::chrono::milliseconds(1);
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        // deleted pages in front + sparse segments at the end
+        vector<uint64_t> fillers;
+        for (int i = 0; i < 2000; i++) {
+            fillers.push_back(tree.pageBuffer.createPage());
+        }
+        for (size_t i = 0; i < inserts.size(); i++) {
+            tree.insert(inserts[i], inserts[i]);
+            if (i >= inserts.size() / 2) {
+                fillers.push_back(tree.pageBuffer.createPage());
+                fillers.push_back(tree.pageBuffer.createPage());
+            }
+        }
+        tree.flush();
+        const size_t fileSize = std::filesystem::file_size(DIRNAME + "/segments");
+        for (uint64_t id: fillers) {
+            tree.pageBuffer.deletePage(id);
+        }
+        // the flush releases the segments compacted in the background
+        for (int i = 0; i < 5000 && std::filesystem::file_size(DIRNAME + "/segments") >= fileSize; i++) {
+            this_thread::sleep_for(1ms);
+            tree.flush();
+        }
+        ASSERT_LT(std::filesystem::file_size(DIRNAME + "/segments"), fileSize);
+        for (uint64_t i: inserts) {
+            auto find = tree.find(i);
+            ASSERT_TRUE(find);
+            ASSERT_EQ(*find, i);
+        }
+    }
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BTree, CheckpointDuringCompaction) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 40;
+    file::StorageOptions options;
+    options.compactionInterval = std::chrono::milliseconds(1);
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        for (size_t i = 0; i < inserts.size() / 2; i++) {
+            tree.insert(inserts[i], inserts[i]);
+        }
+        // the created and deleted pages leave sparse segments behind (the
+        // background compaction relocates the nodes stored in them)
+        std::atomic_bool done = false;
+        std::thread filler([&tree, &done]() {
+            vector<uint64_t> fillers;
+            while (!done) {
+                for (int i = 0; i < 100; i++) {
+                    fillers.push_back(tree.pageBuffer.createPage());
+                }
+                for (size_t i = 0; i < fillers.size(); i += 2) {
+                    tree.pageBuffer.deletePage(fillers[i]);
+                }
+                for (size_t i = 1; i < fillers.size(); i += 2) {
+                    tree.pageBuffer.deletePage(fillers[i]);
+                }
+                fillers.clear();
+            }
+        });
+        std::size_t checkpoints = 0;
+        std::thread checkpointer([&]() {
+            while (!done) {
+                tree.checkpoint();
+                checkpoints++;
+            }
+        });
+        {
+            ThreadPool threadPool(4);
+            vector<future<void>> calls;
+            for (size_t i = inserts.size() / 2; i < inserts.size(); i++) {
+                calls.emplace_back(threadPool.enqueue([&tree, key = inserts[i]]() {
+                    tree.insert(key, key);
+                }));
+            }
+            for (auto& call: calls) {
+                call.get();
+            }
+        }
+        done = true;
+        checkpointer.join();
+        filler.join();
+        ASSERT_GT(checkpoints, 0);
+        tree.checkpoint();
+    }
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
+}// namespace btree
+// --------------------------------------------------------------------------
+TEST(BTree, InMemoryStorage) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 100;
+    file::StorageOptions options;
+    options.io.type = file::io::IOBackendType::MEMORY;
+    options.io.throttle.readLatency = std::chrono::microseconds(10);
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+    for (uint64_t i: inserts) {
+        tree.insert(i, i);
+    }
+    tree.flush();
+    ASSERT_FALSE(std::filesystem::exists(DIRNAME + "/segments"));
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+    ASSERT_GT(tree.getStatistics().reads, 0);
+}
+// --------------------------------------------------------------------------
+TEST(BTree, WriteAheadLog) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 20;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.writeAheadLog = true;
+    vector<uint64_t> inserts(5000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        ThreadPool threadPool(8);
+        vector<future<void>> calls;
+        for (uint64_t i: inserts) {
+            calls.emplace_back(threadPool.enqueue([&tree, i]() {
+                tree.insert(i, i);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        // checkpoint
+        tree.flush();
+        for (uint64_t i: inserts) {
+            if (i % 2 == 0) {
+                tree.update(i, 1);
+            } else if (i % 3 == 0) {
+                tree.erase(i);
+            }
+        }
+        // no flush: the operations since the checkpoint are in the log only
+        ASSERT_GT(tree.getStatistics().syncs, 0);
+    }
+    for (std::size_t reopen = 0; reopen < 2; reopen++) {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            auto find = tree.find(i);
+            if (i % 2 == 0) {
+                ASSERT_TRUE(find);
+                ASSERT_EQ(*find, i + 1);
+            } else if (i % 3 == 0) {
+                ASSERT_FALSE(find);
+            } else {
+                ASSERT_TRUE(find);
+                ASSERT_EQ(*find, i);
+            }
+        }
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BTree, WriteAheadLogNotTruncated) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 20;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.writeAheadLog = true;
+    vector<uint64_t> inserts(2000);
+    iota(inserts.begin(), inserts.end(), 0);
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            tree.insert(i, i);
+            tree.update(i, 1);
+        }
+        std::filesystem::copy_file(DIRNAME + "/wal", DIRNAME + "/wal.copy");
+        tree.flush();
+    }
+    // crash after the flush was persisted, but before the log was cut: the
+    // updates (not idempotent) are not applied twice
+    std::filesystem::rename(DIRNAME + "/wal.copy", DIRNAME + "/wal");
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i + 1);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BTree, Checkpoint) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 40;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.writeAheadLog = true;
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        ThreadPool threadPool(8);
+        vector<future<void>> calls;
+        for (uint64_t i: inserts) {
+            calls.emplace_back(threadPool.enqueue([&tree, i]() {
+                tree.insert(i, i);
+            }));
+        }
+        // checkpoints while the tree is in use
+        std::atomic_bool done = false;
+        std::size_t checkpoints = 0;
+        std::thread checkpointer([&]() {
+            while (!done) {
+                tree.checkpoint();
+                checkpoints++;
+            }
+        });
+        for (auto& call: calls) {
+            call.get();
+        }
+        done = true;
+        checkpointer.join();
+        ASSERT_GT(checkpoints, 0);
+        for (uint64_t i: inserts) {
+            if (i % 2 == 0) {
+                tree.update(i, 1);
+            }
+        }
+        // no checkpoint: the updates are in the log only
+    }
+    for (std::size_t reopen = 0; reopen < 2; reopen++) {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            auto find = tree.find(i);
+            ASSERT_TRUE(find);
+            ASSERT_EQ(*find, i % 2 == 0 ? i + 1 : i);
+        }
+        tree.checkpoint();
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BTree, CheckpointInPlace) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 40;
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25);
+        for (size_t i = 0; i < inserts.size() / 2; i++) {
+            tree.insert(inserts[i], inserts[i]);
+        }
+        // the finds load and evict pages while the checkpoints write them
+        std::atomic_bool done = false;
+        vector<thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&tree, &done, &inserts, t]() {
+                default_random_engine engine(t);
+                while (!done) {
+                    const uint64_t key = inserts[engine() % (inserts.size() / 2)];
+                    auto find = tree.find(key);
+                    ASSERT_TRUE(find);
+                    ASSERT_EQ(*find, key);
+                }
+            });
+        }
+        std::size_t checkpoints = 0;
+        std::thread checkpointer([&]() {
+            while (!done) {
+                tree.checkpoint();
+                checkpoints++;
+            }
+        });
+        {
+            ThreadPool threadPool(4);
+            vector<future<void>> calls;
+            for (size_t i = inserts.size() / 2; i < inserts.size(); i++) {
+                calls.emplace_back(threadPool.enqueue([&tree, key = inserts[i]]() {
+                    tree.insert(key, key);
+                }));
+            }
+            for (auto& call: calls) {
+                call.get();
+            }
+        }
+        done = true;
+        checkpointer.join();
+        for (auto& reader: readers) {
+            reader.join();
+        }
+        ASSERT_GT(checkpoints, 0);
+        tree.checkpoint();
+    }
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BTree, MultiThreadedFindDuringInserts) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 400;
+    BTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT> tree(DIRNAME, 1.25);
+    for (uint64_t i = 0; i < 5000; i++) {
+        tree.insert(i * 2, i * 2);
+    }
+    // the lookups read the nodes optimistically while they are split
+    std::atomic_bool done = false;
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&tree, &done, t]() {
+            default_random_engine engine(t);
+            while (!done) {
+                const uint64_t key = engine() % 10000;
+                auto find = tree.find(key);
+                if (key % 2 == 0) {
+                    ASSERT_TRUE(find);
+                    ASSERT_EQ(*find, key);
+                } else if (find) {
+                    ASSERT_EQ(*find, key);
+                }
+            }
+        });
+    }
+    {
+        ThreadPool threadPool(4);
+        vector<future<void>> calls;
+        for (uint64_t i = 0; i < 5000; i++) {
+            calls.emplace_back(threadPool.enqueue([&tree, i]() {
+                tree.insert(i * 2 + 1, i * 2 + 1);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+    }
+    done = true;
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    for (uint64_t i = 0; i < 10000; i++) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
@@ -2,10 +2,14 @@
 // --------------------------------------------------------------------------
 #include "src/betree/BeTree.h"
 #include "thirdparty/ThreadPool/ThreadPool.h"
+#include <array>
+#include <atomic>
 #include <filesystem>
+#include <fstream>
 #include <new>
 #include <random>
 #include <ranges>
+#include <thread>
 // --------------------------------------------------------------------------
 using namespace std;
 using namespace betree;
@@ -494,4 +498,296 @@ TEST(BeTree, KeepData) {
             ASSERT_EQ(*find, 2 * i + 1);
         }
     }
-}
\ No newline at end of file
+}
+// --------------------------------------------------------------------------
+namespace betree {
+// --------------------------------------------------------------------------
+// the test accesses the page buffer (friend)
+TEST(BeTree, Compaction) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 100;
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25);
+        // deleted pages in front + sparse segments at the end
+        vector<uint64_t> fillers;
+        for (int i = 0; i < 2000; i++) {
+            fillers.push_back(tree.pageBuffer.createPage());
+        }
+        for (size_t i = 0; i < inserts.size(); i++) {
+            tree.insert(inserts[i], inserts[i]);
+            if (i >= inserts.size() / 2) {
+                fillers.push_back(tree.pageBuffer.createPage());
+                fillers.push_back(tree.pageBuffer.createPage());
+            }
+        }
+        for (uint64_t id: fillers) {
+            tree.pageBuffer.deletePage(id);
+        }
+        tree.flush();
+        const size_t fileSize = std::filesystem::file_size(DIRNAME + "/segments");
+        ASSERT_GT(tree.compact(), 0);
+        tree.flush();
+        ASSERT_LT(std::filesystem::file_size(DIRNAME + "/segments"), fileSize);
+        for (uint64_t i: inserts) {
+            auto find = tree.find(i);
+            ASSERT_TRUE(find);
+            ASSERT_EQ(*find, i);
+        }
+    }
+    BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
+}// namespace betree
+// --------------------------------------------------------------------------
+TEST(BeTree, LogStructured) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 100;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.cleanerInterval = std::chrono::milliseconds(1);
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        // the background cleaner moves the pages while they are written
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            tree.insert(i, i);
+        }
+        for (uint64_t i: inserts) {
+            tree.update(i, 1);
+        }
+        tree.flush();
+    }
+    BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i + 1);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BeTree, Compression) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t PAGE_AMOUNT = 20;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.compression = true;
+    vector<uint64_t> inserts(20000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            tree.insert(i, i);
+        }
+        tree.flush();
+        // the nodes are not full
+        ASSERT_GT(tree.getStatistics().compressionRatio(), 1.2);
+    }
+    BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BeTree, WriteAheadLog) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 20;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.writeAheadLog = true;
+    vector<uint64_t> inserts(5000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+        ThreadPool threadPool(8);
+        vector<future<void>> calls;
+        for (uint64_t i: inserts) {
+            calls.emplace_back(threadPool.enqueue([&tree, i]() {
+                tree.insert(i, i);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        // checkpoint
+        tree.flush();
+        for (uint64_t i: inserts) {
+            if (i % 2 == 0) {
+                tree.update(i, 1);
+            } else if (i % 3 == 0) {
+                tree.erase(i);
+            }
+        }
+        // no flush: the operations since the checkpoint are in the log only
+        ASSERT_GT(tree.getStatistics().syncs, 0);
+    }
+    for (std::size_t reopen = 0; reopen < 2; reopen++) {
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            auto find = tree.find(i);
+            if (i % 2 == 0) {
+                ASSERT_TRUE(find);
+                ASSERT_EQ(*find, i + 1);
+            } else if (i % 3 == 0) {
+                ASSERT_FALSE(find);
+            } else {
+                ASSERT_TRUE(find);
+                ASSERT_EQ(*find, i);
+            }
+        }
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BeTree, Checkpoint) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 40;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.writeAheadLog = true;
+    vector<uint64_t> inserts(10000);
+    iota(inserts.begin(), inserts.end(), 0);
+    shuffle(inserts.begin(), inserts.end(), default_random_engine());
+    {
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+        ThreadPool threadPool(8);
+        vector<future<void>> calls;
+        for (uint64_t i: inserts) {
+            calls.emplace_back(threadPool.enqueue([&tree, i]() {
+                tree.insert(i, i);
+            }));
+        }
+        // checkpoints while the tree is in use
+        std::atomic_bool done = false;
+        std::size_t checkpoints = 0;
+        std::thread checkpointer([&]() {
+            while (!done) {
+                tree.checkpoint();
+                checkpoints++;
+            }
+        });
+        for (auto& call: calls) {
+            call.get();
+        }
+        done = true;
+        checkpointer.join();
+        ASSERT_GT(checkpoints, 0);
+        for (uint64_t i: inserts) {
+            if (i % 2 == 0) {
+                tree.update(i, 1);
+            }
+        }
+        // no checkpoint: the updates are in the log only
+    }
+    for (std::size_t reopen = 0; reopen < 2; reopen++) {
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            auto find = tree.find(i);
+            ASSERT_TRUE(find);
+            ASSERT_EQ(*find, i % 2 == 0 ? i + 1 : i);
+        }
+        tree.checkpoint();
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BeTree, CheckpointLogNotTruncated) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 40;
+    file::StorageOptions options;
+    options.logStructured = true;
+    options.writeAheadLog = true;
+    vector<uint64_t> inserts(2000);
+    iota(inserts.begin(), inserts.end(), 0);
+    {
+        BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+        for (uint64_t i: inserts) {
+            tree.insert(i, i);
+            tree.update(i, 1);
+        }
+        // the log header: the offset of the first record
+        std::array<char, sizeof(uint64_t)> begin;
+        std::ifstream(DIRNAME + "/wal", std::ios::binary).read(begin.data(), begin.size());
+        tree.checkpoint();
+        // logged after the checkpoint began -> replayed
+        for (uint64_t i: inserts) {
+            tree.update(i, 1);
+        }
+        // crash after the checkpoint was persisted, but before the log was
+        // cut: the updates (not idempotent) are not applied twice
+        std::fstream(DIRNAME + "/wal", std::ios::in | std::ios::out | std::ios::binary).write(begin.data(), begin.size());
+    }
+    BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25, options);
+    for (uint64_t i: inserts) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i + 2);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(BeTree, MultiThreadedFindDuringInserts) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 256;
+    constexpr size_t PAGE_AMOUNT = 400;
+    BeTree<uint64_t, uint64_t, BLOCK_SIZE, PAGE_AMOUNT, 50> tree(DIRNAME, 1.25);
+    for (uint64_t i = 0; i < 5000; i++) {
+        tree.insert(i * 2, i * 2);
+    }
+    // the lookups read the nodes optimistically while they are split
+    std::atomic_bool done = false;
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&tree, &done, t]() {
+            default_random_engine engine(t);
+            while (!done) {
+                const uint64_t key = engine() % 10000;
+                auto find = tree.find(key);
+                if (key % 2 == 0) {
+                    ASSERT_TRUE(find);
+                    ASSERT_EQ(*find, key);
+                } else if (find) {
+                    ASSERT_EQ(*find, key);
+                }
+            }
+        });
+    }
+    {
+        ThreadPool threadPool(4);
+        vector<future<void>> calls;
+        for (uint64_t i = 0; i < 5000; i++) {
+            calls.emplace_back(threadPool.enqueue([&tree, i]() {
+                tree.insert(i * 2 + 1, i * 2 + 1);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+    }
+    done = true;
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    for (uint64_t i = 0; i < 10000; i++) {
+        auto find = tree.find(i);
+        ASSERT_TRUE(find);
+        ASSERT_EQ(*find, i);
+    }
+}
+// --------------------------------------------------------------------------
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+// --------------------------------------------------------------------------
+#include "src/file/io/IOBackend.h"
+#include "thirdparty/ThreadPool/ThreadPool.h"
+#include <fcntl.h>
+#include <filesystem>
+#include <vector>
+// --------------------------------------------------------------------------
+using namespace std;
+using namespace file::io;
+// --------------------------------------------------------------------------
+namespace {
+// --------------------------------------------------------------------------
+static const string DIRNAME = "/tmp/tester_test_io_backend";
+unique_ptr<IOBackend> setup(IOBackendType type, const ThrottleOptions& throttle = {}) {
+    std::filesystem::remove_all(DIRNAME.c_str());
+    std::filesystem::create_directories(DIRNAME);
+    const string fileName = DIRNAME + "/file";
+    int fd = -1;
+    if (type != IOBackendType::MEMORY) {
+        fd = open(fileName.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        EXPECT_GE(fd, 0);
+    }
+    IOBackendOptions options;
+    options.type = type;
+    options.queueDepth = 8;// smaller than the batches
+    options.throttle = throttle;
+    return createBackend(fd, options);
+}
+// --------------------------------------------------------------------------
+void batchedReadWrite(IOBackend& backend) {
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t BLOCKS = 100;
+    vector<array<unsigned char, BLOCK_SIZE>> blocks(BLOCKS);
+    vector<IORequest> requests;
+    for (size_t i = 0; i < BLOCKS; i++) {
+        blocks[i].fill(i % 256);
+        requests.push_back({IOOperation::WRITE, blocks[i].data(), BLOCK_SIZE, i * BLOCK_SIZE});
+    }
+    backend.submit(requests);
+    vector<array<unsigned char, BLOCK_SIZE>> results(BLOCKS);
+    requests.clear();
+    for (size_t i = 0; i < BLOCKS; i++) {
+        requests.push_back({IOOperation::READ, results[i].data(), BLOCK_SIZE, i * BLOCK_SIZE});
+    }
+    backend.submit(requests);
+    for (size_t i = 0; i < BLOCKS; i++) {
+        for (unsigned char c: results[i]) {
+            ASSERT_EQ(c, i % 256);
+        }
+    }
+    // reading behind the end of the file must fail
+    array<unsigned char, BLOCK_SIZE> arr;
+    ASSERT_THROW(backend.read(arr.data(), BLOCK_SIZE, BLOCKS * BLOCK_SIZE), std::runtime_error);
+}
+// --------------------------------------------------------------------------
+}// namespace
+// --------------------------------------------------------------------------
+TEST(IOBackend, PosixBatch) {
+    auto backend = setup(IOBackendType::POSIX);
+    batchedReadWrite(*backend);
+}
+// --------------------------------------------------------------------------
+TEST(IOBackend, IOUringBatch) {
+    auto backend = setup(IOBackendType::IO_URING);
+    batchedReadWrite(*backend);
+}
+// --------------------------------------------------------------------------
+TEST(IOBackend, IOUringMultiThreaded) {
+    constexpr size_t BLOCK_SIZE = 4096;
+    auto backend = setup(IOBackendType::IO_URING);
+    ThreadPool threadPool(32);
+    vector<future<void>> calls;
+    for (size_t i = 0; i < 1000; i++) {
+        calls.emplace_back(threadPool.enqueue([i, &backend]() {
+            array<unsigned char, BLOCK_SIZE> arr;
+            arr.fill(i % 256);
+            backend->write(arr.data(), BLOCK_SIZE, i * BLOCK_SIZE);
+            array<unsigned char, BLOCK_SIZE> result;
+            backend->read(result.data(), BLOCK_SIZE, i * BLOCK_SIZE);
+            ASSERT_EQ(arr, result);
+        }));
+    }
+    for (auto& call: calls) {
+        call.get();
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(IOBackend, MemoryBatch) {
+    auto backend = setup(IOBackendType::MEMORY);
+    batchedReadWrite(*backend);
+    ASSERT_FALSE(std::filesystem::exists(DIRNAME + "/file"));
+    // the file operations behave like the ones of a file
+    constexpr size_t BLOCK_SIZE = 4096;
+    ASSERT_EQ(backend->size(), 100 * BLOCK_SIZE);
+    ASSERT_TRUE(backend->punchHole(BLOCK_SIZE, 3 * BLOCK_SIZE));
+    ASSERT_EQ(backend->size(), 100 * BLOCK_SIZE);
+    array<unsigned char, BLOCK_SIZE> arr;
+    backend->read(arr.data(), BLOCK_SIZE, 3 * BLOCK_SIZE);
+    ASSERT_EQ(arr, (array<unsigned char, BLOCK_SIZE>{}));
+    backend->read(arr.data(), BLOCK_SIZE, 4 * BLOCK_SIZE);
+    ASSERT_EQ(arr[0], 4);
+    ASSERT_TRUE(backend->allocate(BLOCK_SIZE, 200 * BLOCK_SIZE));
+    ASSERT_EQ(backend->size(), 201 * BLOCK_SIZE);
+    ASSERT_TRUE(backend->resize(BLOCK_SIZE));
+    ASSERT_THROW(backend->read(arr.data(), BLOCK_SIZE, BLOCK_SIZE), std::runtime_error);
+}
+// --------------------------------------------------------------------------
+TEST(IOBackend, Throttled) {
+    using namespace std::chrono;
+    ThrottleOptions throttle;
+    throttle.readLatency = milliseconds(2);
+    throttle.writeLatency = milliseconds(5);
+    auto backend = setup(IOBackendType::MEMORY, throttle);
+    batchedReadWrite(*backend);
+    constexpr size_t BLOCK_SIZE = 4096;
+    array<unsigned char, BLOCK_SIZE> arr = {};
+    // every submission takes the latency of the device
+    auto begin = steady_clock::now();
+    for (size_t i = 0; i < 10; i++) {
+        backend->write(arr.data(), BLOCK_SIZE, i * BLOCK_SIZE);
+        backend->read(arr.data(), BLOCK_SIZE, i * BLOCK_SIZE);
+    }
+    ASSERT_GE(steady_clock::now() - begin, milliseconds(70));
+    // a mixed batch is submitted at once: its latency is not attributed to
+    // the reads or the writes
+    IOStatistics statistics;
+    backend->setStatistics(&statistics);
+    array<unsigned char, BLOCK_SIZE> other = {};
+    vector<IORequest> requests = {{IOOperation::WRITE, arr.data(), BLOCK_SIZE, 0},
+                                  {IOOperation::READ, other.data(), BLOCK_SIZE, BLOCK_SIZE}};
+    backend->submit(requests);
+    const auto snapshot = statistics.snapshot();
+    ASSERT_EQ(snapshot.reads, 1);
+    ASSERT_EQ(snapshot.writes, 1);
+    ASSERT_EQ(IOStatisticsSnapshot::percentile(snapshot.readLatency, 1.0), 0);
+    ASSERT_EQ(IOStatisticsSnapshot::percentile(snapshot.writeLatency, 1.0), 0);
+    ASSERT_GE(IOStatisticsSnapshot::percentile(snapshot.mixedLatency, 1.0), nanoseconds(throttle.writeLatency).count());
+    // the bandwidth is shared by all threads: 32 x 1 MiB at 256 MiB/s
+    throttle = {};
+    throttle.bandwidth = 256 << 20;
+    backend = setup(IOBackendType::POSIX, throttle);
+    ASSERT_TRUE(backend->resize(1 << 20));
+    begin = steady_clock::now();
+    {
+        ThreadPool threadPool(8);
+        vector<future<void>> calls;
+        for (size_t i = 0; i < 32; i++) {
+            calls.emplace_back(threadPool.enqueue([&backend]() {
+                vector<unsigned char> data(1 << 20);
+                backend->read(data.data(), data.size(), 0);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+    }
+    ASSERT_GE(steady_clock::now() - begin, milliseconds(125));
+}
+// --------------------------------------------------------------------------
@@ -158,6 +158,35 @@ TEST(PageBuffer, KeepDataSingleThreaded) {
     }
 }
 // --------------------------------------------------------------------------
+TEST(PageBuffer, KeepDataDirectIO) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t PAGE_AMOUNT = 100;
+    file::StorageOptions options;
+    options.directIO = true;
+    vector<size_t> ids;
+    {
+        PageBuffer<BLOCK_SIZE, PAGE_AMOUNT> pageBuffer(DIRNAME, 1.25, options);
+        for (int i = 0; i < 1000; i++) {
+            ids.push_back(pageBuffer.createPage());
+            auto& page = pageBuffer.pinPage(ids.back(), true, true);
+            // the frames must be usable for O_DIRECT
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(page.data.data()) % 4096, 0);
+            page.data.fill(page.id % 256);
+            pageBuffer.unpinPage(page, true);
+        }
+        pageBuffer.flush();
+    }
+    PageBuffer<BLOCK_SIZE, PAGE_AMOUNT> pageBuffer(DIRNAME, 1.25, options);
+    for (size_t id: ids) {
+        auto& page = pageBuffer.pinPage(id, false);
+        for (unsigned char c: page.data) {
+            ASSERT_EQ(c, id % 256);
+        }
+        pageBuffer.unpinPage(page, false);
+    }
+}
+// --------------------------------------------------------------------------
 TEST(PageBuffer, Full) {
     setup();
     constexpr size_t BLOCK_SIZE = 4096;
@@ -318,6 +347,531 @@ TEST(PageBuffer, MultiThreaded2) {
     }
 }
 // --------------------------------------------------------------------------
+TEST(PageBuffer, Partitioned) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 512;
+    constexpr size_t PAGE_AMOUNT = 1024;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    static_assert(Buffer::PARTITIONS == 4);
+    vector<size_t> ids;
+    {
+        Buffer pageBuffer(DIRNAME, 1.25);
+        for (int i = 0; i < 4000; i++) {
+            ids.push_back(pageBuffer.createPage());
+        }
+        ThreadPool threadPool(32);
+        vector<future<void>> calls;
+        for (size_t id: ids) {
+            calls.emplace_back(threadPool.enqueue([id, &pageBuffer]() {
+                auto& page = pageBuffer.pinPage(id, true, true);
+                ASSERT_EQ(page.id, id);
+                page.data.fill(id % 256);
+                pageBuffer.unpinPage(page, true);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        calls.clear();
+        // every partition evicts its own pages
+        for (int i = 0; i < 4000; i++) {
+            size_t id = ids[rand() % ids.size()];
+            calls.emplace_back(threadPool.enqueue([id, &pageBuffer]() {
+                auto& page = pageBuffer.pinPage(id, false);
+                ASSERT_EQ(page.id, id);
+                for (unsigned char c: page.data) {
+                    ASSERT_EQ(c, id % 256);
+                }
+                pageBuffer.unpinPage(page, false);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        pageBuffer.flush();
+    }
+    Buffer pageBuffer(DIRNAME, 1.25);
+    for (size_t id: ids) {
+        auto& page = pageBuffer.pinPage(id, false);
+        for (unsigned char c: page.data) {
+            ASSERT_EQ(c, id % 256);
+        }
+        pageBuffer.unpinPage(page, false);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(PageBuffer, Cleaner) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 512;
+    constexpr size_t PAGE_AMOUNT = 1024;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    file::StorageOptions options;
+    options.pageCleanerThreads = 2;
+    vector<size_t> ids;
+    {
+        Buffer pageBuffer(DIRNAME, 1.25, options);
+        // fits into the windows of the cleaners (64 pages per partition)
+        for (int i = 0; i < 160; i++) {
+            ids.push_back(pageBuffer.createPage());
+        }
+        vector<size_t> otherIDs;
+        for (int i = 0; i < 2000; i++) {
+            otherIDs.push_back(pageBuffer.createPage());
+        }
+        const auto before = pageBuffer.getStatistics();
+        for (size_t id: ids) {
+            auto& page = pageBuffer.pinPage(id, true, true);
+            page.data.fill(id % 256);
+            pageBuffer.unpinPage(page, true);
+        }
+        // the cleaners write the dirty pages in the background
+        for (int i = 0; i < 10000; i++) {
+            if ((pageBuffer.getStatistics() - before).writeBytes >= ids.size() * BLOCK_SIZE) {
+                break;
+            }
+            this_thread::sleep_for(1ms);
+        }
+        ASSERT_GE((pageBuffer.getStatistics() - before).writeBytes, ids.size() * BLOCK_SIZE);
+        // -> evicting them does not write
+        const auto cleaned = pageBuffer.getStatistics();
+        for (size_t id: otherIDs) {
+            auto& page = pageBuffer.pinPage(id, false, true);
+            pageBuffer.unpinPage(page, false);
+        }
+        ASSERT_EQ((pageBuffer.getStatistics() - cleaned).writes, 0);
+        pageBuffer.flush();
+    }
+    Buffer pageBuffer(DIRNAME, 1.25);
+    for (size_t id: ids) {
+        auto& page = pageBuffer.pinPage(id, false);
+        for (unsigned char c: page.data) {
+            ASSERT_EQ(c, id % 256);
+        }
+        pageBuffer.unpinPage(page, false);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(PageBuffer, FreeFrameReserve) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 512;
+    constexpr size_t PAGE_AMOUNT = 1024;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    file::StorageOptions options;
+    options.pageCleanerThreads = 2;
+    options.evictorLowWatermark = 128;
+    options.evictorHighWatermark = 256;
+    {
+        // only the cleaners refill the reserve
+        file::StorageOptions withoutCleaners = options;
+        withoutCleaners.pageCleanerThreads = 0;
+        const auto create = [&withoutCleaners]() {
+            Buffer pageBuffer(DIRNAME, 1.25, withoutCleaners);
+        };
+        ASSERT_THROW(create(), std::runtime_error);
+    }
+    vector<size_t> ids;
+    {
+        Buffer pageBuffer(DIRNAME, 1.25, options);
+        for (int i = 0; i < 4000; i++) {
+            ids.push_back(pageBuffer.createPage());
+        }
+        ThreadPool threadPool(16);
+        vector<future<void>> calls;
+        for (size_t id: ids) {
+            calls.emplace_back(threadPool.enqueue([id, &pageBuffer]() {
+                auto& page = pageBuffer.pinPage(id, true, true);
+                ASSERT_EQ(page.id, id);
+                page.data.fill(id % 256);
+                pageBuffer.unpinPage(page, true);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        calls.clear();
+        // the misses take the frames freed by the cleaners
+        for (int i = 0; i < 8000; i++) {
+            size_t id = ids[rand() % ids.size()];
+            calls.emplace_back(threadPool.enqueue([id, &pageBuffer]() {
+                auto& page = pageBuffer.pinPage(id, false);
+                ASSERT_EQ(page.id, id);
+                for (unsigned char c: page.data) {
+                    ASSERT_EQ(c, id % 256);
+                }
+                pageBuffer.unpinPage(page, false);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        pageBuffer.flush();
+    }
+    Buffer pageBuffer(DIRNAME, 1.25);
+    for (size_t id: ids) {
+        auto& page = pageBuffer.pinPage(id, false);
+        for (unsigned char c: page.data) {
+            ASSERT_EQ(c, id % 256);
+        }
+        pageBuffer.unpinPage(page, false);
+    }
+}
+// --------------------------------------------------------------------------
+namespace buffer {
+// --------------------------------------------------------------------------
+// the test accesses the free frames (friend)
+TEST(PageBuffer, FreeFrameReserveWakeUp) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 512;
+    constexpr size_t PAGE_AMOUNT = 256;// one partition
+    file::StorageOptions options;
+    options.pageCleanerThreads = 1;
+    options.pageCleanerInterval = std::chrono::hours(1);
+    options.evictorLowWatermark = 32;
+    options.evictorHighWatermark = 64;
+    PageBuffer<BLOCK_SIZE, PAGE_AMOUNT> pageBuffer(DIRNAME, 1.25, options);
+    const auto freeFrames = [&pageBuffer]() {
+        auto& partition = pageBuffer.partitions.front();
+        std::shared_lock lock(partition.tableMutex);
+        return partition.freeSlots.size();
+    };
+    // the last page takes the reserve below the low watermark
+    for (size_t i = 0; i < PAGE_AMOUNT - 31; i++) {
+        auto& page = pageBuffer.pinPage(pageBuffer.createPage(), true, true);
+        pageBuffer.unpinPage(page, false);
+    }
+    // the cleaner refills it right away (not after the interval)
+    for (int i = 0; i < 10000 && freeFrames() < 64; i++) {
+        this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(freeFrames(), 64);
+}
+// --------------------------------------------------------------------------
+// the test accesses the partitions (friend)
+TEST(PageBuffer, RelocationKeepsPartitionSizes) {
+    constexpr size_t BLOCK_SIZE = 512;
+    constexpr size_t PAGE_AMOUNT = 1024;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    for (auto policy: {file::ReplacementPolicy::TWO_QUEUE, file::ReplacementPolicy::CLOCK}) {
+        setup();
+        file::StorageOptions options;
+        options.replacementPolicy = policy;
+        Buffer pageBuffer(DIRNAME, 1.25, options);
+        vector<size_t> ids;
+        for (size_t i = 0; i < PAGE_AMOUNT; i++) {
+            ids.push_back(pageBuffer.createPage());
+        }
+        // no free frames, dirty pages only
+        for (size_t id: ids) {
+            auto& page = pageBuffer.pinPage(id, true, true);
+            page.data.fill(id % 256);
+            pageBuffer.unpinPage(page, true);
+        }
+        for (size_t i = 0; i < ids.size(); i += 3) {
+            auto& page = pageBuffer.pinPage(ids[i], true);
+            ids[i] = pageBuffer.createPage();
+            pageBuffer.relocatePage(page, ids[i]);
+            page.data.fill(ids[i] % 256);
+            pageBuffer.unpinPage(page, true);
+        }
+        for (const auto& partition: pageBuffer.partitions) {
+            ASSERT_EQ(partition.pageTable.size() + partition.freeSlots.size(), PAGE_AMOUNT / Buffer::PARTITIONS);
+            if (policy == file::ReplacementPolicy::CLOCK) {
+                ASSERT_EQ(partition.clock.size(), PAGE_AMOUNT / Buffer::PARTITIONS);
+            }
+        }
+        // including the pages written to give a frame back
+        for (size_t id: ids) {
+            auto& page = pageBuffer.pinPage(id, false);
+            ASSERT_EQ(page.id, id);
+            for (unsigned char c: page.data) {
+                ASSERT_EQ(c, id % 256);
+            }
+            pageBuffer.unpinPage(page, false);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+// the test accesses the reference latch (friend)
+TEST(PageBuffer, SwizzlingWhileCopied) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t PAGE_AMOUNT = 100;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    Buffer pageBuffer(DIRNAME, 1.25);
+    const uint64_t parentID = pageBuffer.createPage();
+    const uint64_t childID = pageBuffer.createPage();
+    auto& parent = pageBuffer.pinPage(parentID, false, true);
+    auto& reference = *reinterpret_cast<uint64_t*>(parent.data.data());
+    reference = childID;
+    // the parent is written right now -> the reference stays as it is
+    {
+        std::unique_lock referenceLock(parent.referenceMutex);
+        pageBuffer.unpinPage(pageBuffer.pinSwizzled(reference, false), false);
+        ASSERT_EQ(reference, childID);
+    }
+    pageBuffer.unpinPage(pageBuffer.pinSwizzled(reference, false), false);
+    ASSERT_NE(reference, childID);
+    ASSERT_EQ(Buffer::unswizzle(reference), childID);
+    pageBuffer.unpinPage(parent, true);
+}
+// --------------------------------------------------------------------------
+// the test drains the recorded error (friend)
+TEST(PageBuffer, CleanerError) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t PAGE_AMOUNT = 100;
+    file::StorageOptions options;
+    options.pageCleanerThreads = 1;
+    options.pageCleanerInterval = 1ms;
+    uint64_t id;
+    {
+        PageBuffer<BLOCK_SIZE, PAGE_AMOUNT> pageBuffer(DIRNAME, 1.25, options);
+        // a page without a block -> the writes of the cleaner fail
+        const uint64_t invalidID = uint64_t(1000) << 48;
+        auto& invalidPage = pageBuffer.pinPage(invalidID, true, true);
+        pageBuffer.unpinPage(invalidPage, true);
+        id = pageBuffer.createPage();
+        auto& page = pageBuffer.pinPage(id, true, true);
+        page.data.fill(7);
+        pageBuffer.unpinPage(page, true);
+        // the error is raised by the next pin (once)
+        bool raised = false;
+        for (int i = 0; i < 10000 && !raised; i++) {
+            try {
+                pageBuffer.unpinPage(pageBuffer.pinPage(id, false), false);
+                this_thread::sleep_for(1ms);
+            } catch (const std::runtime_error&) {
+                raised = true;
+            }
+        }
+        ASSERT_TRUE(raised);
+        // the cleaner dropped its pins (the page can be deleted)
+        ASSERT_THROW(pageBuffer.deletePage(invalidID), std::runtime_error);
+        try {
+            // the rounds before the delete
+            pageBuffer.raiseBackgroundError();
+        } catch (const std::runtime_error&) {
+        }
+        // the page stayed dirty
+        pageBuffer.flush();
+    }
+    PageBuffer<BLOCK_SIZE, PAGE_AMOUNT> pageBuffer(DIRNAME, 1.25);
+    auto& page = pageBuffer.pinPage(id, false);
+    ASSERT_TRUE(std::all_of(page.data.begin(), page.data.end(), [](unsigned char c) { return c == 7; }));
+    pageBuffer.unpinPage(page, false);
+}
+// --------------------------------------------------------------------------
+// the test accesses the segments (friend)
+TEST(PageBuffer, CompactionError) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 512;
+    constexpr size_t PAGE_AMOUNT = 256;
+    file::StorageOptions options;
+    options.compactionInterval = 1ms;
+    PageBuffer<BLOCK_SIZE, PAGE_AMOUNT> pageBuffer(DIRNAME, 1.25, options);
+    // sparse segments (a quarter of the pages is live)
+    vector<uint64_t> ids;
+    for (int i = 0; i < 2000; i++) {
+        ids.push_back(pageBuffer.createPage());
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (i % 4 != 0) {
+            pageBuffer.deletePage(ids[i]);
+        }
+    }
+    pageBuffer.flush();
+    pageBuffer.setRelocationHook([](const vector<uint64_t>&) -> size_t {
+        throw std::runtime_error("Could not relocate the pages.");
+    });
+    // the error is raised by the next pin
+    bool raised = false;
+    for (int i = 0; i < 10000 && !raised; i++) {
+        try {
+            pageBuffer.unpinPage(pageBuffer.pinPage(ids.front(), false), false);
+            this_thread::sleep_for(1ms);
+        } catch (const std::runtime_error&) {
+            raised = true;
+        }
+    }
+    ASSERT_TRUE(raised);
+    // waits for a running compaction
+    pageBuffer.setRelocationHook({});
+    try {
+        // the rounds before the hook was removed
+        pageBuffer.raiseBackgroundError();
+    } catch (const std::runtime_error&) {
+    }
+    // the segments were given back -> they can be compacted again
+    ASSERT_FALSE(pageBuffer.segmentManager.isCompacting());
+    ASSERT_FALSE(pageBuffer.segmentManager.beginCompaction(0.5).empty());
+    pageBuffer.segmentManager.cancelCompaction();
+    pageBuffer.flush();
+}
+// --------------------------------------------------------------------------
+}// namespace buffer
+// --------------------------------------------------------------------------
+TEST(PageBuffer, Clock) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 512;
+    file::StorageOptions options;
+    options.replacementPolicy = file::ReplacementPolicy::CLOCK;
+    {
+        constexpr size_t PAGE_AMOUNT = 256;
+        PageBuffer<BLOCK_SIZE, PAGE_AMOUNT> pageBuffer(DIRNAME, 1.25, options);
+        vector<size_t> ids;
+        for (int i = 0; i < 2000; i++) {
+            ids.push_back(pageBuffer.createPage());
+        }
+        for (size_t id: ids) {
+            auto& page = pageBuffer.pinPage(id, true, true);
+            page.data.fill(id % 256);
+            pageBuffer.unpinPage(page, true);
+        }
+        // the reference bit keeps the hot page in the buffer while the
+        // others are streamed through it
+        const size_t hotID = ids.front();
+        for (size_t i = 1; i < ids.size(); i++) {
+            auto& page = pageBuffer.pinPage(ids[i], false);
+            ASSERT_EQ(page.id, ids[i]);
+            ASSERT_EQ(page.data.front(), ids[i] % 256);
+            pageBuffer.unpinPage(page, false);
+            if (i % 16 == 0) {
+                const auto before = pageBuffer.getStatistics();
+                auto& hotPage = pageBuffer.pinPage(hotID, false);
+                ASSERT_EQ(hotPage.data.front(), hotID % 256);
+                pageBuffer.unpinPage(hotPage, false);
+                ASSERT_EQ((pageBuffer.getStatistics() - before).reads, i == 16 ? 1 : 0);
+            }
+        }
+    }
+    setup();
+    constexpr size_t PAGE_AMOUNT = 1024;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    options.pageCleanerThreads = 2;
+    options.evictorLowWatermark = 128;
+    options.evictorHighWatermark = 256;
+    vector<size_t> ids;
+    {
+        Buffer pageBuffer(DIRNAME, 1.25, options);
+        for (int i = 0; i < 4000; i++) {
+            ids.push_back(pageBuffer.createPage());
+        }
+        ThreadPool threadPool(16);
+        vector<future<void>> calls;
+        for (size_t id: ids) {
+            calls.emplace_back(threadPool.enqueue([id, &pageBuffer]() {
+                auto& page = pageBuffer.pinPage(id, true, true);
+                ASSERT_EQ(page.id, id);
+                page.data.fill(id % 256);
+                pageBuffer.unpinPage(page, true);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        calls.clear();
+        // the relocated frames move to the clocks of other partitions
+        for (int i = 0; i < 100; i++) {
+            auto& page = pageBuffer.pinPage(ids[i], true);
+            ids[i] = pageBuffer.createPage();
+            pageBuffer.relocatePage(page, ids[i]);
+            page.data.fill(ids[i] % 256);
+            pageBuffer.unpinPage(page, true);
+        }
+        for (int i = 0; i < 8000; i++) {
+            size_t id = ids[rand() % ids.size()];
+            calls.emplace_back(threadPool.enqueue([id, &pageBuffer]() {
+                auto& page = pageBuffer.pinPage(id, false);
+                ASSERT_EQ(page.id, id);
+                for (unsigned char c: page.data) {
+                    ASSERT_EQ(c, id % 256);
+                }
+                pageBuffer.unpinPage(page, false);
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        pageBuffer.flush();
+    }
+    Buffer pageBuffer(DIRNAME, 1.25);
+    for (size_t id: ids) {
+        auto& page = pageBuffer.pinPage(id, false);
+        for (unsigned char c: page.data) {
+            ASSERT_EQ(c, id % 256);
+        }
+        pageBuffer.unpinPage(page, false);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(PageBuffer, Swizzling) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t PAGE_AMOUNT = 100;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    Buffer pageBuffer(DIRNAME, 1.25);
+    vector<uint64_t> references;
+    for (int i = 0; i < 1000; i++) {
+        size_t id = pageBuffer.createPage();
+        references.push_back(id);
+        auto& page = pageBuffer.pinPage(id, true, true);
+        page.data.fill(id % 256);
+        pageBuffer.unpinPage(page, true);
+    }
+    // the second pin goes through the frame, the later ones after the
+    // eviction of the pages through the page table again
+    for (int round = 0; round < 3; round++) {
+        for (auto& reference: references) {
+            const uint64_t id = Buffer::unswizzle(reference);
+            for (int i = 0; i < 2; i++) {
+                auto& page = pageBuffer.pinSwizzled(reference, false);
+                ASSERT_EQ(page.id, id);
+                ASSERT_EQ(page.data[0], id % 256);
+                pageBuffer.unpinPage(page, false);
+                ASSERT_NE(reference, id);
+                ASSERT_EQ(Buffer::unswizzle(reference), id);
+            }
+        }
+    }
+}
+// --------------------------------------------------------------------------
+TEST(PageBuffer, OptimisticRead) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    constexpr size_t PAGE_AMOUNT = 10;
+    using Buffer = PageBuffer<BLOCK_SIZE, PAGE_AMOUNT>;
+    Buffer pageBuffer(DIRNAME, 1.25);
+    vector<uint64_t> references;
+    for (int i = 0; i < 20; i++) {
+        references.push_back(pageBuffer.createPage());
+    }
+    uint64_t version;
+    // a plain reference has to be pinned first
+    ASSERT_EQ(pageBuffer.beginRead(references[0], version), nullptr);
+    auto& page = pageBuffer.pinSwizzled(references[0], true);
+    page.data.fill(1);
+    pageBuffer.unpinPage(page, true);
+    auto* readPage = pageBuffer.beginRead(references[0], version);
+    ASSERT_EQ(readPage, &page);
+    ASSERT_EQ(readPage->data[0], 1);
+    ASSERT_TRUE(pageBuffer.validateRead(*readPage, version));
+    // an evicted page can not be read anymore
+    for (int i = 1; i < 20; i++) {
+        pageBuffer.unpinPage(pageBuffer.pinPage(references[i], false), false);
+    }
+    ASSERT_FALSE(pageBuffer.validateRead(*readPage, version));
+    ASSERT_EQ(pageBuffer.beginRead(references[0], version), nullptr);
+    // shared pins do not change the version, exclusive ones do
+    pageBuffer.unpinPage(pageBuffer.pinSwizzled(references[0], false), false);
+    readPage = pageBuffer.beginRead(references[0], version);
+    ASSERT_NE(readPage, nullptr);
+    ASSERT_EQ(readPage->data[0], 1);
+    pageBuffer.unpinPage(pageBuffer.pinPage(readPage->id, false), false);
+    ASSERT_TRUE(pageBuffer.validateRead(*readPage, version));
+    pageBuffer.unpinPage(pageBuffer.pinPage(readPage->id, true), false);
+    ASSERT_FALSE(pageBuffer.validateRead(*readPage, version));
+}
+// --------------------------------------------------------------------------
 TEST(PageBuffer, BinaryTreeSingleThreaded) {
     setup();
     SimpleBinaryTree binaryTree(DIRNAME, 1);// wraps around 64 pages
@@ -1,8 +1,10 @@
 #include <gtest/gtest.h>
 // --------------------------------------------------------------------------
+#include "src/buffer/queue/ClockQueue.h"
 #include "src/buffer/queue/FIFOQueue.h"
 #include "src/buffer/queue/LRUQueue.h"
 #include <memory>
+#include <vector>
 // --------------------------------------------------------------------------
 using namespace std;
 using namespace buffer::queue;
@@ -112,3 +114,94 @@ TEST(LIFOQueue, Store) {
     }
 }
 // --------------------------------------------------------------------------
+TEST(ClockQueue, Store) {
+    vector<size_t> slots(33);
+    ClockQueue clock(slots);
+    for (size_t i = 0; i < 32; i++) {
+        ASSERT_NO_THROW(clock.insert(i));
+    }
+    ASSERT_EQ(clock.size(), 32);
+    ASSERT_TRUE(clock.contains(31));
+    ASSERT_FALSE(clock.contains(32));
+    ASSERT_THROW(clock.remove(32), std::runtime_error);
+    vector<bool> referenced(32, false);
+    const auto reference = [&referenced](size_t frame) {
+        const bool result = referenced[frame];
+        referenced[frame] = false;
+        return result;
+    };
+    const auto any = [](size_t) {
+        return true;
+    };
+    {
+        // the referenced frames get a second chance
+        referenced[0] = referenced[1] = true;
+        auto found = clock.findOne(any, reference);
+        ASSERT_TRUE(found);
+        ASSERT_EQ(*found, 2);
+        ASSERT_FALSE(referenced[0]);
+        ASSERT_FALSE(referenced[1]);
+    }
+    {
+        // the hand moves on
+        auto found = clock.findOne(any, reference);
+        ASSERT_TRUE(found);
+        ASSERT_EQ(*found, 3);
+    }
+    {
+        // the hand wraps around (after clearing the bits of the others)
+        for (size_t i = 0; i < 32; i++) {
+            referenced[i] = i != 1;
+        }
+        auto found = clock.findOne(any, reference);
+        ASSERT_TRUE(found);
+        ASSERT_EQ(*found, 1);
+    }
+    {
+        // two rounds are enough for the bits
+        fill(referenced.begin(), referenced.end(), true);
+        auto found = clock.findOne(any, reference);
+        ASSERT_TRUE(found);
+        ASSERT_EQ(*found, 2);
+    }
+    {
+        auto found = clock.findOne([](size_t frame) { return frame == 5; }, reference);
+        ASSERT_TRUE(found);
+        ASSERT_EQ(*found, 5);
+        ASSERT_FALSE(clock.findOne([](size_t) { return false; }, reference));
+    }
+    {
+        vector<size_t> next;
+        clock.forNext(4, [&next](size_t frame) {
+            next.push_back(frame);
+            return true;
+        });
+        ASSERT_EQ(next, vector<size_t>({6, 7, 8, 9}));
+        next.clear();
+        // just the even frames count
+        clock.forNext(2, [&next](size_t frame) {
+            next.push_back(frame);
+            return frame % 2 == 0;
+        });
+        ASSERT_EQ(next, vector<size_t>({6, 7, 8}));
+        next.clear();
+        clock.forNext(100, [&next](size_t frame) {
+            next.push_back(frame);
+            return true;
+        });
+        ASSERT_EQ(next.size(), 32);
+    }
+    {
+        // the last frame takes the position of the removed one
+        clock.remove(6);
+        ASSERT_FALSE(clock.contains(6));
+        ASSERT_EQ(clock.size(), 31);
+        ASSERT_EQ(clock.getRing()[6], 31);
+        ASSERT_TRUE(clock.contains(31));
+        clock.remove(31);
+        ASSERT_EQ(clock.getRing()[6], 30);
+        ASSERT_FALSE(clock.contains(31));
+        ASSERT_THROW(clock.remove(31), std::runtime_error);
+    }
+}
+// --------------------------------------------------------------------------
@@ -2,7 +2,13 @@
 // --------------------------------------------------------------------------
 #include "src/file/SegmentManager.h"
 #include "thirdparty/ThreadPool/ThreadPool.h"
+#include <fcntl.h>
 #include <filesystem>
+#include <fstream>
+#include <random>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
 #include <unordered_set>
 // --------------------------------------------------------------------------
 using namespace std;
@@ -15,6 +21,29 @@ void setup() {
     std::filesystem::remove_all(DIRNAME.c_str());
 }
 // --------------------------------------------------------------------------
+// drops the (clean) pages of the file from the page cache
+void dropCachedPages(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+    close(fd);
+}
+// --------------------------------------------------------------------------
+// the amount of pages of the file in the page cache
+size_t cachedPages(const string& path) {
+    const size_t size = std::filesystem::file_size(path);
+    const int fd = open(path.c_str(), O_RDONLY);
+    EXPECT_GE(fd, 0);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    EXPECT_NE(mapping, MAP_FAILED);
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    vector<unsigned char> resident((size + pageSize - 1) / pageSize);
+    EXPECT_EQ(mincore(mapping, size, resident.data()), 0);
+    munmap(mapping, size);
+    close(fd);
+    return count_if(resident.begin(), resident.end(), [](unsigned char page) { return page & 1; });
+}
+// --------------------------------------------------------------------------
 }// namespace
 // --------------------------------------------------------------------------
 TEST(SegmentManager, StoreSingleThreaded) {
@@ -176,4 +205,761 @@ TEST(SegmentManager, DeleteMultiThreaded) {
         }
     }
 }
-// --------------------------------------------------------------------------
\ No newline at end of file
+// --------------------------------------------------------------------------
+TEST(SegmentManager, KeepDataIOUring) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    StorageOptions options;
+    options.io.type = io::IOBackendType::IO_URING;
+    std::unordered_set<size_t> ids;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        ThreadPool threadPool(32);
+        vector<future<size_t>> calls;
+        for (int i = 0; i < 10000; i++) {
+            calls.emplace_back(threadPool.enqueue([&segmentManager]() {
+                size_t id = segmentManager.createBlock();
+                array<unsigned char, BLOCK_SIZE> arr;
+                fill(arr.begin(), arr.end(), id % 256);
+                segmentManager.writeBlock(id, move(arr));
+                return id;
+            }));
+        }
+        for (auto& call: calls) {
+            ids.insert(call.get());
+        }
+        segmentManager.flush();
+    }
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+    for (size_t id: ids) {
+        array<unsigned char, BLOCK_SIZE> arr = segmentManager.readBlock(id);
+        for (unsigned char c: arr) {
+            ASSERT_EQ(static_cast<int>(c), id % 256);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, KeepDataDirectIO) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    StorageOptions options;
+    options.directIO = true;
+    std::unordered_set<size_t> ids;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        for (int i = 0; i < 1000; i++) {
+            size_t id = segmentManager.createBlock();
+            ids.insert(id);
+            array<unsigned char, BLOCK_SIZE> arr;
+            fill(arr.begin(), arr.end(), id % 256);
+            segmentManager.writeBlock(id, move(arr));
+            if (i % 5 == 0) {
+                segmentManager.deleteBlock(id);
+                ids.erase(id);
+            }
+        }
+        segmentManager.flush();
+    }
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+    for (size_t id: ids) {
+        array<unsigned char, BLOCK_SIZE> arr = segmentManager.readBlock(id);
+        for (unsigned char c: arr) {
+            ASSERT_EQ(static_cast<int>(c), id % 256);
+        }
+    }
+    // O_DIRECT is not possible with unaligned blocks
+    using UnalignedSegmentManager = SegmentManager<256>;
+    ASSERT_THROW(UnalignedSegmentManager(DIRNAME + "_unaligned", 1.25, options), std::runtime_error);
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, ZeroCopy) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+    vector<array<unsigned char, BLOCK_SIZE>> blocks(1000);
+    vector<size_t> ids;
+    for (auto& block: blocks) {
+        size_t id = segmentManager.createBlock();
+        ids.push_back(id);
+        block.fill(id % 256);
+        segmentManager.writeBlockFrom(id, block);
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+        array<unsigned char, BLOCK_SIZE> arr = {};
+        segmentManager.readBlockInto(ids[i], arr);
+        ASSERT_EQ(arr, blocks[i]);
+        // both APIs access the same blocks
+        ASSERT_EQ(segmentManager.readBlock(ids[i]), blocks[i]);
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, WriteBlocks) {
+    constexpr size_t BLOCK_SIZE = 4096;
+    for (auto type: {io::IOBackendType::POSIX, io::IOBackendType::IO_URING}) {
+        setup();
+        StorageOptions options;
+        options.io.type = type;
+        options.directIO = true;
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        vector<size_t> ids;
+        for (int i = 0; i < 3000; i++) {
+            ids.push_back(segmentManager.createBlock());
+        }
+        // the ids span several segments, skipping some leaves gaps
+        alignas(4096) static array<unsigned char, BLOCK_SIZE> blocks[3000];
+        vector<SegmentManager<BLOCK_SIZE>::BlockWrite> writes;
+        for (size_t i = 0; i < ids.size(); i++) {
+            blocks[i].fill((ids[i] + 1) % 256);
+            if (i % 7 != 3) {
+                writes.emplace_back(ids[i], blocks[i]);
+            } else {
+                segmentManager.writeBlockFrom(ids[i], blocks[i]);
+            }
+        }
+        // the order of the writes does not matter
+        std::reverse(writes.begin(), writes.end());
+        segmentManager.writeBlocks(std::move(writes));
+        for (size_t i = 0; i < ids.size(); i++) {
+            ASSERT_EQ(segmentManager.readBlock(ids[i]), blocks[i]);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, WriteAndReadBlock) {
+    constexpr size_t BLOCK_SIZE = 4096;
+    for (auto type: {io::IOBackendType::POSIX, io::IOBackendType::IO_URING}) {
+        setup();
+        StorageOptions options;
+        options.io.type = type;
+        options.directIO = true;
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        const size_t first = segmentManager.createBlock();
+        const size_t second = segmentManager.createBlock();
+        alignas(4096) static array<unsigned char, BLOCK_SIZE> written, read;
+        written.fill(42);
+        segmentManager.writeBlockFrom(second, written);
+        written.fill(7);
+        const auto before = segmentManager.getStatistics();
+        segmentManager.writeAndReadBlock(first, written, second, read);
+        const auto delta = segmentManager.getStatistics() - before;
+        ASSERT_EQ(segmentManager.readBlock(first), written);
+        ASSERT_TRUE(std::all_of(read.begin(), read.end(), [](unsigned char c) { return c == 42; }));
+        // both blocks are in the same file -> one batch
+        ASSERT_EQ(delta.reads, 1);
+        ASSERT_EQ(delta.writes, 1);
+        ASSERT_GT(io::IOStatisticsSnapshot::percentile(delta.mixedLatency, 0.99), 0);
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, ReuseDeletedBlocks) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    std::unordered_set<size_t> deleted;
+    size_t freeBlocks;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+        for (int i = 0; i < 1000; i++) {
+            size_t id = segmentManager.createBlock();
+            if (i % 3 == 0) {
+                deleted.insert(id);
+            }
+        }
+        for (size_t id: deleted) {
+            segmentManager.deleteBlock(id);
+        }
+        freeBlocks = segmentManager.allocatedBlocks() - 1000 + deleted.size();
+        segmentManager.flush();
+    }
+    // the free blocks survive a restart
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+    const size_t allocated = segmentManager.allocatedBlocks();
+    std::unordered_set<size_t> created;
+    for (size_t i = 0; i < freeBlocks; i++) {
+        created.insert(segmentManager.createBlock());
+    }
+    // all free blocks (including the deleted ones) are used before growing
+    ASSERT_EQ(created.size(), freeBlocks);
+    for (size_t id: deleted) {
+        ASSERT_TRUE(created.contains(id));
+    }
+    ASSERT_EQ(segmentManager.allocatedBlocks(), allocated);
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, AllocationCaches) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    std::unordered_set<size_t> ids;
+    size_t allocated;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+        {
+            ThreadPool threadPool(8);
+            vector<future<size_t>> calls;
+            for (int i = 0; i < 1000; i++) {
+                calls.emplace_back(threadPool.enqueue([&segmentManager]() {
+                    return segmentManager.createBlock();
+                }));
+            }
+            for (auto& call: calls) {
+                ids.insert(call.get());
+            }
+            // the threads return their unused ids on exit
+        }
+        ASSERT_EQ(ids.size(), 1000);
+        allocated = segmentManager.allocatedBlocks();
+        segmentManager.flush();
+    }
+    // no reserved block got lost
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+    for (size_t i = 0; i < allocated - 1000; i++) {
+        ASSERT_TRUE(ids.insert(segmentManager.createBlock()).second);
+    }
+    ASSERT_EQ(segmentManager.allocatedBlocks(), allocated);
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, Striping) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    StorageOptions options;
+    options.stripeDirectories = {DIRNAME + "/stripe1", DIRNAME + "/stripe2"};
+    std::unordered_set<size_t> ids;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        ThreadPool threadPool(32);
+        vector<future<size_t>> calls;
+        for (int i = 0; i < 5000; i++) {
+            calls.emplace_back(threadPool.enqueue([&segmentManager]() {
+                size_t id = segmentManager.createBlock();
+                array<unsigned char, BLOCK_SIZE> arr;
+                fill(arr.begin(), arr.end(), id % 256);
+                segmentManager.writeBlock(id, move(arr));
+                return id;
+            }));
+        }
+        for (auto& call: calls) {
+            ids.insert(call.get());
+        }
+        segmentManager.flush();
+    }
+    // every file stores some of the segments
+    ASSERT_GT(std::filesystem::file_size(DIRNAME + "/segments"), BLOCK_SIZE);
+    ASSERT_GT(std::filesystem::file_size(DIRNAME + "/stripe1/segments.1"), BLOCK_SIZE);
+    ASSERT_GT(std::filesystem::file_size(DIRNAME + "/stripe2/segments.2"), BLOCK_SIZE);
+    // the stripe files belong to the segments
+    ASSERT_THROW(SegmentManager<BLOCK_SIZE>(DIRNAME, 1.25), std::runtime_error);
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+    for (size_t id: ids) {
+        array<unsigned char, BLOCK_SIZE> arr = segmentManager.readBlock(id);
+        for (unsigned char c: arr) {
+            ASSERT_EQ(static_cast<int>(c), id % 256);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, Preallocation) {
+    constexpr size_t BLOCK_SIZE = 4096;
+    for (bool background: {false, true}) {
+        setup();
+        StorageOptions options;
+        options.preallocationChunk = 0;
+        options.backgroundPreallocation = background;
+        std::unordered_set<size_t> ids;
+        {
+            SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+            for (int i = 0; i < 1000; i++) {
+                ids.insert(segmentManager.createBlock());
+            }
+            segmentManager.flush();
+        }
+        // the segments are backed by allocated extents (no sparse file)
+        struct stat fileStat;
+        ASSERT_EQ(stat((DIRNAME + "/segments").c_str(), &fileStat), 0);
+        ASSERT_GE(fileStat.st_blocks * 512, fileStat.st_size);
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        for (size_t id: ids) {
+            array<unsigned char, BLOCK_SIZE> arr;
+            fill(arr.begin(), arr.end(), id % 256);
+            segmentManager.writeBlock(id, arr);
+            ASSERT_EQ(segmentManager.readBlock(id), arr);
+        }
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, SegmentDirectory) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    std::unordered_set<size_t> ids;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.1);
+        for (int i = 0; i < 5000; i++) {
+            size_t id = segmentManager.createBlock();
+            array<unsigned char, BLOCK_SIZE> arr;
+            fill(arr.begin(), arr.end(), id % 256);
+            segmentManager.writeBlock(id, arr);
+            ids.insert(id);
+        }
+        segmentManager.flush();
+    }
+    // with the directory (lazy) and without it (reads every segment header):
+    // a torn or missing directory is not used
+    for (int round = 0; round < 3; round++) {
+        if (round == 1) {
+            std::fstream metadata(DIRNAME + "/metadata", std::ios::in | std::ios::out | std::ios::binary);
+            metadata.seekp(-1, std::ios::end);
+            metadata.put(0x7f);
+        } else if (round == 2) {
+            std::filesystem::remove(DIRNAME + "/metadata");
+        }
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.1);
+        for (size_t id: ids) {
+            array<unsigned char, BLOCK_SIZE> arr = segmentManager.readBlock(id);
+            for (unsigned char c: arr) {
+                ASSERT_EQ(static_cast<int>(c), id % 256);
+            }
+        }
+        // the first allocation loads the bitmap
+        const size_t id = segmentManager.createBlock();
+        ASSERT_FALSE(ids.contains(id));
+        segmentManager.deleteBlock(id);
+        segmentManager.flush();
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, Compaction) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    std::unordered_map<size_t, unsigned char> blocks;// id -> content
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+        vector<size_t> ids;
+        for (int i = 0; i < 3000; i++) {
+            size_t id = segmentManager.createBlock();
+            array<unsigned char, BLOCK_SIZE> arr;
+            fill(arr.begin(), arr.end(), i % 256);
+            segmentManager.writeBlock(id, arr);
+            ids.push_back(id);
+        }
+        // free space in front, sparse segments at the end
+        for (size_t i = 0; i < ids.size(); i++) {
+            if ((i < 1000 && i % 2 == 0) || (i >= 1000 && i % 20 != 0)) {
+                segmentManager.deleteBlock(ids[i]);
+            } else {
+                blocks[ids[i]] = i % 256;
+            }
+        }
+        segmentManager.flush();
+        const size_t fileSize = std::filesystem::file_size(DIRNAME + "/segments");
+        vector<size_t> relocations = segmentManager.beginCompaction(0.5);
+        ASSERT_FALSE(relocations.empty());
+        const size_t firstCompacted = (*min_element(relocations.begin(), relocations.end())) >> 48;
+        for (size_t id: relocations) {
+            ASSERT_TRUE(blocks.contains(id));
+            // the compacted segments don't get new blocks
+            size_t newID = segmentManager.createBlock();
+            ASSERT_LT(newID >> 48, firstCompacted);
+            segmentManager.writeBlock(newID, segmentManager.readBlock(id));
+            segmentManager.deleteBlock(id);
+            blocks[newID] = blocks[id];
+            blocks.erase(id);
+        }
+        segmentManager.flush();
+        ASSERT_LT(std::filesystem::file_size(DIRNAME + "/segments"), fileSize);
+        for (auto [id, c]: blocks) {
+            array<unsigned char, BLOCK_SIZE> arr;
+            fill(arr.begin(), arr.end(), c);
+            ASSERT_EQ(segmentManager.readBlock(id), arr);
+        }
+    }
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+    for (auto [id, c]: blocks) {
+        array<unsigned char, BLOCK_SIZE> arr;
+        fill(arr.begin(), arr.end(), c);
+        ASSERT_EQ(segmentManager.readBlock(id), arr);
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, CreateBlockNear) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    StorageOptions options;
+    options.allocationBatch = 0;
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+    vector<size_t> ids;
+    for (int i = 0; i < 3000; i++) {
+        ids.push_back(segmentManager.createBlock());
+    }
+    // fill the last segment, the next allocation opens a new one
+    size_t next;
+    while (((next = segmentManager.createBlock()) >> 48) == (ids.back() >> 48)) {
+    }
+    // ids are sequential within a segment
+    const size_t hint = ids[2500];
+    ASSERT_EQ(ids[2503] >> 48, hint >> 48);
+    ASSERT_EQ(ids[2503], hint + 3);
+    segmentManager.deleteBlock(ids[0]);
+    segmentManager.deleteBlock(ids[2503]);
+    segmentManager.deleteBlock(ids[2497]);
+    segmentManager.deleteBlock(ids[2460]);
+    // closest free blocks of the hint's segment first
+    ASSERT_EQ(segmentManager.createBlock(hint), ids[2503]);
+    ASSERT_EQ(segmentManager.createBlock(hint), ids[2497]);
+    ASSERT_EQ(segmentManager.createBlock(hint), ids[2460]);
+    // the segment is full -> the closest segment with free blocks
+    const size_t nearHint = segmentManager.createBlock(hint);
+    ASSERT_NE(nearHint >> 48, hint >> 48);
+    ASSERT_NE(nearHint, ids[0]);
+    const size_t nearFirst = segmentManager.createBlock(ids[1]);
+    ASSERT_EQ(nearFirst, ids[0]);
+    ASSERT_EQ(nearHint >> 48, next >> 48);
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, Prefetch) {
+    constexpr size_t BLOCK_SIZE = 4096;
+    for (bool directIO: {false, true}) {
+        setup();
+        StorageOptions options;
+        options.directIO = directIO;
+        options.stripeDirectories = {DIRNAME + "/stripe"};
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        vector<size_t> ids;
+        alignas(4096) static array<unsigned char, BLOCK_SIZE> block;
+        for (int i = 0; i < 2000; i++) {
+            ids.push_back(segmentManager.createBlock());
+            block.fill(i % 256);
+            segmentManager.writeBlockFrom(ids.back(), block);
+        }
+        segmentManager.flush();
+        const vector<string> files = {DIRNAME + "/segments", DIRNAME + "/stripe/segments.1"};
+        const auto cachedBlocks = [&files]() {
+            size_t result = 0;
+            for (const auto& file: files) {
+                result += cachedPages(file);
+            }
+            return result * sysconf(_SC_PAGESIZE) / BLOCK_SIZE;
+        };
+        for (const auto& file: files) {
+            dropCachedPages(file);
+        }
+        const size_t cachedBefore = cachedBlocks();
+        // unsorted, with duplicates and across all files
+        vector<size_t> prefetchIDs;
+        for (size_t i = 0; i < ids.size(); i += 3) {
+            prefetchIDs.push_back(ids[ids.size() - 1 - i]);
+            prefetchIDs.push_back(ids[i / 2]);
+        }
+        const size_t prefetched = unordered_set<size_t>(prefetchIDs.begin(), prefetchIDs.end()).size();
+        ASSERT_LT(cachedBefore + prefetched, ids.size());
+        segmentManager.prefetch(prefetchIDs);
+        segmentManager.prefetch({});
+        if (!directIO) {
+            // the kernel reads the blocks in the background
+            for (int i = 0; i < 5000 && cachedBlocks() < cachedBefore + prefetched; i++) {
+                this_thread::sleep_for(1ms);
+            }
+            ASSERT_GE(cachedBlocks(), cachedBefore + prefetched);
+        } else {
+            // O_DIRECT bypasses the page cache
+            ASSERT_EQ(cachedBlocks(), cachedBefore);
+        }
+        const auto beforeReads = segmentManager.getStatistics();
+        for (size_t i = 0; i < ids.size(); i++) {
+            block.fill(i % 256);
+            ASSERT_EQ(segmentManager.readBlock(ids[i]), block);
+        }
+        // the prefetch does not count as block reads
+        ASSERT_EQ((segmentManager.getStatistics() - beforeReads).reads, ids.size());
+    }
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, SegmentTable) {
+    SegmentTable<size_t> table;
+    ASSERT_TRUE(table.empty());
+    ASSERT_THROW(table.at(0), std::runtime_error);
+    // readers see every published entry while the table grows (several chunks)
+    constexpr size_t ENTRIES = 10000;
+    std::atomic_bool done = false;
+    std::thread reader([&]() {
+        while (!done) {
+            const size_t size = table.size();
+            for (size_t i = 0; i < size; i += 97) {
+                ASSERT_EQ(*table[i], i);
+            }
+        }
+    });
+    for (size_t i = 0; i < ENTRIES; i++) {
+        table.push_back(std::make_unique<size_t>(i));
+    }
+    done = true;
+    reader.join();
+    ASSERT_EQ(table.size(), ENTRIES);
+    ASSERT_EQ(*table.back(), ENTRIES - 1);
+    for (size_t i = 0; i < ENTRIES; i++) {
+        ASSERT_EQ(*table.at(i), i);
+    }
+    // entries can be removed and appended again
+    table.pop_back();
+    ASSERT_THROW(table.at(ENTRIES - 1), std::runtime_error);
+    table.push_back(std::make_unique<size_t>(ENTRIES - 1));
+    ASSERT_EQ(*table.at(ENTRIES - 1), ENTRIES - 1);
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, Statistics) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25);
+    auto statistics = segmentManager.getStatistics();
+    ASSERT_EQ(statistics.allocations, 0);
+    vector<size_t> ids;
+    for (int i = 0; i < 100; i++) {
+        ids.push_back(segmentManager.createBlock());
+    }
+    ids.push_back(segmentManager.createBlock(ids.front()));
+    array<unsigned char, BLOCK_SIZE> block = {};
+    for (size_t id: ids) {
+        segmentManager.writeBlock(id, block);
+    }
+    for (size_t id: ids) {
+        segmentManager.readBlock(id);
+    }
+    segmentManager.deleteBlock(ids.back());
+    const auto before = segmentManager.getStatistics();
+    ASSERT_EQ(before.allocations, ids.size());
+    ASSERT_EQ(before.deletes, 1);
+    ASSERT_EQ(before.writes, ids.size());
+    ASSERT_EQ(before.writeBytes, ids.size() * BLOCK_SIZE);
+    ASSERT_GE(before.reads, ids.size());
+    ASSERT_GE(before.readBytes, ids.size() * BLOCK_SIZE);
+    uint64_t samples = 0;
+    for (uint64_t count: before.writeLatency) {
+        samples += count;
+    }
+    ASSERT_EQ(samples, ids.size());
+    ASSERT_GT(io::IOStatisticsSnapshot::percentile(before.writeLatency, 0.99), 0);
+    // the unused cached ids are returned, but are not deleted by the user
+    segmentManager.flush();
+    const auto delta = segmentManager.getStatistics() - before;
+    ASSERT_EQ(delta.allocations, 0);
+    ASSERT_EQ(delta.deletes, 0);
+    ASSERT_EQ(delta.reads, 0);
+    // the segment metadata, the directory and the header are written
+    ASSERT_GE(delta.writes, 3);
+}
+// --------------------------------------------------------------------------
+
+TEST(SegmentManager, InMemory) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    StorageOptions options;
+    options.io.type = io::IOBackendType::MEMORY;
+    options.stripeDirectories = {DIRNAME + "/stripe"};
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+    vector<size_t> ids;
+    for (int i = 0; i < 3000; i++) {
+        ids.push_back(segmentManager.createBlock());
+        array<unsigned char, BLOCK_SIZE> block;
+        block.fill(i % 256);
+        segmentManager.writeBlock(ids.back(), block);
+    }
+    // nothing is stored on disk
+    ASSERT_FALSE(std::filesystem::exists(DIRNAME));
+    for (size_t i = 0; i < ids.size(); i++) {
+        ASSERT_EQ(segmentManager.readBlock(ids[i])[0], i % 256);
+    }
+    // the file operations work as well (compaction)
+    for (size_t i = 1000; i < ids.size(); i++) {
+        segmentManager.deleteBlock(ids[i]);
+    }
+    segmentManager.beginCompaction(0.5);
+    segmentManager.flush();
+    for (size_t i = 0; i < 1000; i++) {
+        ASSERT_EQ(segmentManager.readBlock(ids[i])[0], i % 256);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(SegmentManager, LogStructured) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    StorageOptions options;
+    options.logStructured = true;
+    options.allocationBatch = 0;
+    vector<uint64_t> ids;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        for (int i = 0; i < 1000; i++) {
+            ids.push_back(segmentManager.createBlock());
+        }
+        // the ids are dense, unwritten blocks read as zeros
+        ASSERT_EQ(ids.back(), ids.size() - 1);
+        ASSERT_EQ(segmentManager.readBlock(ids.front())[0], 0);
+        // every round overwrites all blocks -> the old copies become garbage
+        for (int round = 0; round < 3; round++) {
+            for (size_t i = 0; i < ids.size(); i++) {
+                array<unsigned char, BLOCK_SIZE> block;
+                block.fill((i + round) % 256);
+                segmentManager.writeBlock(ids[i], block);
+            }
+        }
+        for (size_t i = 0; i < ids.size(); i++) {
+            ASSERT_EQ(segmentManager.readBlock(ids[i])[0], (i + 2) % 256);
+        }
+        // sparse segments: half of the blocks are deleted
+        for (size_t i = 0; i < ids.size(); i += 2) {
+            segmentManager.deleteBlock(ids[i]);
+        }
+        const size_t allocated = segmentManager.allocatedBlocks();
+        ASSERT_GT(segmentManager.clean(0.6), 0);
+        for (size_t i = 1; i < ids.size(); i += 2) {
+            ASSERT_EQ(segmentManager.readBlock(ids[i])[0], (i + 2) % 256);
+        }
+        // the cleaned segments are reused instead of growing the files
+        for (size_t i = 1; i < ids.size(); i += 2) {
+            array<unsigned char, BLOCK_SIZE> block;
+            block.fill((i + 3) % 256);
+            segmentManager.writeBlock(ids[i], block);
+        }
+        ASSERT_EQ(segmentManager.allocatedBlocks(), allocated);
+        // the deleted ids are reused
+        ASSERT_LT(segmentManager.createBlock(), ids.size());
+        segmentManager.flush();
+    }
+    // the mapping is persisted
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+    for (size_t i = 1; i < ids.size(); i += 2) {
+        ASSERT_EQ(segmentManager.readBlock(ids[i])[0], (i + 3) % 256);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(SegmentManager, LogStructuredReopen) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    StorageOptions options;
+    options.logStructured = true;
+    vector<uint64_t> ids;
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.1, options);
+        for (int i = 0; i < 2000; i++) {
+            ids.push_back(segmentManager.createBlock());
+        }
+        for (int round = 0; round < 2; round++) {
+            for (size_t i = 0; i < ids.size(); i++) {
+                array<unsigned char, BLOCK_SIZE> block;
+                block.fill((i + round) % 256);
+                segmentManager.writeBlock(ids[i], block);
+            }
+        }
+        segmentManager.flush();
+    }
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.1, options);
+    // the bitmaps follow from the mapping: no segment is read on reopen
+    ASSERT_LE(segmentManager.getStatistics().reads, 4);
+    for (size_t i = 0; i < ids.size(); i++) {
+        ASSERT_EQ(segmentManager.readBlock(ids[i])[0], (i + 1) % 256);
+    }
+    // the rebuilt bitmaps keep the live blocks
+    for (size_t i = 0; i < ids.size(); i += 2) {
+        array<unsigned char, BLOCK_SIZE> block;
+        block.fill((i + 2) % 256);
+        segmentManager.writeBlock(ids[i], block);
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+        ASSERT_EQ(segmentManager.readBlock(ids[i])[0], (i + 1 + (i + 1) % 2) % 256);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(SegmentManager, Compression) {
+    setup();
+    constexpr size_t BLOCK_SIZE = 4096;
+    // the codec: runs, repetitions and incompressible data
+    {
+        array<unsigned char, BLOCK_SIZE> block = {};
+        array<unsigned char, BLOCK_SIZE> compressed;
+        array<unsigned char, BLOCK_SIZE> decompressed;
+        for (size_t i = 0; i < 1000; i++) {
+            block[i] = i % 7;
+        }
+        size_t size = compress(block, compressed);
+        ASSERT_GT(size, 0);
+        ASSERT_LT(size, 100);
+        ASSERT_TRUE(decompress(span(compressed).first(size), decompressed));
+        ASSERT_EQ(block, decompressed);
+        default_random_engine random;
+        for (auto& byte: block) {
+            byte = random();
+        }
+        ASSERT_EQ(compress(block, span(compressed).first(BLOCK_SIZE / 2)), 0);
+        size = compress(block, compressed);
+        if (size > 0) {
+            ASSERT_TRUE(decompress(span(compressed).first(size), decompressed));
+            ASSERT_EQ(block, decompressed);
+        }
+        ASSERT_FALSE(decompress(span(compressed).first(10), decompressed));
+    }
+    StorageOptions options;
+    options.logStructured = true;
+    options.compression = true;
+    options.allocationBatch = 0;
+    vector<uint64_t> ids;
+    // half-empty nodes: 100 byte values, the rest is unused
+    const auto makeBlock = [](size_t i) {
+        array<unsigned char, BLOCK_SIZE> block = {};
+        for (size_t j = 0; j < BLOCK_SIZE / 2; j++) {
+            block[j] = (j % 100 == 0) ? i % 256 : j % 100;
+        }
+        return block;
+    };
+    {
+        SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+        for (size_t i = 0; i < 1000; i++) {
+            ids.push_back(segmentManager.createBlock());
+        }
+        for (int round = 0; round < 2; round++) {
+            for (size_t i = 0; i < ids.size(); i++) {
+                segmentManager.writeBlock(ids[i], makeBlock(i + round));
+            }
+        }
+        // an incompressible block is stored as it is
+        array<unsigned char, BLOCK_SIZE> noise;
+        default_random_engine random;
+        for (auto& byte: noise) {
+            byte = random();
+        }
+        segmentManager.writeBlock(ids.front(), noise);
+        const auto statistics = segmentManager.getStatistics();
+        ASSERT_GT(statistics.compressionRatio(), 4);
+        ASSERT_LT(statistics.writeBytes, 2 * ids.size() * BLOCK_SIZE / 4);
+        // several blocks share a physical block
+        ASSERT_LT(segmentManager.allocatedBlocks(), ids.size());
+        ASSERT_EQ(segmentManager.readBlock(ids.front()), noise);
+        for (size_t i = 1; i < ids.size(); i++) {
+            ASSERT_EQ(segmentManager.readBlock(ids[i]), makeBlock(i + 1));
+        }
+        // the garbage of the first round is cleaned
+        ASSERT_GT(segmentManager.clean(0.9), 0);
+        for (size_t i = 1; i < ids.size(); i++) {
+            ASSERT_EQ(segmentManager.readBlock(ids[i]), makeBlock(i + 1));
+        }
+        segmentManager.flush();
+    }
+    SegmentManager<BLOCK_SIZE> segmentManager(DIRNAME, 1.25, options);
+    for (size_t i = 1; i < ids.size(); i++) {
+        ASSERT_EQ(segmentManager.readBlock(ids[i]), makeBlock(i + 1));
+    }
+    // compression needs the log-structured mode
+    options.logStructured = false;
+    ASSERT_THROW(SegmentManager<BLOCK_SIZE>(DIRNAME + "/other", 1.25, options), std::runtime_error);
+}
+// --------------------------------------------------------------------------
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+// --------------------------------------------------------------------------
+#include "src/file/WriteAheadLog.h"
+#include "thirdparty/ThreadPool/ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <future>
+#include <unistd.h>
+#include <vector>
+// --------------------------------------------------------------------------
+using namespace std;
+using namespace file;
+// --------------------------------------------------------------------------
+namespace {
+// --------------------------------------------------------------------------
+static const string DIRNAME = "/tmp/tester_test_write_ahead_log";
+static const string FILENAME = DIRNAME + "/wal";
+void setup() {
+    std::filesystem::remove_all(DIRNAME.c_str());
+    std::filesystem::create_directories(DIRNAME);
+}
+// --------------------------------------------------------------------------
+span<const unsigned char> asBytes(const uint64_t& value) {
+    return {reinterpret_cast<const unsigned char*>(&value), sizeof(value)};
+}
+// --------------------------------------------------------------------------
+vector<uint64_t> replayAll(WriteAheadLog& wal) {
+    vector<uint64_t> result;
+    wal.replay([&result](span<const unsigned char> record) {
+        EXPECT_EQ(record.size(), sizeof(uint64_t));
+        memcpy(&result.emplace_back(), record.data(), sizeof(uint64_t));
+    });
+    return result;
+}
+// --------------------------------------------------------------------------
+}// namespace
+// --------------------------------------------------------------------------
+TEST(WriteAheadLog, Replay) {
+    setup();
+    constexpr uint64_t RECORDS = 100;
+    {
+        WriteAheadLog wal(FILENAME, {});
+        ASSERT_TRUE(replayAll(wal).empty());
+        for (uint64_t i = 0; i < RECORDS; i++) {
+            wal.commit(wal.append(asBytes(i)));
+        }
+        // not committed -> may be lost
+        wal.append(asBytes(RECORDS));
+    }
+    {
+        // a torn record at the end (crash during the write)
+        const int fd = open(FILENAME.c_str(), O_WRONLY | O_APPEND);
+        ASSERT_GE(fd, 0);
+        const unsigned char garbage[5] = {8, 0, 0, 0, 1};
+        ASSERT_EQ(write(fd, garbage, sizeof(garbage)), sizeof(garbage));
+        close(fd);
+    }
+    {
+        WriteAheadLog wal(FILENAME, {});
+        auto records = replayAll(wal);
+        ASSERT_EQ(records.size(), RECORDS);
+        for (uint64_t i = 0; i < RECORDS; i++) {
+            ASSERT_EQ(records[i], i);
+        }
+        // the new records follow the last complete one
+        wal.commit(wal.append(asBytes(RECORDS)));
+    }
+    {
+        WriteAheadLog wal(FILENAME, {});
+        ASSERT_EQ(replayAll(wal).size(), RECORDS + 1);
+        wal.truncate();
+    }
+    WriteAheadLog wal(FILENAME, {});
+    ASSERT_TRUE(replayAll(wal).empty());
+}
+// --------------------------------------------------------------------------
+TEST(WriteAheadLog, GroupCommit) {
+    setup();
+    constexpr uint64_t RECORDS = 2000;
+    constexpr size_t THREADS = 8;
+    {
+        WriteAheadLog wal(FILENAME, {}, chrono::microseconds(100));
+        ThreadPool threadPool(THREADS);
+        vector<future<void>> calls;
+        for (uint64_t i = 0; i < RECORDS; i++) {
+            calls.emplace_back(threadPool.enqueue([&wal, i]() {
+                wal.commit(wal.append(asBytes(i)));
+            }));
+        }
+        for (auto& call: calls) {
+            call.get();
+        }
+        // the committers share the syncs
+        const auto statistics = wal.getStatistics();
+        ASSERT_GT(statistics.syncs, 0);
+        ASSERT_LT(statistics.syncs, RECORDS);
+    }
+    WriteAheadLog wal(FILENAME, {});
+    auto records = replayAll(wal);
+    ASSERT_EQ(records.size(), RECORDS);
+    sort(records.begin(), records.end());
+    for (uint64_t i = 0; i < RECORDS; i++) {
+        ASSERT_EQ(records[i], i);
+    }
+}
+// --------------------------------------------------------------------------
+TEST(WriteAheadLog, TruncateCheckpointed) {
+    setup();
+    constexpr uint64_t RECORDS = 100;
+    {
+        WriteAheadLog wal(FILENAME, {});
+        for (uint64_t i = 0; i < RECORDS; i++) {
+            wal.commit(wal.append(asBytes(i)));
+        }
+        const uint64_t lsn = wal.lastLSN();
+        const uint64_t nextLSN = wal.append(asBytes(RECORDS));
+        // the checkpoint contains the first records
+        wal.truncate(lsn);
+        wal.commit(nextLSN);
+        // durable with the checkpoint
+        wal.commit(lsn);
+    }
+    WriteAheadLog wal(FILENAME, {});
+    auto records = replayAll(wal);
+    ASSERT_EQ(records.size(), 1);
+    ASSERT_EQ(records.front(), RECORDS);
+}
+// --------------------------------------------------------------------------